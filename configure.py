@@ -78,11 +78,13 @@ parser.add_argument('--O3', '--o3', action='store_true',
 
 parser.add_argument('--disable-test-tool', action='append', default=[],
                     choices=[
+                        'bench-dfield'
                     ],
                     help='don\'t build a specific test tool')
 parser.add_argument('--disable-tool', action='append', default=[],
                     choices=[
-                        'generate-dfield'
+                        'generate-dfield',
+                        'pack-dfield'
                     ],
                     help='don\'t build a specific tool')
 parser.add_argument('--disable-client', action='store_true',
@@ -509,6 +511,7 @@ w.newline()
 package('vulkan')
 package('glfw3')
 package('liblzma', alias='lzma')
+package('libpng')
 
 #
 # NINJA RULES
@@ -532,6 +535,13 @@ w.rule(
     )
 w.newline()
 
+w.rule(
+        name = 'run',
+        command = './$in $args',
+        pool = 'console'
+    )
+w.newline()
+
 w.rule(
         name = 'glslc',
         deps = 'gcc',
@@ -551,7 +561,7 @@ build('main.c')
 build('dfield.c', cflags='$cflags -fopenmp', packages=['lzma'])
 w.newline()
 
-build('renderer/renderer.c', packages=['vulkan', 'glfw3'])
+build('renderer/renderer.c', cflags='$cflags -fopenmp', packages=['vulkan', 'glfw3'])
 build('renderer/scene.c', packages=['vulkan', 'glfw3'])
 w.newline()
 
@@ -559,18 +569,28 @@ build('util/sorted_set.c')
 build('util/strdup.c')
 w.newline()
 
-build('tools/generate-dfield/generate-dfield.c')
+build('tools/generate-dfield/generate-dfield.c', cflags='$cflags -fopenmp')
+build('tools/generate-dfield/image.c', packages=['libpng'])
+build('tools/generate-dfield/cache.c')
+build('tools/generate-dfield/svg.c')
 build('tools/generate-dfield/args_argp.c',
       cflags='$cflags -Wno-missing-field-initializers')
 build('tools/generate-dfield/args_getopt.c')
 w.newline()
 
+build('tools/pack-dfield/pack-dfield.c')
+w.newline()
+
+build('test/bench-dfield.c', cflags='$cflags -fopenmp')
+w.newline()
+
 build('quat.c',
       input_prefix='libs/quat/src/', output_prefix='$builddir/libs/quat/')
 w.newline()
 
 build('shaders/vertex.glsl', rule='glslc', stage='vertex')
 build('shaders/fragment.glsl', rule='glslc', stage='fragment')
+build('shaders/cull.glsl', rule='glslc', stage='compute')
 w.newline()
 
 #
@@ -581,6 +601,7 @@ w.comment('output products')
 
 all_targets = []
 tools_targets = []
+test_tools_targets = []
 
 def bin_target(name,
                inputs,
@@ -640,7 +661,8 @@ bin_target(
         ],
         implicit_inputs = [
             '$builddir/shaders/vertex.spv',
-            '$builddir/shaders/fragment.spv'
+            '$builddir/shaders/fragment.spv',
+            '$builddir/shaders/cull.spv'
         ],
         variables = [
             ('libs', '-lm $vulkan_libs $glfw3_libs $lzma_libs -fopenmp $windows')
@@ -654,6 +676,9 @@ bin_target(
         name = 'tools/generate-dfield',
         inputs = [
             '$builddir/tools/generate-dfield/generate-dfield.o',
+            '$builddir/tools/generate-dfield/image.o',
+            '$builddir/tools/generate-dfield/cache.o',
+            '$builddir/tools/generate-dfield/svg.o',
             '$builddir/dfield.o',
             '$builddir/util/strdup.o'
         ],
@@ -664,15 +689,52 @@ bin_target(
             '$builddir/tools/generate-dfield/args_getopt.o'
         ],
         variables = [
-            ('libs', '-lm -fopenmp $lzma_libs')
+            ('libs', '-lm -fopenmp $lzma_libs $libpng_libs')
         ],
         is_disabled = 'generate-dfield' in args.disable_tool,
         why_disabled = 'we were generated with --disable-tool=generate-dfield',
         targets = [all_targets, tools_targets]
     )
 
+bin_target(
+        name = 'tools/pack-dfield',
+        inputs = [
+            '$builddir/tools/pack-dfield/pack-dfield.o',
+            '$builddir/dfield.o'
+        ],
+        variables = [
+            ('libs', '-lm -fopenmp $lzma_libs')
+        ],
+        is_disabled = 'pack-dfield' in args.disable_tool,
+        why_disabled = 'we were generated with --disable-tool=pack-dfield',
+        targets = [all_targets, tools_targets]
+    )
+
+bin_target(
+        name = 'test/bench-dfield',
+        inputs = [
+            '$builddir/test/bench-dfield.o',
+            '$builddir/tools/generate-dfield/image.o',
+            '$builddir/dfield.o'
+        ],
+        variables = [
+            ('libs', '-lm -fopenmp $lzma_libs $libpng_libs')
+        ],
+        is_disabled = 'bench-dfield' in args.disable_test_tool,
+        why_disabled =
+            'we were generated with --disable-test-tool=bench-dfield',
+        targets = [test_tools_targets]
+    )
+
+# running the benchmark (ninja bench-dfield) always reruns it, printing its
+# results to the console
+if 'bench-dfield' not in args.disable_test_tool:
+    w.build('bench-dfield', 'run', exesuffix('test/bench-dfield',
+                                             args.build == 'w64'))
+    w.newline()
+
 #
-# ALL, TOOLS, AND DEFAULT
+# ALL, TOOLS, TEST TOOLS, AND DEFAULT
 #
 
 if len(tools_targets) > 0:
@@ -681,6 +743,13 @@ else:
     w.comment('NOTE: no tools target because there are no enabled tools')
 w.newline()
 
+if len(test_tools_targets) > 0:
+    w.build('test-tools', 'phony', test_tools_targets)
+else:
+    w.comment('NOTE: no test-tools target because there are no enabled ' +
+              'test tools')
+w.newline()
+
 w.build('all', 'phony', all_targets)
 w.newline()
 
@@ -23,13 +23,123 @@
 #define DFIELD_H
 
 #include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
 
-/* a signed distance field */
+/* the layouts a dfield's data can have */
+enum dfield_format {
+    DFIELD_FORMAT_SDF = 0, /* one signed distance per texel */
+    DFIELD_FORMAT_MSDF, /* four values per texel: three channels of a
+                         * multi-channel field (the median of which is the
+                         * signed distance, but with corners kept sharp)
+                         * followed by the plain signed distance
+                         */
+    DFIELD_FORMAT_BC4 /* the plain signed distance, block compressed as BC4
+                       * SNORM (the layout of VK_FORMAT_BC4_SNORM_BLOCK): each
+                       * 4x4 block of texels (which may hang over the right
+                       * and bottom edges) in eight bytes, in rows of blocks
+                       */
+};
+
+/* the ways a dfield file's data can be compressed */
+enum dfield_codec {
+    DFIELD_CODEC_LZMA = 0, /* an xz stream: the smallest files, but the
+                            * slowest to decode
+                            */
+    DFIELD_CODEC_LZ /* a built-in LZ77 codec (with no dependencies) that
+                     * gives larger files but decodes many times faster
+                     */
+};
+
+/* the reversible filters a dfield file's data can go through before it is
+ * compressed
+ */
+enum dfield_filter {
+    DFIELD_FILTER_NONE = 0, /* compress the texels as they are */
+    DFIELD_FILTER_MEDIAN /* compress each texel's difference from the median
+                          * of three predictions of its channel from its
+                          * neighbors (the gradient, and the extrapolations
+                          * along its row and column). this shrinks LZMA
+                          * files of clean fields of 128 texels and up by a
+                          * quarter to a half, but it barely helps LZ files
+                          * and makes fields of 32 texels or less, and noisy
+                          * ones, larger (bench-dfield prints the sizes)
+                          */
+};
+
+/* how dfield_to_file_encoded writes a dfield */
+struct dfield_encoding {
+    enum dfield_codec codec;
+    enum dfield_filter filter;
+    int32_t band_rows; /* if non-zero, split each level into bands of this
+                        * many rows that are filtered and compressed on their
+                        * own, so that they can be compressed and
+                        * decompressed in parallel
+                        */
+    int32_t threads; /* if more than 1, compress LZMA data that isn't split
+                      * into bands with liblzma's multi-threaded encoder
+                      * using this many threads (the file is still one xz
+                      * stream, and decodes the same way)
+                      */
+};
+
+/* a signed distance field
+ *
+ * width and height are the size of the first level. a dfield with more than
+ * one level is a mip chain: each level is half the size of the last (rounding
+ * down, to a minimum of 1) and data holds them all, largest first
+ *
+ * texels with more than one channel (see enum dfield_format) have their
+ * channels stored next to each other
+ */
 struct dfield {
     int32_t width, height;
+    int32_t levels;
+    enum dfield_format format;
     int8_t * data;
 };
 
+/* a source of input rows, for dfield_generate_tiled (or, via
+ * dfield_input_read_all, anything else)
+ */
+struct dfield_input;
+
+/* a pack of many uncompressed dfields, mapped into memory (see
+ * dfield_pack_open)
+ */
+struct dfield_pack;
+
+/* a segment of an outline of a dfield_shape: a line (degree 1) or a
+ * quadratic or cubic bezier curve (degree 2 or 3), with its degree + 1
+ * control points (x and y interleaved). each segment starts where the one
+ * before it ends, unless it starts a new outline
+ */
+struct dfield_shape_segment {
+    int32_t degree;
+    bool starts_outline;
+    double points[8];
+};
+
+/* a shape made of closed outlines of lines and bezier curves, to generate
+ * dfields from directly (see dfield_generate_from_shape)
+ *
+ * the library only reads shapes. generate-dfield builds them from SVG (see
+ * tools/generate-dfield/svg.h)
+ */
+struct dfield_shape {
+    size_t n_segments, capacity; /* capacity is for whoever builds it */
+    struct dfield_shape_segment * segments;
+    bool has_view_box; /* if false, coordinates are in input texels */
+    double view_x, view_y,
+           view_width, view_height;
+};
+
+/* one of the fields to be generated by dfield_generate_multiple */
+struct dfield_output {
+    int32_t width, height;
+    int32_t spread;
+};
+
 /* the result of the operations in this file */
 enum dfield_result {
     DFIELD_RESULT_OKAY = 0,
@@ -53,9 +163,97 @@ enum dfield_result {
     DFIELD_RESULT_ERROR_BAD_SPREAD, /* value passed for spread is invalid */
 
     DFIELD_RESULT_ERROR_LZMA, /* error with lzma library */
-    DFIELD_RESULT_ERROR_BAD_DECOMPRESSED_SIZE /* post-decompression size
-                                               * doesn't match the header
-                                               */
+    DFIELD_RESULT_ERROR_BAD_DECOMPRESSED_SIZE, /* post-decompression size
+                                                * doesn't match the header
+                                                */
+    DFIELD_RESULT_ERROR_BAD_ALGORITHM, /* value passed for algorithm is
+                                        * invalid
+                                        */
+    DFIELD_RESULT_ERROR_BAD_LEVELS, /* level count in the header is invalid,
+                                     * or the dfields passed to
+                                     * dfield_combine_levels don't form a
+                                     * mip chain
+                                     */
+    DFIELD_RESULT_ERROR_VERSION, /* the header version isn't one we know */
+    DFIELD_RESULT_ERROR_BAD_TILE_SIZE, /* value passed for tile_size is
+                                        * invalid
+                                        */
+    DFIELD_RESULT_ERROR_BAD_FORMAT, /* format in the header is invalid, the
+                                     * dfields passed to dfield_combine_levels
+                                     * don't all have the same format, or the
+                                     * dfield passed to dfield_encode_bc4 or
+                                     * dfield_decode_bc4 has the wrong one
+                                     */
+    DFIELD_RESULT_ERROR_BAD_PATH, /* shape path data (or the SVG holding it)
+                                   * couldn't be parsed, or uses something we
+                                   * don't support
+                                   */
+    DFIELD_RESULT_ERROR_BAD_IMAGE, /* an image file's header is invalid, or
+                                    * it is of a kind we don't support
+                                    */
+    DFIELD_RESULT_ERROR_BAD_CODEC, /* codec in the header (or passed to
+                                    * dfield_to_file_encoded) is invalid
+                                    */
+    DFIELD_RESULT_ERROR_BAD_COMPRESSED_DATA, /* compressed data (other than
+                                              * LZMA, which has its own
+                                              * error) is invalid
+                                              */
+    DFIELD_RESULT_ERROR_BAD_FILTER, /* filter in the header (or passed to
+                                     * dfield_to_file_encoded) is invalid
+                                     */
+    DFIELD_RESULT_ERROR_BAD_BAND_ROWS, /* band rows in the header (or passed
+                                        * to dfield_to_file_encoded) are
+                                        * invalid
+                                        */
+    DFIELD_RESULT_ERROR_BAD_PACK, /* a pack's directory is invalid, or a
+                                   * name passed to dfield_pack_write is too
+                                   * long
+                                   */
+    DFIELD_RESULT_ERROR_DESTINATION_SIZE /* the destination passed to
+                                          * dfield_from_file_into is too
+                                          * small for the data
+                                          */
+};
+
+/* the algorithms dfield_generate can use */
+enum dfield_algorithm {
+    DFIELD_ALGORITHM_BRUTE_FORCE = 0, /* scan the (2 * spread + 1)^2
+                                       * neighborhood of every output texel
+                                       */
+    DFIELD_ALGORITHM_EDT, /* compute an exact euclidean distance transform of
+                           * the whole input once (in linear time) and then
+                           * sample it
+                           *
+                           * this matches DFIELD_ALGORITHM_BRUTE_FORCE exactly
+                           * wherever the distance is within spread. beyond
+                           * that it finds the true nearest texel instead of
+                           * the nearest one inside the neighborhood.
+                           */
+    DFIELD_ALGORITHM_BITPLANE, /* the same search as
+                                * DFIELD_ALGORITHM_BRUTE_FORCE (with identical
+                                * output) over a bit-packed copy of the input,
+                                * scanning whole words of each neighborhood
+                                * row at a time and using SSE4.1 or AVX2 when
+                                * the CPU has them
+                                */
+    DFIELD_ALGORITHM_MSDF, /* trace the outline of the input into polygons
+                            * and generate a DFIELD_FORMAT_MSDF field from
+                            * them
+                            *
+                            * the median of its channels matches
+                            * DFIELD_ALGORITHM_BRUTE_FORCE away from corners
+                            * (to within rounding) but stays sharp at them, so
+                            * a much smaller field gives the same edges
+                            */
+    DFIELD_ALGORITHM_COVERAGE /* treat the input as anti-aliased coverage (0
+                               * is off, 255 is on, and values between are
+                               * partly covered) and measure to where each
+                               * edge passes through its texels, so a smaller
+                               * rasterization gives the same accuracy
+                               *
+                               * on hard (0 to 255) edges this matches
+                               * DFIELD_ALGORITHM_EDT to within rounding
+                               */
 };
 
 /* get a string representation of an error. valid forever unless result is
@@ -64,6 +262,52 @@ enum dfield_result {
  */
 const char * dfield_result_string(enum dfield_result result);
 
+/* look up an algorithm by its name ("brute-force", "edt", "bitplane", "msdf",
+ * or "coverage") and put it in algorithm_out
+ *
+ * returns true on success, false if there is no algorithm with this name
+ */
+bool dfield_algorithm_from_name(
+        const char * name,
+        enum dfield_algorithm * algorithm_out
+    ) [[gnu::nonnull(1, 2)]];
+
+/* look up a codec by its name ("lzma" or "lz") and put it in codec_out
+ *
+ * returns true on success, false if there is no codec with this name
+ */
+bool dfield_codec_from_name(
+        const char * name,
+        enum dfield_codec * codec_out
+    ) [[gnu::nonnull(1, 2)]];
+
+/* look up a filter by its name ("none" or "median") and put it in
+ * filter_out
+ *
+ * returns true on success, false if there is no filter with this name
+ */
+bool dfield_filter_from_name(
+        const char * name,
+        enum dfield_filter * filter_out
+    ) [[gnu::nonnull(1, 2)]];
+
+/* the number of channels per texel of a dfield with this format (which, but
+ * for DFIELD_FORMAT_BC4, is also the number of bytes)
+ */
+int32_t dfield_format_channels(enum dfield_format format);
+
+/* the width of this level of a dfield whose first level is this wide (this
+ * also works for the height)
+ */
+int32_t dfield_level_width(int32_t width, int32_t level);
+
+/* the number of bytes of data in this level of this dfield */
+size_t dfield_level_size(
+        const struct dfield * dfield, int32_t level) [[gnu::nonnull(1)]];
+
+/* the number of bytes of data in this dfield (all levels) */
+size_t dfield_data_size(const struct dfield * dfield) [[gnu::nonnull(1)]];
+
 /* load a dfield from this file and put it in dfield_out
  *
  * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
@@ -71,6 +315,30 @@ const char * dfield_result_string(enum dfield_result result);
 enum dfield_result dfield_from_file(
         const char * path, struct dfield * dfield_out) [[gnu::nonnull(1, 2)]];
 
+/* read only the header of this dfield file and put what it says (the size,
+ * levels, and format) in dfield_out, with data set to NULL, so that a
+ * destination for dfield_from_file_into can be set aside
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result dfield_header_from_file(
+        const char * path, struct dfield * dfield_out) [[gnu::nonnull(1, 2)]];
+
+/* like dfield_from_file, but decode the data straight into destination
+ * (which holds destination_size bytes, and must hold at least
+ * dfield_data_size of the dfield) instead of a new buffer. the data of the
+ * dfield put in dfield_out is destination, so it must not be passed to
+ * dfield_free
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result dfield_from_file_into(
+        const char * path,
+        void * destination,
+        size_t destination_size,
+        struct dfield * dfield_out
+    ) [[gnu::nonnull(1, 2, 4)]];
+
 /* load raw data (of the sort you could pass to dfield_generate) from this file
  * and put it in data_out
  *
@@ -83,7 +351,79 @@ enum dfield_result dfield_data_from_file(
         uint8_t ** data_out
     ) [[gnu::nonnull(1, 4)]];
 
-/* write this dfield to this file
+/* reads the next row of an input opened by dfield_input_open into row (which
+ * holds width bytes), given the state passed to it
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+typedef enum dfield_result (*dfield_read_row_function)(
+        void * state, uint8_t * row);
+
+/* frees the state of an input opened by dfield_input_open */
+typedef void (*dfield_close_function)(void * state);
+
+/* make an input of this size that reads its rows with read_row and is closed
+ * with close (which may be NULL), passing them state, and put it in input_out
+ *
+ * this is how inputs in formats this file doesn't know about are made
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error. on error,
+ * close is not called
+ */
+enum dfield_result dfield_input_open(
+        int32_t width,
+        int32_t height,
+        dfield_read_row_function read_row,
+        dfield_close_function close,
+        void * state,
+        struct dfield_input ** input_out
+    ) [[gnu::nonnull(3, 6)]];
+
+/* open this file of raw data (of the sort dfield_data_from_file reads) as an
+ * input, putting it in input_out
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result dfield_input_open_raw(
+        const char * path,
+        int32_t width,
+        int32_t height,
+        struct dfield_input ** input_out
+    ) [[gnu::nonnull(1, 4)]];
+
+/* open this binary (P5) PGM file as an input, putting it in input_out. the
+ * size of the input is the size of the image, and its values are scaled so
+ * that the image's maximum value is 255
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result dfield_input_open_pgm(
+        const char * path,
+        struct dfield_input ** input_out
+    ) [[gnu::nonnull(1, 2)]];
+
+/* put the size of this input in width_out and height_out */
+void dfield_input_size(
+        const struct dfield_input * input,
+        int32_t * width_out,
+        int32_t * height_out
+    ) [[gnu::nonnull(1, 2, 3)]];
+
+/* read all the rows of this input (none of which may have been read yet)
+ * into one buffer of raw data (of the sort you could pass to
+ * dfield_generate) and put it in data_out
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result dfield_input_read_all(
+        struct dfield_input * input,
+        uint8_t ** data_out
+    ) [[gnu::nonnull(1, 2)]];
+
+/* close this input and free it */
+void dfield_input_close(struct dfield_input * input) [[gnu::nonnull(1)]];
+
+/* write this dfield to this file, compressed with DFIELD_CODEC_LZMA
  *
  * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
  */
@@ -92,9 +432,23 @@ enum dfield_result dfield_to_file(
         const struct dfield * dfield
     ) [[gnu::nonnull(1, 2)]];
 
+/* like dfield_to_file, but writing the dfield the way this encoding says
+ *
+ * the encoding is recorded in the file, so dfield_from_file reads any of
+ * them (and decodes the bands of a banded dfield in parallel)
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result dfield_to_file_encoded(
+        const char * path,
+        const struct dfield * dfield,
+        const struct dfield_encoding * encoding
+    ) [[gnu::nonnull(1, 2, 3)]];
+
 /* using this data (which should be boolean-like black and white data, with
- * 0 treated as black and all other values treated as white) generate a
- * distance field of this size with this spread value
+ * 0 treated as black and all other values treated as white, unless the
+ * algorithm is DFIELD_ALGORITHM_COVERAGE) generate a distance field of this
+ * size with this spread value, using this algorithm
  *
  * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
  */
@@ -105,9 +459,163 @@ enum dfield_result dfield_to_file(
         int32_t output_width,
         int32_t output_height,
         int32_t spread,
+        enum dfield_algorithm algorithm,
         struct dfield * dfield_out
     ) [[gnu::nonnull(1)]];
 
+/* like dfield_generate, but generate a distance field for each of these
+ * n_outputs outputs (putting them in the corresponding entries of
+ * dfields_out) while only reading and preparing the input once
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error. on error,
+ * nothing is put in dfields_out
+ */
+[[nodiscard]] enum dfield_result dfield_generate_multiple(
+        uint8_t * data,
+        int32_t input_width,
+        int32_t input_height,
+        size_t n_outputs,
+        const struct dfield_output * outputs,
+        enum dfield_algorithm algorithm,
+        struct dfield * dfields_out
+    ) [[gnu::nonnull(1, 5, 7)]];
+
+/* like dfield_generate_multiple (with DFIELD_ALGORITHM_BRUTE_FORCE, whose
+ * output this matches exactly) but streaming rows from this input instead of
+ * holding all of it in memory
+ *
+ * only the input rows within spread of the output rows being worked on are
+ * kept, and the output is generated in square tiles of tile_size texels, so
+ * memory use is bounded by the input width and spread rather than the input
+ * size
+ *
+ * the input is read from its current position to the end, and is not closed
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error. on error,
+ * nothing is put in dfields_out
+ */
+[[nodiscard]] enum dfield_result dfield_generate_tiled(
+        struct dfield_input * input,
+        size_t n_outputs,
+        const struct dfield_output * outputs,
+        int32_t tile_size,
+        struct dfield * dfields_out
+    ) [[gnu::nonnull(1, 3, 5)]];
+
+/* like dfield_generate_multiple, but generating the fields straight from the
+ * outlines of this shape (with its view box, if it has one, stretched over an
+ * input of this size) instead of from raster data
+ *
+ * the distances are measured to the outlines themselves (with curves
+ * flattened to within a small fraction of an input texel), so there is no
+ * raster to lose accuracy to. DFIELD_ALGORITHM_MSDF gives a DFIELD_FORMAT_MSDF
+ * field, and every other algorithm the same DFIELD_FORMAT_SDF field, which
+ * matches what they would give for a rasterization of the shape (to within
+ * that rasterization's accuracy)
+ *
+ * outlines that overlap each other are filled correctly, but distances are
+ * measured to all of them, including the parts inside the filled area
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error. on error,
+ * nothing is put in dfields_out
+ */
+[[nodiscard]] enum dfield_result dfield_generate_from_shape(
+        const struct dfield_shape * shape,
+        int32_t input_width,
+        int32_t input_height,
+        size_t n_outputs,
+        const struct dfield_output * outputs,
+        enum dfield_algorithm algorithm,
+        struct dfield * dfields_out
+    ) [[gnu::nonnull(1, 5, 7)]];
+
+/* combine these n_levels single-level dfields, each half the size of the last
+ * (rounding down, to a minimum of 1), into one dfield with that many levels
+ * and put it in dfield_out
+ *
+ * the dfields passed in are not modified or freed
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result dfield_combine_levels(
+        const struct dfield * levels,
+        int32_t n_levels,
+        struct dfield * dfield_out
+    ) [[gnu::nonnull(1, 3)]];
+
+/* block compress this DFIELD_FORMAT_SDF dfield (every level of it) into a new
+ * DFIELD_FORMAT_BC4 dfield of the same size, at half the size in memory, and
+ * put it in dfield_out
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result dfield_encode_bc4(
+        const struct dfield * dfield,
+        struct dfield * dfield_out
+    ) [[gnu::nonnull(1, 2)]];
+
+/* decompress this DFIELD_FORMAT_BC4 dfield (every level of it) into a new
+ * DFIELD_FORMAT_SDF dfield, for when BC4 textures aren't supported, and put
+ * it in dfield_out
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result dfield_decode_bc4(
+        const struct dfield * dfield,
+        struct dfield * dfield_out
+    ) [[gnu::nonnull(1, 2)]];
+
+/* write these n_dfields dfields to a pack file at this path, under these
+ * names (which may be up to 65535 bytes long)
+ *
+ * the dfields are stored uncompressed, each starting on a page boundary, so
+ * that dfield_pack_open can map them straight into memory
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result dfield_pack_write(
+        const char * path,
+        size_t n_dfields,
+        const char * const * names,
+        const struct dfield * dfields
+    ) [[gnu::nonnull(1)]];
+
+/* open the pack at this path and put it in pack_out
+ *
+ * the file is mapped into memory (or, where that isn't supported, read into
+ * it), so this does no decoding and only its directory is read up front
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result dfield_pack_open(
+        const char * path,
+        struct dfield_pack ** pack_out
+    ) [[gnu::nonnull(1, 2)]];
+
+/* the number of dfields in this pack */
+size_t dfield_pack_count(
+        const struct dfield_pack * pack) [[gnu::nonnull(1)]];
+
+/* the name of the dfield at this index of this pack */
+const char * dfield_pack_name(
+        const struct dfield_pack * pack, size_t index) [[gnu::nonnull(1)]];
+
+/* look up the dfield with this name in this pack and put it in dfield_out
+ *
+ * its data points into the pack: it must not be written to or passed to
+ * dfield_free, and is only valid until the pack is closed
+ *
+ * returns true on success, false if there is no dfield with this name
+ */
+bool dfield_pack_find(
+        const struct dfield_pack * pack,
+        const char * name,
+        struct dfield * dfield_out
+    ) [[gnu::nonnull(1, 2, 3)]];
+
+/* close a pack, invalidating the dfields found in it */
+void dfield_pack_close(struct dfield_pack * pack);
+
 /* free the data associated with a dfield
  *
  * this is equivalent to free(dfield->data)
@@ -38,6 +38,12 @@ struct renderer_configuration {
     /* what size of dfield to load */
     uint32_t field_size;
 
+    /* a dfield pack (see dfield_pack_open) to take textures from instead of
+     * loading their files, or NULL. textures that aren't in it are still
+     * loaded from their files
+     */
+    const char * texture_pack;
+
     /* how many antialiasing samples?
      * must be one of 1, 2, 4, 8, 16, 32, or 64 */
     uint32_t msaa_samples;
@@ -48,6 +54,21 @@ struct renderer_configuration {
     /* whether to enable sample shading */
     bool sample_shading;
 
+    /* whether to cull objects on the CPU instead of with a compute shader
+     * (this is always done if the device is a CPU, like software Vulkan)
+     */
+    bool cpu_culling;
+
+    /* how many threads record draws into secondary command buffers (0 for,
+     * and at most, as many as OpenMP would use)
+     */
+    uint32_t record_threads;
+
+    /* whether to log, every 100 frames, how many bytes of objects were
+     * written and how long culling on the CPU took
+     */
+    bool frame_statistics;
+
     /* resolution (0 to inherit from monitor) */
     uint32_t width, height;
 
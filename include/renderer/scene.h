@@ -37,6 +37,9 @@ struct object {
     uint32_t solid_index,
              outline_index,
              glow_index;
+    uint64_t changed; /* the scene generation this object was last changed
+                       * in (see scene_object_changed)
+                       */
 };
 
 struct camera {
@@ -57,6 +60,10 @@ struct scene {
     size_t n_objects;
     struct object * objects;
     void (*step)(struct scene * scene, double delta_time);
+    uint64_t generation; /* advanced by the renderer before each step, so
+                          * that it only writes out the objects that have
+                          * changed since it last wrote them
+                          */
 
     struct camera camera;
     struct camera_queue * queue;
@@ -75,6 +82,11 @@ struct camera_queue {
 
 void scene_load_soho(struct scene * scene);
 
+/* call this after changing the object at this index (after loading), so that
+ * the renderer writes it out again
+ */
+void scene_object_changed(struct scene * scene, size_t index);
+
 void scene_destroy(struct scene * scene);
 
 #endif /* RENDERER_SCENE_H */
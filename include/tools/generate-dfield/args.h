@@ -21,19 +21,48 @@
 #ifndef TOOLS_GENERATE_DFIELD_ARGS
 #define TOOLS_GENERATE_DFIELD_ARGS
 
+#include "dfield.h"
+
 #include <stdint.h>
 #include <stdbool.h>
 
 /* the result of parse_args */
 struct arguments
 {
-    int32_t output_width,
-            output_height,
-            input_width,
+    int32_t input_width,
             input_height,
             spread;
+    size_t n_outputs;
+    struct dfield_output * outputs; /* an output with a spread of 0 uses the
+                                     * spread field above
+                                     */
+    bool mipmaps; /* write the outputs as levels of one file */
+    enum dfield_algorithm algorithm;
+    enum dfield_codec codec; /* how the outputs are compressed */
+    enum dfield_filter filter; /* how the outputs are filtered before that */
+    int32_t band_rows; /* if non-zero, compress the outputs in bands of this
+                        * many rows (see struct dfield_encoding)
+                        */
+    bool bc4; /* block compress the outputs (see dfield_encode_bc4) */
+    bool vector; /* read the input as a shape (see svg_shape_from_file)
+                  * instead of raw data
+                  */
+    bool white_transparent; /* read opaque white in a PNG input with alpha
+                             * as transparent (see image_input_open_png)
+                             */
+    int32_t tile_size; /* if non-zero, stream the input and generate in tiles
+                        * of this size (see dfield_generate_tiled)
+                        */
     char * input_path,
          * output_path;
+    char * batch_path; /* if non-NULL, run the jobs listed in this manifest
+                        * instead of the one given by input_path and
+                        * output_path (which may then be NULL)
+                        */
+    char * cache_path; /* if non-NULL, a directory of outputs generated
+                        * before, which are copied instead of generated again
+                        * when the input and options are the same
+                        */
 };
 
 /* parse this argv and argc, storing the result in args
@@ -0,0 +1,72 @@
+/* File: include/tools/generate-dfield/cache.h
+ * Part of snrkos <github.com/rmkrupp/snrkos>
+ *
+ * Copyright (C) 2025 Noah Santer <n.ed.santer@gmail.com>
+ * Copyright (C) 2025 Rebecca Krupp <beka.krupp@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TOOLS_GENERATE_DFIELD_CACHE
+#define TOOLS_GENERATE_DFIELD_CACHE
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/* the name of an entry in a cache: a hash (128-bit FNV-1a) of everything that
+ * goes into making it, built up with cache_key_add and cache_key_add_file
+ */
+struct cache_key {
+    unsigned __int128 hash;
+};
+
+/* start a new key */
+void cache_key_init(struct cache_key * key) [[gnu::nonnull(1)]];
+
+/* add these size bytes to this key */
+void cache_key_add(
+        struct cache_key * key,
+        const void * data,
+        size_t size
+    ) [[gnu::nonnull(1, 2)]];
+
+/* add the contents of the file at this path to this key
+ *
+ * returns false (setting errno) if the file couldn't be read
+ */
+bool cache_key_add_file(
+        struct cache_key * key, const char * path) [[gnu::nonnull(1, 2)]];
+
+/* if the cache in this directory has an entry for this key, copy it to path
+ *
+ * returns true on a hit, and false on a miss (or if the copy failed)
+ */
+bool cache_fetch(
+        const char * directory,
+        const struct cache_key * key,
+        const char * path
+    ) [[gnu::nonnull(1, 2, 3)]];
+
+/* store a copy of the file at path in the cache in this directory (creating
+ * it if it doesn't exist) under this key. entries appear whole or not at all,
+ * so many processes (or threads) can share a cache
+ *
+ * returns false (setting errno) on error
+ */
+bool cache_store(
+        const char * directory,
+        const struct cache_key * key,
+        const char * path
+    ) [[gnu::nonnull(1, 2, 3)]];
+
+#endif /* TOOLS_GENERATE_DFIELD_CACHE */
@@ -0,0 +1,57 @@
+/* File: include/tools/generate-dfield/image.h
+ * Part of snrkos <github.com/rmkrupp/snrkos>
+ *
+ * Copyright (C) 2025 Noah Santer <n.ed.santer@gmail.com>
+ * Copyright (C) 2025 Rebecca Krupp <beka.krupp@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TOOLS_GENERATE_DFIELD_IMAGE
+#define TOOLS_GENERATE_DFIELD_IMAGE
+
+#include "dfield.h"
+
+/* the kinds of input file generate-dfield reads */
+enum image_kind {
+    IMAGE_KIND_RAW = 0, /* headerless bytes, with the size given separately */
+    IMAGE_KIND_PGM, /* a binary (P5) PGM */
+    IMAGE_KIND_PNG
+};
+
+/* work out what kind of input file this is from the bytes at its start
+ *
+ * anything that isn't recognizably something else (including a file that
+ * can't be read) is IMAGE_KIND_RAW
+ */
+enum image_kind image_kind_of_file(const char * path) [[gnu::nonnull(1)]];
+
+/* open this PNG file as an input, putting it in input_out
+ *
+ * the input is the image's alpha channel if it has one, and otherwise its
+ * gray level (converting color to gray), at 8 bits. rows are decoded as they
+ * are read, unless the image is interlaced
+ *
+ * if white_transparent is true, opaque white texels of an image with alpha
+ * are read as transparent (as ImageMagick's -transparent "#FFFFFFFF" makes
+ * them), so that a white background counts as off
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result image_input_open_png(
+        const char * path,
+        bool white_transparent,
+        struct dfield_input ** input_out
+    ) [[gnu::nonnull(1, 3)]];
+
+#endif /* TOOLS_GENERATE_DFIELD_IMAGE */
@@ -0,0 +1,60 @@
+/* File: include/tools/generate-dfield/svg.h
+ * Part of snrkos <github.com/rmkrupp/snrkos>
+ *
+ * Copyright (C) 2025 Noah Santer <n.ed.santer@gmail.com>
+ * Copyright (C) 2025 Rebecca Krupp <beka.krupp@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TOOLS_GENERATE_DFIELD_SVG
+#define TOOLS_GENERATE_DFIELD_SVG
+
+#include "dfield.h"
+
+/* parse this SVG path data (the d attribute of a <path>) into a new shape,
+ * whose coordinates are in input texels, and put it in shape_out
+ *
+ * the M, L, H, V, C, S, Q, T, and Z commands (and their relative forms) are
+ * supported, but not arcs (A). every outline is closed, as it is when SVG
+ * fills a path
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result svg_shape_from_path(
+        const char * path_data,
+        struct dfield_shape ** shape_out
+    ) [[gnu::nonnull(1, 2)]];
+
+/* load a shape from this file and put it in shape_out
+ *
+ * the file holds either bare SVG path data (as for svg_shape_from_path) or
+ * an SVG document, in which case the outlines of all its <path> elements are
+ * used, in the coordinates of the view box of its <svg> element (styles are
+ * ignored, everything is filled by the nonzero rule, and paths inside <defs>,
+ * <clipPath>, <mask>, <marker>, <pattern>, and <symbol> aren't drawn)
+ *
+ * transforms aren't supported, so a document with any transform attribute is
+ * DFIELD_RESULT_ERROR_BAD_PATH
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result svg_shape_from_file(
+        const char * path,
+        struct dfield_shape ** shape_out
+    ) [[gnu::nonnull(1, 2)]];
+
+/* free a shape made by svg_shape_from_path or svg_shape_from_file */
+void svg_shape_free(struct dfield_shape * shape);
+
+#endif /* TOOLS_GENERATE_DFIELD_SVG */
@@ -20,35 +20,32 @@
 # along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 if [ $# -lt 1 ] ; then
-    echo "Syntax: $0 OUTPUT_SIZE"
+    echo "Syntax: $0 OUTPUT_SIZE..."
     exit 1
 fi
 
 #
 # TODO: this shouldn't always be square
-# TODO: we should support creating multiple resolutions from each input
 #
 
-in=4096
-out="$1"
-spread="$1"
+in=1024
 dir="$(mktemp -d)"
 mkdir -p "$dir"
-outdir="out/data/$out"
-mkdir -p "$outdir"
+outdir="out/data/%w"
+# each size gets a spread of a quarter of that size
+sizes=()
+for out in "$@" ; do
+    mkdir -p "out/data/$out"
+    sizes+=(-O "$out:$((out / 4))")
+done
 template="data/template.svg"
+# rasterize every glyph first, and then generate all their dfields in one batch
 function dfield() {
-    echo generate "$1"
+    echo rasterize "$1"
     sed 's/TEMPLATE/'"$1"'/' "$template" >"$dir/input.svg"
-    inkscape -C -o "$dir/input.png" -w "$in" -h "$in" "$dir/input.svg" || exit 1
-    magick "$dir/input.png" -transparent "#FFFFFFFF" -alpha Extract \
-        "gray:$dir/input.dat" || exit 1
-    ./tools/generate-dfield -I "$in" -O "$out" -S "$spread" \
-        "$outdir/$1.dfield" "$dir/input.dat" || exit 1
-    #magick -depth 8 -size "$out"x"$out" "gray:$outdir/$1.dfield" "$outdir/$1.png"
+    inkscape -C -o "$dir/$1.png" -w "$in" -h "$in" "$dir/input.svg" || exit 1
+    echo "$outdir/$1.dfield $dir/$1.png" >>"$dir/manifest"
     rm "$dir/input.svg"
-    rm "$dir/input.png"
-    rm "$dir/input.dat"
 }
 
 #for i in \~ \` ! @ \# \$ % ^ \& '*' \(  \) _ - = + \[ \] \{ \} \| \\ : \; \' \" , "." \< \> / ? ; do dfield "$i" ; done
@@ -56,4 +53,10 @@ for i in {0..9} ; do dfield $i ; done
 for i in {a..z} ; do dfield $i ; done
 for i in {A..Z} ; do dfield $i ; done
 
+# generate-dfield reads the alpha channel of each rendering directly, with
+# opaque white counting as transparent
+./tools/generate-dfield "${sizes[@]}" -A coverage -W \
+    --cache "${DFIELD_CACHE:-out/cache}" --batch "$dir/manifest" || exit 1
+rm -r "$dir"
+
 
@@ -20,27 +20,30 @@
 # along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 if [ $# -lt 2 ] ; then
-    echo "Syntax: $0 INPUT_SVG OUTPUT_SIZE"
+    echo "Syntax: $0 INPUT_SVG OUTPUT_SIZE..."
     exit 1
 fi
 
 #
 # TODO: this shouldn't always be square
-# TODO: we should support creating multiple resolutions from each input
 #
 
-in=4098
-out="$2"
-spread="128"
+in=1024
+spread="32"
 dir="$(mktemp -d)"
 mkdir -p "$dir/$(dirname $1)"
-outdir="out/$(dirname "$1")/$2"
+outdir="out/$(dirname "$1")/%w"
 outbase="$(basename "$1")"
-mkdir -p "$outdir"
+sizes=()
+for out in "${@:2}" ; do
+    mkdir -p "out/$(dirname "$1")/$out"
+    sizes+=(-O "$out")
+done
+# generate-dfield reads the alpha channel of the rendering directly, with
+# opaque white counting as transparent
 inkscape -C -o "$dir/${1%.svg}.png" -w "$in" -h "$in" "$1" || exit 1
-magick "$dir/${1%.svg}.png" -transparent "#FFFFFFFF" -alpha Extract \
-    "gray:$dir/${1%.svg}.dat" || exit 1
-./tools/generate-dfield -I "$in" -O "$out" -S "$spread" \
-    "$outdir/${outbase%.svg}.dfield" "$dir/${1%.svg}.dat" || exit 1
+./tools/generate-dfield "${sizes[@]}" -S "$spread" -A coverage -W \
+    --cache "${DFIELD_CACHE:-out/cache}" \
+    "$outdir/${outbase%.svg}.dfield" "$dir/${1%.svg}.png" || exit 1
 #magick -depth 8 -size "$2x$2" "gray:$outdir/${outbase%.svg}.dfield" "$outdir/${outbase%.svg}.png"
 
@@ -30,15 +30,84 @@
 
 #include <lzma.h>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif /* _WIN32 */
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif /* defined(__x86_64__) || defined(__i386__) */
+
 /* preset to use when compressing dfield data */
 constexpr uint32_t lzma_preset = 6;
 
 /* hint to lzma for max memory to use, UINT64_MAX for no limit */
 constexpr uint64_t lzma_memory_usage_limit = UINT64_MAX;
 
+/* how much compressed data to read at once when decompressing LZMA */
+constexpr size_t lzma_read_buffer_size = 64 * 1024;
+
+/* how much compressed data to write at once when compressing LZMA */
+constexpr size_t lzma_write_buffer_size = 64 * 1024;
+
+/* the smallest block the multi-threaded LZMA encoder splits the data into,
+ * since each block starts over with an empty dictionary
+ */
+constexpr uint64_t lzma_min_block_size = 1024 * 1024;
+
+/* the width (and height) in texels of a DFIELD_FORMAT_BC4 block, and its size
+ * in bytes: two endpoints and sixteen 3-bit indices
+ */
+constexpr int32_t bc4_block_width = 4;
+constexpr size_t bc4_block_size = 8;
+
 /* the magic bytes at the beginning of a dfield file */
 constexpr char magic[] = { 'D', 'F' };
 
+/* the magic bytes at the beginning of a dfield file with an extended header
+ *
+ * these are followed by a one byte version and then the width, height, and
+ * number of levels as int32_ts, (from version 2) the format as one byte,
+ * (from version 3) the codec as one byte, (from version 4) the filter as one
+ * byte, and (from version 5) the number of rows per band (see make_bands, or
+ * 0 for one stream of all the data) as an int32_t. plain unfiltered dfields
+ * compressed with LZMA as one stream are still written with the original
+ * header so that they stay readable everywhere
+ */
+constexpr char magic_extended[] = { 'D', 'X' };
+
+/* the version of the extended header we write */
+constexpr uint8_t extended_version = 5;
+
+/* the magic bytes at the beginning of a dfield pack
+ *
+ * these are followed by a one byte version, the number of dfields as a
+ * uint32_t, and then a directory entry for each: its offset in the file and
+ * size as uint64_ts, its width, height, and number of levels as int32_ts, its
+ * format as one byte, and its name as a uint16_t length and then that many
+ * bytes. the dfields' data follows, each starting at a multiple of
+ * pack_alignment
+ */
+constexpr char magic_pack[] = { 'D', 'P' };
+
+/* the version of the pack format we write */
+constexpr uint8_t pack_version = 1;
+
+/* what the data in a pack is aligned to (the largest common page size) */
+constexpr size_t pack_alignment = 4096;
+
+/* the shortest match the lz codec can encode */
+constexpr size_t lz_min_match = 4;
+
+/* the furthest back a match in the lz codec can be */
+constexpr size_t lz_max_offset = 65535;
+
+/* log2 of the number of entries in the lz encoder's hash table */
+constexpr int lz_hash_bits = 16;
+
 /* get a string representation of an error. valid forever unless result is
  * DFIELD_RESULT_ERRNO, in which case it is valid at least until the next call
  * to dfield_result_string
@@ -65,7 +134,27 @@ const char * dfield_result_string(enum dfield_result result)
             "spread is invalid (n <= 0 or n > 32768)",
         [DFIELD_RESULT_ERROR_LZMA] = "LZMA error",
         [DFIELD_RESULT_ERROR_BAD_DECOMPRESSED_SIZE] =
-            "decompressed size doesn't match size in the header"
+            "decompressed size doesn't match size in the header",
+        [DFIELD_RESULT_ERROR_BAD_ALGORITHM] = "algorithm is invalid",
+        [DFIELD_RESULT_ERROR_BAD_LEVELS] =
+            "levels are invalid (wrong count, or not each half the last)",
+        [DFIELD_RESULT_ERROR_VERSION] = "unsupported header version",
+        [DFIELD_RESULT_ERROR_BAD_TILE_SIZE] = "tile size is invalid (n <= 0)",
+        [DFIELD_RESULT_ERROR_BAD_FORMAT] =
+            "format is invalid (unknown, or levels don't match)",
+        [DFIELD_RESULT_ERROR_BAD_PATH] =
+            "path data is invalid (or uses something unsupported)",
+        [DFIELD_RESULT_ERROR_BAD_IMAGE] =
+            "image is invalid (or of an unsupported kind)",
+        [DFIELD_RESULT_ERROR_BAD_CODEC] = "codec is invalid",
+        [DFIELD_RESULT_ERROR_BAD_COMPRESSED_DATA] =
+            "compressed data is invalid",
+        [DFIELD_RESULT_ERROR_BAD_FILTER] = "filter is invalid",
+        [DFIELD_RESULT_ERROR_BAD_BAND_ROWS] = "band rows are invalid (n < 0)",
+        [DFIELD_RESULT_ERROR_BAD_PACK] =
+            "pack directory is invalid (or a name is too long)",
+        [DFIELD_RESULT_ERROR_DESTINATION_SIZE] =
+            "destination is too small for the data"
     };
 
     if (result < 0 || result > sizeof(strings) / sizeof(*strings)) {
@@ -79,86 +168,193 @@ const char * dfield_result_string(enum dfield_result result)
     return strings[result];
 }
 
-/* load a dfield from this file and put it in dfield_out
+/* look up an algorithm by its name ("brute-force", "edt", "bitplane", "msdf",
+ * or "coverage") and put it in algorithm_out
  *
- * returns 0 on success, non-zero on error
+ * returns true on success, false if there is no algorithm with this name
  */
-enum dfield_result dfield_from_file(
-        const char * path, struct dfield * dfield_out) [[gnu::nonnull(1, 2)]]
+bool dfield_algorithm_from_name(
+        const char * name,
+        enum dfield_algorithm * algorithm_out
+    ) [[gnu::nonnull(1, 2)]]
 {
-    /* open the file */
-    FILE * dfield_file = fopen(path, "rb");
+    const char * names[] = {
+        [DFIELD_ALGORITHM_BRUTE_FORCE] = "brute-force",
+        [DFIELD_ALGORITHM_EDT] = "edt",
+        [DFIELD_ALGORITHM_BITPLANE] = "bitplane",
+        [DFIELD_ALGORITHM_MSDF] = "msdf",
+        [DFIELD_ALGORITHM_COVERAGE] = "coverage"
+    };
 
-    if (!dfield_file) {
-        return DFIELD_RESULT_ERROR_ERRNO;
+    for (size_t i = 0; i < sizeof(names) / sizeof(*names); i++) {
+        if (!strcmp(name, names[i])) {
+            *algorithm_out = (enum dfield_algorithm)i;
+            return true;
+        }
     }
 
-    /* read the header */
-    char magic_in[sizeof(magic)];
-    size_t rd = fread(magic_in, 1, sizeof(magic), dfield_file);
-    if (rd != sizeof(magic)) {
-        fclose(dfield_file);
-        return DFIELD_RESULT_ERROR_READ_SIZE;
+    return false;
+}
+
+/* look up a codec by its name ("lzma" or "lz") and put it in codec_out
+ *
+ * returns true on success, false if there is no codec with this name
+ */
+bool dfield_codec_from_name(
+        const char * name,
+        enum dfield_codec * codec_out
+    ) [[gnu::nonnull(1, 2)]]
+{
+    const char * names[] = {
+        [DFIELD_CODEC_LZMA] = "lzma",
+        [DFIELD_CODEC_LZ] = "lz"
+    };
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(*names); i++) {
+        if (!strcmp(name, names[i])) {
+            *codec_out = (enum dfield_codec)i;
+            return true;
+        }
     }
 
-    for (size_t i = 0; i < sizeof(magic); i++) {
-        if (magic_in[i] != magic[i]) {
-            fclose(dfield_file);
-            return DFIELD_RESULT_ERROR_MAGIC;
+    return false;
+}
+
+/* look up a filter by its name ("none" or "median") and put it in
+ * filter_out
+ *
+ * returns true on success, false if there is no filter with this name
+ */
+bool dfield_filter_from_name(
+        const char * name,
+        enum dfield_filter * filter_out
+    ) [[gnu::nonnull(1, 2)]]
+{
+    const char * names[] = {
+        [DFIELD_FILTER_NONE] = "none",
+        [DFIELD_FILTER_MEDIAN] = "median"
+    };
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(*names); i++) {
+        if (!strcmp(name, names[i])) {
+            *filter_out = (enum dfield_filter)i;
+            return true;
         }
     }
 
-    int32_t size[2];
-    rd = fread(size, 1, sizeof(size), dfield_file);
+    return false;
+}
 
-    if (rd != sizeof(size)) {
-        fclose(dfield_file);
-        return DFIELD_RESULT_ERROR_READ_SIZE;
+/* the largest number of levels a field of this size can have */
+static int32_t max_levels(int32_t width, int32_t height)
+{
+    int32_t largest = width > height ? width : height;
+    int32_t levels = 1;
+    while (largest > 1) {
+        largest >>= 1;
+        levels++;
     }
+    return levels;
+}
 
-    if (size[0] <= 0 || size[1] <= 0) {
-        fclose(dfield_file);
-        return DFIELD_RESULT_ERROR_BAD_SIZE;
+/* the number of channels per texel of a dfield with this format (which, but
+ * for DFIELD_FORMAT_BC4, is also the number of bytes)
+ */
+int32_t dfield_format_channels(enum dfield_format format)
+{
+    return format == DFIELD_FORMAT_MSDF ? 4 : 1;
+}
+
+/* the width of this level of a dfield whose first level is this wide (this
+ * also works for the height)
+ */
+int32_t dfield_level_width(int32_t width, int32_t level)
+{
+    int32_t level_width = width >> level;
+    return level_width > 0 ? level_width : 1;
+}
+
+/* the number of bytes in each of the units a row of data of this format is
+ * made of: a texel, or for DFIELD_FORMAT_BC4 a block
+ */
+static size_t unit_size(enum dfield_format format)
+{
+    return format == DFIELD_FORMAT_BC4 ?
+        bc4_block_size : (size_t)dfield_format_channels(format);
+}
+
+/* the number of rows of data in this level of this dfield (a row of blocks
+ * being one row, for DFIELD_FORMAT_BC4)
+ */
+static int32_t level_rows(const struct dfield * dfield, int32_t level)
+{
+    int32_t height = dfield_level_width(dfield->height, level);
+    return dfield->format == DFIELD_FORMAT_BC4 ?
+        (height + bc4_block_width - 1) / bc4_block_width : height;
+}
+
+/* the number of bytes in each row of data in this level of this dfield */
+static size_t level_stride(const struct dfield * dfield, int32_t level)
+{
+    int32_t width = dfield_level_width(dfield->width, level);
+    if (dfield->format == DFIELD_FORMAT_BC4) {
+        width = (width + bc4_block_width - 1) / bc4_block_width;
     }
+    return (size_t)width * unit_size(dfield->format);
+}
 
-    size_t buffer_size = size[0] * size[1];
-    uint8_t * buffer = malloc(buffer_size);
-    if (!buffer) {
-        fclose(dfield_file);
-        return DFIELD_RESULT_ERROR_MEMORY;
+/* the number of bytes of data in this level of this dfield */
+size_t dfield_level_size(const struct dfield * dfield, int32_t level)
+{
+    return (size_t)level_rows(dfield, level) * level_stride(dfield, level);
+}
+
+/* the number of bytes of data in this dfield (all levels) */
+size_t dfield_data_size(const struct dfield * dfield)
+{
+    size_t size = 0;
+    for (int32_t level = 0; level < dfield->levels; level++) {
+        size += dfield_level_size(dfield, level);
     }
-    uint8_t * read_buffer = malloc(buffer_size);
+    return size;
+}
+
+/* decompress size bytes of LZMA (xz) data from the rest of this file into
+ * buffer
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result lzma_decode_file(
+        FILE * file, uint8_t * buffer, size_t size)
+{
+    uint8_t * read_buffer = malloc(lzma_read_buffer_size);
     if (!read_buffer) {
-        fclose(dfield_file);
-        free(buffer);
         return DFIELD_RESULT_ERROR_MEMORY;
     }
     lzma_stream stream = LZMA_STREAM_INIT;
     lzma_ret ret = lzma_stream_decoder(&stream, lzma_memory_usage_limit, 0);
     if (ret != LZMA_OK) {
         free(read_buffer);
-        free(buffer);
-        fclose(dfield_file);
         return DFIELD_RESULT_ERROR_LZMA;
     }
 
     stream.next_in = NULL;
     stream.avail_in = 0;
     stream.next_out = buffer;
-    stream.avail_out = buffer_size;
+    stream.avail_out = size;
     lzma_action action = LZMA_RUN;
 
     for (;;) {
         if (stream.avail_in == 0) {
             stream.next_in = read_buffer;
-            stream.avail_in = fread(read_buffer, 1, buffer_size, dfield_file);
-            if (feof(dfield_file)) {
+            stream.avail_in = fread(
+                    read_buffer, 1, lzma_read_buffer_size, file);
+            if (feof(file)) {
                 action = LZMA_FINISH;
             }
-            if (ferror(dfield_file)) {
+            if (ferror(file)) {
                 lzma_end(&stream);
                 free(read_buffer);
-                free(buffer);
                 return DFIELD_RESULT_ERROR_ERRNO;
             }
         }
@@ -168,263 +364,5007 @@ enum dfield_result dfield_from_file(
             if (ret != LZMA_STREAM_END) {
                 lzma_end(&stream);
                 free(read_buffer);
-                free(buffer);
-                fclose(dfield_file);
                 return DFIELD_RESULT_ERROR_LZMA;
             }
-            size_t total_size = buffer_size - stream.avail_out;
-            if (total_size != (size_t)size[0] * (size_t)size[1]) {
-                lzma_end(&stream);
-                free(read_buffer);
-                free(buffer);
-                fclose(dfield_file);
-                return DFIELD_RESULT_ERROR_BAD_DECOMPRESSED_SIZE;
-            }
             break;
         }
 
         if (ret != LZMA_OK) {
             lzma_end(&stream);
             free(read_buffer);
-            fclose(dfield_file);
-            free(buffer);
-            return DFIELD_RESULT_ERROR_LZMA;
+            return ret == LZMA_STREAM_END ?
+                DFIELD_RESULT_ERROR_BAD_DECOMPRESSED_SIZE :
+                DFIELD_RESULT_ERROR_LZMA;
         }
     }
 
     lzma_end(&stream);
     free(read_buffer);
+    return DFIELD_RESULT_OKAY;
+}
 
-    *dfield_out = (struct dfield) {
-        .width = size[0],
-        .height = size[1],
-        .data = (int8_t *)buffer
-    };
+/* the most bytes lz_encode can turn size bytes into */
+static size_t lz_bound(size_t size)
+{
+    return size + size / 255 + 16;
+}
 
-    return DFIELD_RESULT_OKAY;
+/* read four (possibly unaligned) bytes */
+static inline uint32_t lz_read32(const uint8_t * p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
 }
 
-/* load raw data (of the sort you could pass to dfield_generate) from this file
- * and put it in data
+/* the hash table slot for these four bytes */
+static inline uint32_t lz_hash(uint32_t value)
+{
+    return (value * 2654435761u) >> (32 - lz_hash_bits);
+}
+
+/* write the part of a length that didn't fit in its token: a run of 255s
+ * and then the remainder
+ */
+static uint8_t * lz_put_length(uint8_t * out, size_t length)
+{
+    while (length >= 255) {
+        *out++ = 255;
+        length -= 255;
+    }
+    *out++ = (uint8_t)length;
+    return out;
+}
+
+/* write one sequence: a token, these literals, and then (unless length is
+ * 0, which only the last sequence may use) a match of length bytes starting
+ * offset bytes back
  *
- * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ * the token's high nibble is the number of literals and its low nibble is
+ * the length of the match less lz_min_match, with 15 in either meaning the
+ * rest follows (see lz_put_length)
  */
-enum dfield_result dfield_data_from_file(
-        const char * path,
-        int32_t width,
-        int32_t height,
-        uint8_t ** data_out
-    ) [[gnu::nonnull(1, 4)]]
+static uint8_t * lz_put_sequence(
+        uint8_t * out,
+        const uint8_t * literals,
+        size_t n_literals,
+        size_t offset,
+        size_t length
+    )
 {
-    FILE * raw_file = fopen(path, "rb");
+    uint8_t * token = out++;
+    *token = (uint8_t)((n_literals < 15 ? n_literals : 15) << 4);
+    if (n_literals >= 15) {
+        out = lz_put_length(out, n_literals - 15);
+    }
+    memcpy(out, literals, n_literals);
+    out += n_literals;
 
-    if (!raw_file) {
-        return DFIELD_RESULT_ERROR_ERRNO;
+    if (length == 0) {
+        return out;
     }
 
-    size_t size = (size_t)width * (size_t)height;
+    *out++ = (uint8_t)(offset & 0xff);
+    *out++ = (uint8_t)(offset >> 8);
+    size_t extra = length - lz_min_match;
+    *token |= (uint8_t)(extra < 15 ? extra : 15);
+    if (extra >= 15) {
+        out = lz_put_length(out, extra - 15);
+    }
+    return out;
+}
 
-    uint8_t * data = malloc(size);
-    if (!data) {
-        fclose(raw_file);
+/* compress these size bytes with the lz codec into out (which must hold at
+ * least lz_bound(size) bytes) and put the compressed size in size_out
+ *
+ * this is a greedy LZ77 over a hash table of the last position each four
+ * byte sequence was seen at. the saturated regions of a dfield become long
+ * matches at offset 1, and its ramps matches against the rows above
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result lz_encode(
+        const uint8_t * in,
+        size_t size,
+        uint8_t * out,
+        size_t * size_out
+    )
+{
+    uint32_t * table = calloc((size_t)1 << lz_hash_bits, sizeof(*table));
+    if (!table) {
         return DFIELD_RESULT_ERROR_MEMORY;
     }
 
-    size_t rd = fread(data, 1, size, raw_file);
+    uint8_t * out_start = out;
+    size_t anchor = 0; /* where the literals not yet written start */
+    size_t i = 0;
+    while (i + lz_min_match <= size) {
+        uint32_t value = lz_read32(&in[i]);
+        uint32_t hash = lz_hash(value);
+        size_t candidate = table[hash];
+        table[hash] = (uint32_t)i;
 
-    fclose(raw_file);
+        if (candidate >= i || i - candidate > lz_max_offset ||
+                lz_read32(&in[candidate]) != value) {
+            /* step faster through data that isn't matching */
+            i += 1 + ((i - anchor) >> 6);
+            continue;
+        }
 
-    if (rd != size) {
-        return DFIELD_RESULT_ERROR_READ_SIZE;
+        size_t length = lz_min_match;
+        while (i + length < size && in[candidate + length] == in[i + length]) {
+            length++;
+        }
+        out = lz_put_sequence(
+                out, &in[anchor], i - anchor, i - candidate, length);
+        i += length;
+        anchor = i;
+        if (i >= 2 && i + lz_min_match <= size) {
+            table[lz_hash(lz_read32(&in[i - 2]))] = (uint32_t)(i - 2);
+        }
     }
+    out = lz_put_sequence(out, &in[anchor], size - anchor, 0, 0);
 
-    *data_out = data;
+    free(table);
+    *size_out = (size_t)(out - out_start);
     return DFIELD_RESULT_OKAY;
 }
 
-/* write this dfield to this file
+/* read the rest of a length that didn't fit in its token (see
+ * lz_put_length) and add it to length
  *
- * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ * returns false if the data ends first
  */
-enum dfield_result dfield_to_file(
-        const char * path,
-        const struct dfield * dfield
-    ) [[gnu::nonnull(1, 2)]]
+static inline bool lz_get_length(
+        const uint8_t ** in, const uint8_t * in_end, size_t * length)
 {
-    assert(dfield->width > 0);
-    assert(dfield->height > 0);
-
-    lzma_stream stream = LZMA_STREAM_INIT;
-    lzma_ret ret = lzma_easy_encoder(&stream, lzma_preset, LZMA_CHECK_CRC64);
-    if (ret != LZMA_OK) {
-        lzma_end(&stream);
-        return DFIELD_RESULT_ERROR_LZMA;
+    for (;;) {
+        if (*in == in_end || *length > SIZE_MAX / 2) {
+            return false;
+        }
+        uint8_t byte = *(*in)++;
+        *length += byte;
+        if (byte != 255) {
+            return true;
+        }
     }
+}
 
-    /* open the file */
-    FILE * dfield_file = fopen(path, "wb");
-
-    if (!dfield_file) {
-        lzma_end(&stream);
-        return DFIELD_RESULT_ERROR_ERRNO;
-    }
+/* decompress in_size bytes of lz codec data into out, which must come to
+ * exactly out_size bytes
+ *
+ * returns false if the data is invalid
+ */
+static bool lz_decode(
+        const uint8_t * in,
+        size_t in_size,
+        uint8_t * out,
+        size_t out_size
+    )
+{
+    const uint8_t * in_end = in + in_size;
+    uint8_t * out_start = out;
+    uint8_t * out_end = out + out_size;
 
-    /* write the header */
-    size_t rd = fwrite(magic, 1, sizeof(magic), dfield_file);
-    rd += fwrite(&dfield->width, 1, sizeof(dfield->width), dfield_file);
-    rd += fwrite(&dfield->height, 1, sizeof(dfield->height), dfield_file);
+    for (;;) {
+        if (in == in_end) {
+            return false;
+        }
+        uint8_t token = *in++;
 
-    if (rd != sizeof(magic) + sizeof(dfield->width) + sizeof(dfield->height)) {
-        lzma_end(&stream);
-        fclose(dfield_file);
-        return DFIELD_RESULT_ERROR_WRITE_SIZE;
-    }
+        size_t n_literals = token >> 4;
+        if (n_literals == 15 && !lz_get_length(&in, in_end, &n_literals)) {
+            return false;
+        }
+        if (n_literals > (size_t)(in_end - in) ||
+                n_literals > (size_t)(out_end - out)) {
+            return false;
+        }
+        memcpy(out, in, n_literals);
+        in += n_literals;
+        out += n_literals;
 
-    /* write the compressed data */
-    constexpr size_t buffer_size = 1024 * 1024;
-    uint8_t * buffer = malloc(buffer_size);
-    if (!buffer) {
-        lzma_end(&stream);
-        fclose(dfield_file);
-        return DFIELD_RESULT_ERROR_MEMORY;
-    }
-    stream.avail_in = dfield->width * dfield->height;
-    stream.next_in = (uint8_t *)dfield->data;
-    stream.avail_out = buffer_size;
-    stream.next_out = buffer;
+        /* only the last sequence ends without a match */
+        if (in == in_end) {
+            return out == out_end;
+        }
 
-    lzma_action action = LZMA_RUN;
-    for (;;) {
-        if (stream.avail_in == 0) {
-            action = LZMA_FINISH;
+        if (in_end - in < 2) {
+            return false;
         }
-        ret = lzma_code(&stream, action);
-        if (stream.avail_out == 0 || ret == LZMA_STREAM_END) {
-            rd = fwrite(buffer, 1, buffer_size - stream.avail_out, dfield_file);
-            if (rd != buffer_size - stream.avail_out) {
-                lzma_end(&stream);
-                free(buffer);
-                fclose(dfield_file);
-                return DFIELD_RESULT_ERROR_WRITE_SIZE;
+        size_t offset = (size_t)in[0] | (size_t)in[1] << 8;
+        in += 2;
+        size_t length = token & 15;
+        if (length == 15 && !lz_get_length(&in, in_end, &length)) {
+            return false;
+        }
+        length += lz_min_match;
+        if (offset == 0 || offset > (size_t)(out - out_start) ||
+                length > (size_t)(out_end - out)) {
+            return false;
+        }
+
+        const uint8_t * match = out - offset;
+        if (offset == 1) {
+            memset(out, *match, length);
+        } else if (offset >= length) {
+            memcpy(out, match, length);
+        } else {
+            for (size_t k = 0; k < length; k++) {
+                out[k] = match[k];
             }
-            break;
         }
+        out += length;
     }
-    if (ret != LZMA_STREAM_END) {
-        lzma_end(&stream);
-        free(buffer);
-        fclose(dfield_file);
-        return DFIELD_RESULT_ERROR_LZMA;
+}
+
+/* read the rest of this file into a buffer, putting it in data_out and its
+ * size in size_out
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result read_rest(
+        FILE * file, uint8_t ** data_out, size_t * size_out)
+{
+    long start = ftell(file);
+    if (start < 0 || fseek(file, 0, SEEK_END)) {
+        return DFIELD_RESULT_ERROR_ERRNO;
+    }
+    long end = ftell(file);
+    if (end < 0 || fseek(file, start, SEEK_SET)) {
+        return DFIELD_RESULT_ERROR_ERRNO;
     }
 
-    lzma_end(&stream);
-    free(buffer);
-    fclose(dfield_file);
+    size_t size = (size_t)(end - start);
+    uint8_t * data = malloc(size ? size : 1);
+    if (!data) {
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+    if (fread(data, 1, size, file) != size) {
+        free(data);
+        return DFIELD_RESULT_ERROR_READ_SIZE;
+    }
 
+    *data_out = data;
+    *size_out = size;
     return DFIELD_RESULT_OKAY;
 }
 
-/* using this data (which should be boolean-like black and white data, with
- * 0 treated as black and all other values treated as white) generate a
- * distance field of this size with this spread value and put it in dfield_out
+/* decompress size bytes of lz codec data from the rest of this file into
+ * buffer
  *
  * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
  */
-[[nodiscard]] enum dfield_result dfield_generate(
-        uint8_t * data,
-        int32_t input_width,
-        int32_t input_height,
-        int32_t output_width,
-        int32_t output_height,
-        int32_t spread,
-        struct dfield * dfield_out
-    ) [[gnu::nonnull(1)]]
+static enum dfield_result lz_decode_file(
+        FILE * file, uint8_t * buffer, size_t size)
 {
-    if (input_width <= 0 || input_height <= 0) {
-        return DFIELD_RESULT_ERROR_BAD_INPUT_SIZE;
+    uint8_t * compressed;
+    size_t compressed_size;
+    enum dfield_result result =
+        read_rest(file, &compressed, &compressed_size);
+    if (result) {
+        return result;
     }
-    if (output_width <= 0 || output_height <= 0) {
-        return DFIELD_RESULT_ERROR_BAD_OUTPUT_SIZE;
+
+    bool ok = lz_decode(compressed, compressed_size, buffer, size);
+    free(compressed);
+    return ok ? DFIELD_RESULT_OKAY : DFIELD_RESULT_ERROR_BAD_COMPRESSED_DATA;
+}
+
+/* clamp this prediction to the range of a texel */
+static inline int32_t clamp_prediction(int32_t prediction)
+{
+    return prediction < INT8_MIN ? INT8_MIN :
+           prediction > INT8_MAX ? INT8_MAX : prediction;
+}
+
+/* the median prediction of a texel from its neighbors: the median of the
+ * gradient prediction (left + up - up-left) and the linear extrapolations
+ * along its row (2 * left - left-left) and its column (2 * up - up-up)
+ *
+ * all three are exact along a linear ramp, but they go wrong in different
+ * places (where ramps are rounded to whole texels, meet each other, or are
+ * clamped at the spread), so the median of them misses less often than any
+ * one of them does
+ */
+static inline int32_t median_predict(
+        int32_t left,
+        int32_t left_left,
+        int32_t up,
+        int32_t up_up,
+        int32_t up_left
+    )
+{
+    int32_t gradient = clamp_prediction(left + up - up_left),
+            row = clamp_prediction(2 * left - left_left),
+            column = clamp_prediction(2 * up - up_up);
+    int32_t low = gradient < row ? gradient : row,
+            high = gradient < row ? row : gradient;
+    return column < low ? low : column > high ? high : column;
+}
+
+/* the median prediction of byte i of this row of texels with this many
+ * channels, given the row above it and the row above that (either of which
+ * is NULL if there is no such row)
+ *
+ * neighbors that would be past the first rows or columns are replaced by the
+ * nearest ones that aren't, so that along the first row and column this is
+ * the extrapolation along it alone, and the first texel is predicted to be 0
+ */
+static inline int32_t median_prediction(
+        const uint8_t * row,
+        const uint8_t * above,
+        const uint8_t * above_above,
+        size_t i,
+        size_t channels
+    )
+{
+    int32_t left = 0,
+            left_left = 0;
+    if (i >= channels) {
+        left = (int8_t)row[i - channels];
+        left_left = i >= 2 * channels ? (int8_t)row[i - 2 * channels] : left;
     }
-    /* 2 * spread * spread must fit in an int32_t
-     *
-     * (it shouldn't ever be close)
-     */
-    if (spread < 0 || spread > 32768) {
-        return DFIELD_RESULT_ERROR_BAD_SPREAD;
+    if (!above) {
+        return clamp_prediction(2 * left - left_left);
     }
-    
-    int8_t * field = malloc(output_width * output_height);
-    if (!field) {
-        return DFIELD_RESULT_ERROR_MEMORY;
+
+    int32_t up = (int8_t)above[i],
+            up_up = above_above ? (int8_t)above_above[i] : up;
+    if (i < channels) {
+        return clamp_prediction(2 * up - up_up);
     }
+    return median_predict(
+            left, left_left, up, up_up, (int8_t)above[i - channels]);
+}
 
-    double y_scale = (double)input_height / output_height;
-    double x_scale = (double)input_width / output_width;
+/* replace each texel of these rows (of stride bytes, of texels with this
+ * many channels) with its difference from its median prediction, putting the
+ * result in out
+ */
+static void median_filter_rows(
+        const uint8_t * in,
+        uint8_t * out,
+        int32_t rows,
+        size_t stride,
+        size_t channels
+    )
+{
+    #pragma omp parallel for schedule(static) if (rows > 64)
+    for (int32_t y = 0; y < rows; y++) {
+        const uint8_t * row = &in[(size_t)y * stride];
+        const uint8_t * above = y > 0 ? row - stride : NULL;
+        const uint8_t * above_above = y > 1 ? row - 2 * stride : NULL;
+        uint8_t * row_out = &out[(size_t)y * stride];
+        for (size_t i = 0; i < stride; i++) {
+            row_out[i] = (uint8_t)(row[i] - median_prediction(
+                        row, above, above_above, i, channels));
+        }
+    }
+}
+
+/* undo median_filter_rows, in place
+ *
+ * each texel depends on the ones before it, so this runs in order
+ */
+static void median_unfilter_rows(
+        uint8_t * data,
+        int32_t rows,
+        size_t stride,
+        size_t channels
+    )
+{
+    for (int32_t y = 0; y < rows; y++) {
+        uint8_t * row = &data[(size_t)y * stride];
+        const uint8_t * above = y > 0 ? row - stride : NULL;
+        const uint8_t * above_above = y > 1 ? row - 2 * stride : NULL;
+        size_t first = above ? 2 * channels : stride;
+        for (size_t i = 0; i < first && i < stride; i++) {
+            row[i] = (uint8_t)(row[i] + median_prediction(
+                        row, above, above_above, i, channels));
+        }
+
+        /* the same as median_prediction, but a channel at a time with the
+         * two texels to the left kept in registers, since that is what each
+         * texel waits on
+         */
+        for (size_t c = 0; c < channels && first < stride; c++) {
+            int32_t left_left = (int8_t)row[c],
+                    left = (int8_t)row[c + channels];
+            for (size_t i = c + first; i < stride; i += channels) {
+                int32_t up = (int8_t)above[i],
+                        up_up = above_above ? (int8_t)above_above[i] : up;
+                int32_t value = (int8_t)(uint8_t)(row[i] + median_predict(
+                        left,
+                        left_left,
+                        up,
+                        up_up,
+                        (int8_t)above[i - channels]
+                    ));
+                row[i] = (uint8_t)value;
+                left_left = left;
+                left = value;
+            }
+        }
+    }
+}
+
+/* apply median_filter_rows to each level of this dfield, putting the result
+ * in out
+ */
+static void median_filter(const struct dfield * dfield, uint8_t * out)
+{
+    size_t offset = 0;
+    for (int32_t level = 0; level < dfield->levels; level++) {
+        median_filter_rows(
+                (const uint8_t *)&dfield->data[offset],
+                &out[offset],
+                level_rows(dfield, level),
+                level_stride(dfield, level),
+                unit_size(dfield->format)
+            );
+        offset += dfield_level_size(dfield, level);
+    }
+}
+
+/* undo median_filter, in place, on this data laid out as in dfield */
+static void median_unfilter(const struct dfield * dfield, uint8_t * data)
+{
+    size_t offset = 0;
+    for (int32_t level = 0; level < dfield->levels; level++) {
+        median_unfilter_rows(
+                &data[offset],
+                level_rows(dfield, level),
+                level_stride(dfield, level),
+                unit_size(dfield->format)
+            );
+        offset += dfield_level_size(dfield, level);
+    }
+}
+
+/* a band of rows of one level of a dfield, which is filtered and compressed
+ * on its own
+ */
+struct band {
+    size_t offset; /* where the band starts in the dfield's data */
+    int32_t rows;
+    size_t stride; /* the size of each row in bytes */
+};
+
+/* the size of this band in bytes */
+static inline size_t band_size(const struct band * band)
+{
+    return (size_t)band->rows * band->stride;
+}
+
+/* split each level of this dfield into bands of band_rows rows (of blocks,
+ * for DFIELD_FORMAT_BC4; the last of each level may have fewer), putting them in bands_out and how many there
+ * are in n_bands_out
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result make_bands(
+        const struct dfield * dfield,
+        int32_t band_rows,
+        size_t * n_bands_out,
+        struct band ** bands_out
+    )
+{
+    size_t n_bands = 0;
+    for (int32_t level = 0; level < dfield->levels; level++) {
+        int32_t height = level_rows(dfield, level);
+        n_bands += (size_t)((height - 1) / band_rows + 1);
+    }
+
+    struct band * bands = malloc(sizeof(*bands) * n_bands);
+    if (!bands) {
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+    size_t i = 0;
+    size_t offset = 0;
+    for (int32_t level = 0; level < dfield->levels; level++) {
+        int32_t height = level_rows(dfield, level);
+        size_t stride = level_stride(dfield, level);
+        for (int32_t y = 0; y < height; y += band_rows) {
+            bands[i] = (struct band) {
+                .offset = offset + (size_t)y * stride,
+                .rows = height - y < band_rows ? height - y : band_rows,
+                .stride = stride
+            };
+            i++;
+        }
+        offset += dfield_level_size(dfield, level);
+    }
+
+    *n_bands_out = n_bands;
+    *bands_out = bands;
+    return DFIELD_RESULT_OKAY;
+}
+
+/* decompress this band of in_size bytes of data compressed with this codec
+ * into out, which must come to exactly size bytes
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result decode_band(
+        enum dfield_codec codec,
+        const uint8_t * in,
+        size_t in_size,
+        uint8_t * out,
+        size_t size
+    )
+{
+    if (codec == DFIELD_CODEC_LZ) {
+        return lz_decode(in, in_size, out, size) ?
+            DFIELD_RESULT_OKAY : DFIELD_RESULT_ERROR_BAD_COMPRESSED_DATA;
+    }
+
+    uint64_t memory_limit = lzma_memory_usage_limit;
+    size_t in_position = 0,
+           out_position = 0;
+    lzma_ret ret = lzma_stream_buffer_decode(
+            &memory_limit,
+            0,
+            NULL,
+            in,
+            &in_position,
+            in_size,
+            out,
+            &out_position,
+            size
+        );
+    if (ret != LZMA_OK) {
+        return DFIELD_RESULT_ERROR_LZMA;
+    }
+    if (in_position != in_size || out_position != size) {
+        return DFIELD_RESULT_ERROR_BAD_DECOMPRESSED_SIZE;
+    }
+    return DFIELD_RESULT_OKAY;
+}
+
+/* read the band table and bands (see make_bands) of a dfield written with
+ * this codec, filter, and number of rows per band from the rest of this file,
+ * decoding them in parallel into dfield's data
+ *
+ * the band table is the compressed size of each band as a uint64_t, and is
+ * followed by the bands in order
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result decode_bands_file(
+        FILE * file,
+        const struct dfield * dfield,
+        enum dfield_codec codec,
+        enum dfield_filter filter,
+        int32_t band_rows
+    )
+{
+    size_t n_bands;
+    struct band * bands;
+    enum dfield_result result =
+        make_bands(dfield, band_rows, &n_bands, &bands);
+    if (result) {
+        return result;
+    }
+
+    /* the table, turned into where each band starts */
+    uint64_t * starts = malloc(sizeof(*starts) * (n_bands + 1));
+    if (!starts) {
+        free(bands);
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+    if (fread(starts + 1, sizeof(*starts), n_bands, file) != n_bands) {
+        free(starts);
+        free(bands);
+        return DFIELD_RESULT_ERROR_READ_SIZE;
+    }
+
+    uint8_t * compressed;
+    size_t compressed_size;
+    result = read_rest(file, &compressed, &compressed_size);
+    if (result) {
+        free(starts);
+        free(bands);
+        return result;
+    }
+
+    starts[0] = 0;
+    for (size_t i = 0; i < n_bands; i++) {
+        if (starts[i + 1] > compressed_size - starts[i]) {
+            free(compressed);
+            free(starts);
+            free(bands);
+            return DFIELD_RESULT_ERROR_BAD_COMPRESSED_DATA;
+        }
+        starts[i + 1] += starts[i];
+    }
+    if (starts[n_bands] != compressed_size) {
+        free(compressed);
+        free(starts);
+        free(bands);
+        return DFIELD_RESULT_ERROR_BAD_COMPRESSED_DATA;
+    }
+
+    size_t channels = unit_size(dfield->format);
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < n_bands; i++) {
+        uint8_t * out = (uint8_t *)&dfield->data[bands[i].offset];
+        enum dfield_result band_result = decode_band(
+                codec,
+                &compressed[starts[i]],
+                (size_t)(starts[i + 1] - starts[i]),
+                out,
+                band_size(&bands[i])
+            );
+        if (band_result) {
+            #pragma omp critical
+            result = band_result;
+        } else if (filter == DFIELD_FILTER_MEDIAN) {
+            median_unfilter_rows(
+                    out, bands[i].rows, bands[i].stride, channels);
+        }
+    }
+
+    free(compressed);
+    free(starts);
+    free(bands);
+    return result;
+}
+
+/* what the header of a dfield file says about its dfield and how its data is
+ * stored
+ */
+struct file_header {
+    struct dfield dfield; /* everything but data */
+    enum dfield_codec codec;
+    enum dfield_filter filter;
+    int32_t band_rows;
+};
+
+/* read the header of this dfield file into header_out, leaving the file at
+ * the start of the data
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result read_header(
+        FILE * file, struct file_header * header_out)
+{
+    static_assert(sizeof(magic) == sizeof(magic_extended));
+    char magic_in[sizeof(magic)];
+    size_t rd = fread(magic_in, 1, sizeof(magic), file);
+    if (rd != sizeof(magic)) {
+        return DFIELD_RESULT_ERROR_READ_SIZE;
+    }
+
+    bool extended;
+    if (!memcmp(magic_in, magic, sizeof(magic))) {
+        extended = false;
+    } else if (!memcmp(magic_in, magic_extended, sizeof(magic_extended))) {
+        extended = true;
+    } else {
+        return DFIELD_RESULT_ERROR_MAGIC;
+    }
+
+    uint8_t version = 0;
+    if (extended) {
+        rd = fread(&version, 1, sizeof(version), file);
+        if (rd != sizeof(version)) {
+            return DFIELD_RESULT_ERROR_READ_SIZE;
+        }
+        if (version < 1 || version > extended_version) {
+            return DFIELD_RESULT_ERROR_VERSION;
+        }
+    }
+
+    int32_t size[2];
+    rd = fread(size, 1, sizeof(size), file);
+
+    if (rd != sizeof(size)) {
+        return DFIELD_RESULT_ERROR_READ_SIZE;
+    }
+
+    if (size[0] <= 0 || size[1] <= 0) {
+        return DFIELD_RESULT_ERROR_BAD_SIZE;
+    }
+
+    int32_t levels = 1;
+    if (extended) {
+        rd = fread(&levels, 1, sizeof(levels), file);
+        if (rd != sizeof(levels)) {
+            return DFIELD_RESULT_ERROR_READ_SIZE;
+        }
+        if (levels <= 0 || levels > max_levels(size[0], size[1])) {
+            return DFIELD_RESULT_ERROR_BAD_LEVELS;
+        }
+    }
+
+    enum dfield_format format = DFIELD_FORMAT_SDF;
+    if (version >= 2) {
+        uint8_t format_in;
+        rd = fread(&format_in, 1, sizeof(format_in), file);
+        if (rd != sizeof(format_in)) {
+            return DFIELD_RESULT_ERROR_READ_SIZE;
+        }
+        if (format_in != DFIELD_FORMAT_SDF &&
+                format_in != DFIELD_FORMAT_MSDF &&
+                format_in != DFIELD_FORMAT_BC4) {
+            return DFIELD_RESULT_ERROR_BAD_FORMAT;
+        }
+        format = (enum dfield_format)format_in;
+    }
+
+    enum dfield_codec codec = DFIELD_CODEC_LZMA;
+    if (version >= 3) {
+        uint8_t codec_in;
+        rd = fread(&codec_in, 1, sizeof(codec_in), file);
+        if (rd != sizeof(codec_in)) {
+            return DFIELD_RESULT_ERROR_READ_SIZE;
+        }
+        if (codec_in != DFIELD_CODEC_LZMA && codec_in != DFIELD_CODEC_LZ) {
+            return DFIELD_RESULT_ERROR_BAD_CODEC;
+        }
+        codec = (enum dfield_codec)codec_in;
+    }
+
+    enum dfield_filter filter = DFIELD_FILTER_NONE;
+    if (version >= 4) {
+        uint8_t filter_in;
+        rd = fread(&filter_in, 1, sizeof(filter_in), file);
+        if (rd != sizeof(filter_in)) {
+            return DFIELD_RESULT_ERROR_READ_SIZE;
+        }
+        if (filter_in != DFIELD_FILTER_NONE &&
+                filter_in != DFIELD_FILTER_MEDIAN) {
+            return DFIELD_RESULT_ERROR_BAD_FILTER;
+        }
+        filter = (enum dfield_filter)filter_in;
+    }
+
+    int32_t band_rows = 0;
+    if (version >= 5) {
+        rd = fread(&band_rows, 1, sizeof(band_rows), file);
+        if (rd != sizeof(band_rows)) {
+            return DFIELD_RESULT_ERROR_READ_SIZE;
+        }
+        if (band_rows < 0) {
+            return DFIELD_RESULT_ERROR_BAD_BAND_ROWS;
+        }
+    }
+
+    *header_out = (struct file_header) {
+        .dfield = {
+            .width = size[0],
+            .height = size[1],
+            .levels = levels,
+            .format = format
+        },
+        .codec = codec,
+        .filter = filter,
+        .band_rows = band_rows
+    };
+    return DFIELD_RESULT_OKAY;
+}
+
+/* decode the rest of this file, whose header read_header put in header, into
+ * buffer (which holds dfield_data_size(&header->dfield) bytes)
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result decode_file(
+        FILE * file, const struct file_header * header, uint8_t * buffer)
+{
+    struct dfield dfield = header->dfield;
+    size_t buffer_size = dfield_data_size(&dfield);
+
+    if (header->band_rows > 0) {
+        dfield.data = (int8_t *)buffer;
+        return decode_bands_file(
+                file, &dfield, header->codec, header->filter,
+                header->band_rows);
+    }
+
+    enum dfield_result result;
+    if (header->codec == DFIELD_CODEC_LZ) {
+        result = lz_decode_file(file, buffer, buffer_size);
+    } else {
+        result = lzma_decode_file(file, buffer, buffer_size);
+    }
+
+    if (!result && header->filter == DFIELD_FILTER_MEDIAN) {
+        median_unfilter(&dfield, buffer);
+    }
+    return result;
+}
+
+/* load a dfield from this file and put it in dfield_out
+ *
+ * returns 0 on success, non-zero on error
+ */
+enum dfield_result dfield_from_file(
+        const char * path, struct dfield * dfield_out) [[gnu::nonnull(1, 2)]]
+{
+    FILE * dfield_file = fopen(path, "rb");
+
+    if (!dfield_file) {
+        return DFIELD_RESULT_ERROR_ERRNO;
+    }
+
+    struct file_header header;
+    enum dfield_result result = read_header(dfield_file, &header);
+    if (result) {
+        fclose(dfield_file);
+        return result;
+    }
+
+    uint8_t * buffer = malloc(dfield_data_size(&header.dfield));
+    if (!buffer) {
+        fclose(dfield_file);
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+    result = decode_file(dfield_file, &header, buffer);
+    fclose(dfield_file);
+
+    if (result) {
+        free(buffer);
+        return result;
+    }
+
+    *dfield_out = header.dfield;
+    dfield_out->data = (int8_t *)buffer;
+    return DFIELD_RESULT_OKAY;
+}
+
+/* read only the header of this dfield file and put what it says in
+ * dfield_out, with data set to NULL
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result dfield_header_from_file(
+        const char * path, struct dfield * dfield_out) [[gnu::nonnull(1, 2)]]
+{
+    FILE * dfield_file = fopen(path, "rb");
+
+    if (!dfield_file) {
+        return DFIELD_RESULT_ERROR_ERRNO;
+    }
+
+    struct file_header header;
+    enum dfield_result result = read_header(dfield_file, &header);
+    fclose(dfield_file);
+
+    if (result) {
+        return result;
+    }
+
+    *dfield_out = header.dfield;
+    return DFIELD_RESULT_OKAY;
+}
+
+/* like dfield_from_file, but decode the data into destination (which holds
+ * destination_size bytes) instead of a new buffer
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result dfield_from_file_into(
+        const char * path,
+        void * destination,
+        size_t destination_size,
+        struct dfield * dfield_out
+    ) [[gnu::nonnull(1, 2, 4)]]
+{
+    FILE * dfield_file = fopen(path, "rb");
+
+    if (!dfield_file) {
+        return DFIELD_RESULT_ERROR_ERRNO;
+    }
+
+    struct file_header header;
+    enum dfield_result result = read_header(dfield_file, &header);
+    if (result) {
+        fclose(dfield_file);
+        return result;
+    }
+
+    if (dfield_data_size(&header.dfield) > destination_size) {
+        fclose(dfield_file);
+        return DFIELD_RESULT_ERROR_DESTINATION_SIZE;
+    }
+
+    result = decode_file(dfield_file, &header, destination);
+    fclose(dfield_file);
+
+    if (result) {
+        return result;
+    }
+
+    *dfield_out = header.dfield;
+    dfield_out->data = destination;
+    return DFIELD_RESULT_OKAY;
+}
+
+/* load raw data (of the sort you could pass to dfield_generate) from this file
+ * and put it in data
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result dfield_data_from_file(
+        const char * path,
+        int32_t width,
+        int32_t height,
+        uint8_t ** data_out
+    ) [[gnu::nonnull(1, 4)]]
+{
+    FILE * raw_file = fopen(path, "rb");
+
+    if (!raw_file) {
+        return DFIELD_RESULT_ERROR_ERRNO;
+    }
+
+    size_t size = (size_t)width * (size_t)height;
+
+    uint8_t * data = malloc(size);
+    if (!data) {
+        fclose(raw_file);
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+    size_t rd = fread(data, 1, size, raw_file);
+
+    fclose(raw_file);
+
+    if (rd != size) {
+        free(data);
+        return DFIELD_RESULT_ERROR_READ_SIZE;
+    }
+
+    *data_out = data;
+    return DFIELD_RESULT_OKAY;
+}
+
+/* a source of input rows */
+struct dfield_input {
+    int32_t width, height;
+    dfield_read_row_function read_row;
+    dfield_close_function close;
+    void * state;
+};
+
+/* make an input of this size that reads its rows with read_row and is closed
+ * with close (which may be NULL), passing them state, and put it in input_out
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result dfield_input_open(
+        int32_t width,
+        int32_t height,
+        dfield_read_row_function read_row,
+        dfield_close_function close,
+        void * state,
+        struct dfield_input ** input_out
+    ) [[gnu::nonnull(3, 6)]]
+{
+    if (width <= 0 || height <= 0) {
+        return DFIELD_RESULT_ERROR_BAD_INPUT_SIZE;
+    }
+
+    struct dfield_input * input = malloc(sizeof(*input));
+    if (!input) {
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+    *input = (struct dfield_input) {
+        .width = width,
+        .height = height,
+        .read_row = read_row,
+        .close = close,
+        .state = state
+    };
+
+    *input_out = input;
+    return DFIELD_RESULT_OKAY;
+}
+
+/* the state of an input opened by dfield_input_open_raw or
+ * dfield_input_open_pgm
+ */
+struct file_input {
+    FILE * file;
+    int32_t width;
+    int32_t maximum; /* the value that means 255, or 0 for raw data */
+    uint8_t * buffer; /* a row of two-byte values, when maximum > 255 */
+};
+
+/* read the next row of a file_input (see dfield_read_row_function) */
+static enum dfield_result file_input_read_row(void * state, uint8_t * row)
+{
+    struct file_input * input = state;
+
+    if (input->maximum > 255) {
+        size_t rd = fread(input->buffer, 2, input->width, input->file);
+        if (rd != (size_t)input->width) {
+            return DFIELD_RESULT_ERROR_READ_SIZE;
+        }
+        for (int32_t x = 0; x < input->width; x++) {
+            /* big-endian, as the PGM format says */
+            uint32_t value = (uint32_t)input->buffer[2 * x] << 8 |
+                             input->buffer[2 * x + 1];
+            row[x] = (uint8_t)(
+                    value >= (uint32_t)input->maximum ? 255 :
+                    (value * 255 + input->maximum / 2) / input->maximum);
+        }
+        return DFIELD_RESULT_OKAY;
+    }
+
+    size_t rd = fread(row, 1, input->width, input->file);
+    if (rd != (size_t)input->width) {
+        return DFIELD_RESULT_ERROR_READ_SIZE;
+    }
+
+    if (input->maximum > 0 && input->maximum < 255) {
+        for (int32_t x = 0; x < input->width; x++) {
+            row[x] = (uint8_t)(
+                    row[x] >= input->maximum ? 255 :
+                    (row[x] * 255 + input->maximum / 2) / input->maximum);
+        }
+    }
+
+    return DFIELD_RESULT_OKAY;
+}
+
+/* close a file_input (see dfield_close_function) */
+static void file_input_close(void * state)
+{
+    struct file_input * input = state;
+    fclose(input->file);
+    free(input->buffer);
+    free(input);
+}
+
+/* make an input reading the rest of this file (which it takes ownership of,
+ * closing it on error), with values scaled so that maximum is 255 (unless
+ * maximum is 0), and put it in input_out
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result file_input_open(
+        FILE * file,
+        int32_t width,
+        int32_t height,
+        int32_t maximum,
+        struct dfield_input ** input_out
+    )
+{
+    struct file_input * state = malloc(sizeof(*state));
+    if (!state) {
+        fclose(file);
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+    *state = (struct file_input) {
+        .file = file,
+        .width = width,
+        .maximum = maximum
+    };
+
+    if (maximum > 255) {
+        state->buffer = malloc(2 * (size_t)width);
+        if (!state->buffer) {
+            file_input_close(state);
+            return DFIELD_RESULT_ERROR_MEMORY;
+        }
+    }
+
+    enum dfield_result result = dfield_input_open(
+            width,
+            height,
+            file_input_read_row,
+            file_input_close,
+            state,
+            input_out
+        );
+    if (result) {
+        file_input_close(state);
+    }
+    return result;
+}
+
+/* open this file of raw data (of the sort dfield_data_from_file reads) as an
+ * input, putting it in input_out
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result dfield_input_open_raw(
+        const char * path,
+        int32_t width,
+        int32_t height,
+        struct dfield_input ** input_out
+    ) [[gnu::nonnull(1, 4)]]
+{
+    if (width <= 0 || height <= 0) {
+        return DFIELD_RESULT_ERROR_BAD_INPUT_SIZE;
+    }
+
+    FILE * file = fopen(path, "rb");
+    if (!file) {
+        return DFIELD_RESULT_ERROR_ERRNO;
+    }
+
+    return file_input_open(file, width, height, 0, input_out);
+}
+
+/* read a number from the header of a PGM file (skipping whitespace and
+ * comments before it) into number_out, returning false if there isn't one
+ * (or it's too big)
+ */
+static bool pgm_read_number(FILE * file, int32_t * number_out)
+{
+    int c;
+    for (;;) {
+        c = getc(file);
+        if (c == '#') {
+            while (c != '\n' && c != EOF) {
+                c = getc(file);
+            }
+        } else if (c != ' ' && c != '\t' && c != '\n' && c != '\r' &&
+                c != '\v' && c != '\f') {
+            break;
+        }
+    }
+
+    if (c < '0' || c > '9') {
+        return false;
+    }
+
+    int64_t number = 0;
+    while (c >= '0' && c <= '9') {
+        number = number * 10 + (c - '0');
+        if (number > INT32_MAX) {
+            return false;
+        }
+        c = getc(file);
+    }
+
+    /* one whitespace character ends the number (and, after the maximum,
+     * the header)
+     */
+    if (c != ' ' && c != '\t' && c != '\n' && c != '\r' && c != '\v' &&
+            c != '\f') {
+        return false;
+    }
+
+    *number_out = (int32_t)number;
+    return true;
+}
+
+/* open this binary (P5) PGM file as an input, putting it in input_out. the
+ * size of the input is the size of the image, and its values are scaled so
+ * that the image's maximum value is 255
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result dfield_input_open_pgm(
+        const char * path,
+        struct dfield_input ** input_out
+    ) [[gnu::nonnull(1, 2)]]
+{
+    FILE * file = fopen(path, "rb");
+    if (!file) {
+        return DFIELD_RESULT_ERROR_ERRNO;
+    }
+
+    char magic_pgm[2];
+    int32_t width, height, maximum;
+    if (fread(magic_pgm, 1, 2, file) != 2 ||
+            magic_pgm[0] != 'P' || magic_pgm[1] != '5') {
+        fclose(file);
+        return DFIELD_RESULT_ERROR_MAGIC;
+    }
+    if (!pgm_read_number(file, &width) ||
+            !pgm_read_number(file, &height) ||
+            !pgm_read_number(file, &maximum) ||
+            maximum == 0 || maximum > 65535) {
+        fclose(file);
+        return DFIELD_RESULT_ERROR_BAD_IMAGE;
+    }
+    if (width == 0 || height == 0) {
+        fclose(file);
+        return DFIELD_RESULT_ERROR_BAD_INPUT_SIZE;
+    }
+
+    return file_input_open(file, width, height, maximum, input_out);
+}
+
+/* put the size of this input in width_out and height_out */
+void dfield_input_size(
+        const struct dfield_input * input,
+        int32_t * width_out,
+        int32_t * height_out
+    ) [[gnu::nonnull(1, 2, 3)]]
+{
+    *width_out = input->width;
+    *height_out = input->height;
+}
+
+/* read the next row of this input into row (which must hold width bytes)
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result input_read_row(
+        struct dfield_input * input, uint8_t * row)
+{
+    return input->read_row(input->state, row);
+}
+
+/* read all the rows of this input (none of which may have been read yet)
+ * into one buffer of raw data (of the sort you could pass to
+ * dfield_generate) and put it in data_out
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result dfield_input_read_all(
+        struct dfield_input * input,
+        uint8_t ** data_out
+    ) [[gnu::nonnull(1, 2)]]
+{
+    uint8_t * data = malloc((size_t)input->width * input->height);
+    if (!data) {
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+    for (int32_t y = 0; y < input->height; y++) {
+        enum dfield_result result =
+            input_read_row(input, &data[(size_t)y * input->width]);
+        if (result) {
+            free(data);
+            return result;
+        }
+    }
+
+    *data_out = data;
+    return DFIELD_RESULT_OKAY;
+}
+
+/* close this input and free it */
+void dfield_input_close(struct dfield_input * input)
+{
+    if (input->close) {
+        input->close(input->state);
+    }
+    free(input);
+}
+
+/* compress these size bytes with LZMA (xz) and write them to this file,
+ * using the multi-threaded encoder if threads is more than 1
+ *
+ * the output goes through a fixed buffer that is written out whenever it
+ * fills, so memory use doesn't grow with the size of the data
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result lzma_encode_file(
+        FILE * file, const uint8_t * data, size_t size, int32_t threads)
+{
+    lzma_stream stream = LZMA_STREAM_INIT;
+    lzma_ret ret = LZMA_OPTIONS_ERROR;
+    if (threads > 1) {
+        /* each block is compressed by one thread, so split the data evenly
+         * (the default of three times the dictionary size would leave most
+         * dfields in one block)
+         */
+        uint64_t block_size = (size + (uint32_t)threads - 1) /
+                              (uint32_t)threads;
+        if (block_size < lzma_min_block_size) {
+            block_size = lzma_min_block_size;
+        }
+        lzma_mt options = {
+            .threads = (uint32_t)threads,
+            .block_size = block_size,
+            .preset = lzma_preset,
+            .check = LZMA_CHECK_CRC64
+        };
+        ret = lzma_stream_encoder_mt(&stream, &options);
+    }
+    if (ret != LZMA_OK) {
+        /* single-threaded, or liblzma can't (built without threads, or too
+         * many of them)
+         */
+        lzma_end(&stream);
+        stream = (lzma_stream)LZMA_STREAM_INIT;
+        ret = lzma_easy_encoder(&stream, lzma_preset, LZMA_CHECK_CRC64);
+    }
+    if (ret != LZMA_OK) {
+        lzma_end(&stream);
+        return DFIELD_RESULT_ERROR_LZMA;
+    }
+
+    uint8_t * buffer = malloc(lzma_write_buffer_size);
+    if (!buffer) {
+        lzma_end(&stream);
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+    stream.avail_in = size;
+    stream.next_in = data;
+
+    enum dfield_result result = DFIELD_RESULT_OKAY;
+    do {
+        stream.avail_out = lzma_write_buffer_size;
+        stream.next_out = buffer;
+        ret = lzma_code(&stream, LZMA_FINISH);
+        if (ret != LZMA_OK && ret != LZMA_STREAM_END) {
+            result = ret == LZMA_MEM_ERROR ?
+                DFIELD_RESULT_ERROR_MEMORY : DFIELD_RESULT_ERROR_LZMA;
+            break;
+        }
+        size_t n = lzma_write_buffer_size - stream.avail_out;
+        if (fwrite(buffer, 1, n, file) != n) {
+            result = DFIELD_RESULT_ERROR_WRITE_SIZE;
+            break;
+        }
+    } while (ret != LZMA_STREAM_END);
+
+    lzma_end(&stream);
+    free(buffer);
+    return result;
+}
+
+/* compress these size bytes with the lz codec and write them to this file
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result lz_encode_file(
+        FILE * file, const uint8_t * data, size_t size)
+{
+    uint8_t * buffer = malloc(lz_bound(size));
+    if (!buffer) {
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+    size_t compressed_size;
+    enum dfield_result result =
+        lz_encode(data, size, buffer, &compressed_size);
+    if (!result &&
+            fwrite(buffer, 1, compressed_size, file) != compressed_size) {
+        result = DFIELD_RESULT_ERROR_WRITE_SIZE;
+    }
+
+    free(buffer);
+    return result;
+}
+
+/* filter (if the encoding says to) and compress this band of this dfield the
+ * way the encoding says, putting the compressed data (which should be freed)
+ * in data_out and its size in size_out
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result encode_band(
+        const struct dfield * dfield,
+        const struct band * band,
+        const struct dfield_encoding * encoding,
+        uint8_t ** data_out,
+        size_t * size_out
+    )
+{
+    size_t size = band_size(band);
+    const uint8_t * data = (const uint8_t *)&dfield->data[band->offset];
+    uint8_t * filtered = NULL;
+    if (encoding->filter == DFIELD_FILTER_MEDIAN) {
+        filtered = malloc(size);
+        if (!filtered) {
+            return DFIELD_RESULT_ERROR_MEMORY;
+        }
+        median_filter_rows(
+                data,
+                filtered,
+                band->rows,
+                band->stride,
+                unit_size(dfield->format)
+            );
+        data = filtered;
+    }
+
+    size_t bound = encoding->codec == DFIELD_CODEC_LZ ?
+        lz_bound(size) : lzma_stream_buffer_bound(size);
+    uint8_t * out = malloc(bound);
+    if (!out) {
+        free(filtered);
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+    enum dfield_result result = DFIELD_RESULT_OKAY;
+    size_t out_size = 0;
+    if (encoding->codec == DFIELD_CODEC_LZ) {
+        result = lz_encode(data, size, out, &out_size);
+    } else {
+        /* the preset's dictionary is far bigger than a band, and the decoder
+         * would allocate all of it for each one
+         */
+        lzma_options_lzma options;
+        lzma_lzma_preset(&options, lzma_preset);
+        if (options.dict_size > size) {
+            options.dict_size =
+                size > LZMA_DICT_SIZE_MIN ? (uint32_t)size : LZMA_DICT_SIZE_MIN;
+        }
+        lzma_filter filters[] = {
+            { .id = LZMA_FILTER_LZMA2, .options = &options },
+            { .id = LZMA_VLI_UNKNOWN }
+        };
+        if (lzma_stream_buffer_encode(
+                    filters,
+                    LZMA_CHECK_CRC64,
+                    NULL,
+                    data,
+                    size,
+                    out,
+                    &out_size,
+                    bound
+                ) != LZMA_OK) {
+            result = DFIELD_RESULT_ERROR_LZMA;
+        }
+    }
+    free(filtered);
+
+    if (result) {
+        free(out);
+        return result;
+    }
+
+    *data_out = out;
+    *size_out = out_size;
+    return DFIELD_RESULT_OKAY;
+}
+
+/* split this dfield into bands of encoding->band_rows rows (see make_bands),
+ * encode them in parallel, and write the band table and then the bands to
+ * this file (see decode_bands_file)
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result encode_bands_file(
+        FILE * file,
+        const struct dfield * dfield,
+        const struct dfield_encoding * encoding
+    )
+{
+    size_t n_bands;
+    struct band * bands;
+    enum dfield_result result =
+        make_bands(dfield, encoding->band_rows, &n_bands, &bands);
+    if (result) {
+        return result;
+    }
+
+    uint8_t ** compressed = calloc(n_bands, sizeof(*compressed));
+    uint64_t * sizes = malloc(sizeof(*sizes) * n_bands);
+    if (!compressed || !sizes) {
+        free(compressed);
+        free(sizes);
+        free(bands);
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < n_bands; i++) {
+        size_t size;
+        enum dfield_result band_result = encode_band(
+                dfield, &bands[i], encoding, &compressed[i], &size);
+        if (band_result) {
+            #pragma omp critical
+            result = band_result;
+        } else {
+            sizes[i] = size;
+        }
+    }
+
+    if (!result &&
+            fwrite(sizes, sizeof(*sizes), n_bands, file) != n_bands) {
+        result = DFIELD_RESULT_ERROR_WRITE_SIZE;
+    }
+    for (size_t i = 0; !result && i < n_bands; i++) {
+        if (fwrite(compressed[i], 1, sizes[i], file) != sizes[i]) {
+            result = DFIELD_RESULT_ERROR_WRITE_SIZE;
+        }
+    }
+
+    for (size_t i = 0; i < n_bands; i++) {
+        free(compressed[i]);
+    }
+    free(compressed);
+    free(sizes);
+    free(bands);
+    return result;
+}
+
+/* write this dfield to this file, compressed with DFIELD_CODEC_LZMA
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result dfield_to_file(
+        const char * path,
+        const struct dfield * dfield
+    ) [[gnu::nonnull(1, 2)]]
+{
+    return dfield_to_file_encoded(
+            path, dfield, &(struct dfield_encoding) { });
+}
+
+/* like dfield_to_file, but writing the dfield the way this encoding says
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result dfield_to_file_encoded(
+        const char * path,
+        const struct dfield * dfield,
+        const struct dfield_encoding * encoding
+    ) [[gnu::nonnull(1, 2, 3)]]
+{
+    assert(dfield->width > 0);
+    assert(dfield->height > 0);
+    assert(dfield->levels > 0);
+
+    if (encoding->codec != DFIELD_CODEC_LZMA &&
+            encoding->codec != DFIELD_CODEC_LZ) {
+        return DFIELD_RESULT_ERROR_BAD_CODEC;
+    }
+    if (encoding->filter != DFIELD_FILTER_NONE &&
+            encoding->filter != DFIELD_FILTER_MEDIAN) {
+        return DFIELD_RESULT_ERROR_BAD_FILTER;
+    }
+    if (encoding->band_rows < 0) {
+        return DFIELD_RESULT_ERROR_BAD_BAND_ROWS;
+    }
+
+    /* filter a copy of the data, if we're filtering it all at once (bands
+     * are filtered on their own)
+     */
+    size_t data_size = dfield_data_size(dfield);
+    const uint8_t * data = (const uint8_t *)dfield->data;
+    uint8_t * filtered = NULL;
+    if (encoding->filter == DFIELD_FILTER_MEDIAN &&
+            encoding->band_rows == 0) {
+        filtered = malloc(data_size);
+        if (!filtered) {
+            return DFIELD_RESULT_ERROR_MEMORY;
+        }
+        median_filter(dfield, filtered);
+        data = filtered;
+    }
+
+    /* open the file */
+    FILE * dfield_file = fopen(path, "wb");
+
+    if (!dfield_file) {
+        free(filtered);
+        return DFIELD_RESULT_ERROR_ERRNO;
+    }
+
+    /* write the header (the extended one only if we need it) */
+    bool extended =
+        dfield->levels > 1 || dfield->format != DFIELD_FORMAT_SDF ||
+        encoding->codec != DFIELD_CODEC_LZMA ||
+        encoding->filter != DFIELD_FILTER_NONE ||
+        encoding->band_rows != 0;
+    size_t header_size;
+    size_t rd;
+    if (extended) {
+        rd = fwrite(magic_extended, 1, sizeof(magic_extended), dfield_file);
+        rd += fwrite(&extended_version, 1, sizeof(extended_version), dfield_file);
+        header_size = sizeof(magic_extended) + sizeof(extended_version);
+    } else {
+        rd = fwrite(magic, 1, sizeof(magic), dfield_file);
+        header_size = sizeof(magic);
+    }
+    rd += fwrite(&dfield->width, 1, sizeof(dfield->width), dfield_file);
+    rd += fwrite(&dfield->height, 1, sizeof(dfield->height), dfield_file);
+    header_size += sizeof(dfield->width) + sizeof(dfield->height);
+    if (extended) {
+        uint8_t format = (uint8_t)dfield->format;
+        uint8_t codec = (uint8_t)encoding->codec;
+        uint8_t filter = (uint8_t)encoding->filter;
+        rd += fwrite(&dfield->levels, 1, sizeof(dfield->levels), dfield_file);
+        rd += fwrite(&format, 1, sizeof(format), dfield_file);
+        rd += fwrite(&codec, 1, sizeof(codec), dfield_file);
+        rd += fwrite(&filter, 1, sizeof(filter), dfield_file);
+        rd += fwrite(
+                &encoding->band_rows,
+                1,
+                sizeof(encoding->band_rows),
+                dfield_file
+            );
+        header_size += sizeof(dfield->levels) + sizeof(format) +
+                       sizeof(codec) + sizeof(filter) +
+                       sizeof(encoding->band_rows);
+    }
+
+    if (rd != header_size) {
+        free(filtered);
+        fclose(dfield_file);
+        return DFIELD_RESULT_ERROR_WRITE_SIZE;
+    }
+
+    /* write the compressed data */
+    enum dfield_result result;
+    if (encoding->band_rows > 0) {
+        result = encode_bands_file(dfield_file, dfield, encoding);
+    } else if (encoding->codec == DFIELD_CODEC_LZ) {
+        result = lz_encode_file(dfield_file, data, data_size);
+    } else {
+        result = lzma_encode_file(
+                dfield_file, data, data_size, encoding->threads);
+    }
+    free(filtered);
+
+    if (fclose(dfield_file) && !result) {
+        result = DFIELD_RESULT_ERROR_ERRNO;
+    }
+
+    return result;
+}
+
+/* turn the squared distance from a texel to the nearest texel of the other
+ * state into a field value
+ */
+static int8_t quantize(int32_t minimum, bool state, int32_t spread)
+{
+    double minimum_g = sqrt(minimum);
+
+    if (state) {
+        minimum_g = -minimum_g;
+    }
+
+    minimum_g = minimum_g / spread / M_SQRT2 * 128;
+
+    int32_t result = (int32_t)lrint(minimum_g);
+    if (result > 127) {
+        result = 127;
+    }
+    if (result < -127) {
+        result = -127;
+    }
+
+    return (int8_t)result;
+}
+
+/* turn a signed distance to an edge (in input texels, negative on the on
+ * side) into a field value
+ *
+ * DFIELD_ALGORITHM_BRUTE_FORCE measures between texel centers, which is half
+ * a texel more than the distance to the edge between them, so we add that to
+ * match it
+ */
+static int8_t quantize_edge_distance(double distance, int32_t spread)
+{
+    distance += distance < 0.0 ? -0.5 : 0.5;
+    int32_t result = (int32_t)lrint(distance / spread / M_SQRT2 * 128);
+    if (result > 127) {
+        result = 127;
+    }
+    if (result < -127) {
+        result = -127;
+    }
+    return (int8_t)result;
+}
+
+/* the input coordinate that output coordinate x samples, where scale is the
+ * ratio of input size to output size
+ *
+ * this is clamped to the input because rounding can otherwise land one past
+ * the last texel when the output is larger than the input
+ */
+static inline int32_t input_coordinate(int32_t x, double scale, int32_t size)
+{
+    int32_t x_in = (int32_t)lrint(x * scale);
+    return x_in < size ? x_in : size - 1;
+}
+
+/* the DFIELD_ALGORITHM_BRUTE_FORCE implementation of dfield_generate, for
+ * one output
+ */
+static void generate_brute_force(
+        const uint8_t * data,
+        int32_t input_width,
+        int32_t input_height,
+        int32_t output_width,
+        int32_t output_height,
+        int32_t spread,
+        int8_t * field
+    )
+{
+    double y_scale = (double)input_height / output_height;
+    double x_scale = (double)input_width / output_width;
+
+    #pragma omp parallel for
+    for (int32_t y = 0; y < output_height; y++) {
+        for (int32_t x = 0; x < output_width; x++) {
+            int32_t x_in = input_coordinate(x, x_scale, input_width);
+            int32_t y_in = input_coordinate(y, y_scale, input_height);
+            bool state = data[y_in * input_width + x_in] != 0;
+
+            int32_t minimum = INT32_MAX;
+            for (int32_t i = -spread; i <= spread; i++) {
+                int32_t y_in2 = y_in + i;
+                if (y_in2 < 0) {
+                    continue;
+                }
+                if (y_in2 >= input_height) {
+                    break;
+                }
+                for (int32_t j = -spread; j <= spread; j++) {
+                    int32_t x_in2 = x_in + j;
+                    if (x_in2 < 0) {
+                        continue;
+                    }
+                    if (x_in2 >= input_width) {
+                        break;
+                    }
+                    bool state2 = data[y_in2 * input_width + x_in2] != 0;
+                    if (state2 != state) {
+                        int32_t dsq = i * i + j * j;
+                        if (dsq < minimum) {
+                            minimum = dsq;
+                        }
+                    }
+                }
+            }
+
+            field[y * output_width + x] = quantize(minimum, state, spread);
+        }
+    }
+}
+
+/* a boolean image packed 64 texels to a word, with texel x of a row in bit
+ * x % 64 of word x / 64
+ *
+ * we keep one plane of the texels that are on and one of the texels that are
+ * off so that either state can be searched for directly. bits past the end of
+ * a row are clear in both
+ *
+ * a bitplane may hold only a window of the image's rows: row 0 of the planes
+ * is row first_row of the image, and height is always that of the whole image
+ */
+struct bitplane {
+    int32_t width, height;
+    size_t stride; /* words per row */
+    int32_t first_row, /* the image row held in row 0 of the planes */
+            rows, /* how many rows are held */
+            capacity; /* how many rows there is space for */
+    uint64_t * on,
+             * off;
+};
+
+/* allocate an empty bitplane for an image of this size, with space for this
+ * many rows
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result bitplane_allocate(
+        int32_t width,
+        int32_t height,
+        int32_t capacity,
+        struct bitplane * plane_out
+    )
+{
+    size_t stride = ((size_t)width + 63) / 64;
+    uint64_t * on = malloc(sizeof(*on) * stride * capacity);
+    uint64_t * off = malloc(sizeof(*off) * stride * capacity);
+    if (!on || !off) {
+        free(on);
+        free(off);
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+    *plane_out = (struct bitplane) {
+        .width = width,
+        .height = height,
+        .stride = stride,
+        .capacity = capacity,
+        .on = on,
+        .off = off
+    };
+
+    return DFIELD_RESULT_OKAY;
+}
+
+/* pack one row of width texels into the on and off words for that row */
+static void bitplane_pack_row(
+        const uint8_t * row,
+        int32_t width,
+        size_t stride,
+        uint64_t * on,
+        uint64_t * off
+    )
+{
+    for (size_t i = 0; i < stride; i++) {
+        int32_t begin = (int32_t)(i * 64);
+        int32_t end = begin + 64 < width ? begin + 64 : width;
+        uint64_t word = 0,
+                 valid = 0;
+        for (int32_t x = begin; x < end; x++) {
+            word |= (uint64_t)(row[x] != 0) << (x - begin);
+            valid |= UINT64_C(1) << (x - begin);
+        }
+        on[i] = word;
+        off[i] = ~word & valid;
+    }
+}
+
+/* pack all of this data into a bitplane
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result bitplane_create(
+        const uint8_t * data,
+        int32_t width,
+        int32_t height,
+        struct bitplane * plane_out
+    )
+{
+    struct bitplane plane;
+    enum dfield_result result =
+        bitplane_allocate(width, height, height, &plane);
+    if (result) {
+        return result;
+    }
+
+    #pragma omp parallel for
+    for (int32_t y = 0; y < height; y++) {
+        bitplane_pack_row(
+                &data[(size_t)y * width],
+                width,
+                plane.stride,
+                &plane.on[y * plane.stride],
+                &plane.off[y * plane.stride]
+            );
+    }
+
+    plane.rows = height;
+    *plane_out = plane;
+
+    return DFIELD_RESULT_OKAY;
+}
+
+/* drop rows from the start of this bitplane's window so that it begins at
+ * this image row
+ */
+static void bitplane_drop_rows(struct bitplane * plane, int32_t first_row)
+{
+    int32_t drop = first_row - plane->first_row;
+    if (drop <= 0) {
+        return;
+    }
+    if (drop > plane->rows) {
+        drop = plane->rows;
+    }
+    size_t keep = (size_t)(plane->rows - drop) * plane->stride;
+    memmove(plane->on, &plane->on[drop * plane->stride],
+            sizeof(*plane->on) * keep);
+    memmove(plane->off, &plane->off[drop * plane->stride],
+            sizeof(*plane->off) * keep);
+    plane->first_row += drop;
+    plane->rows -= drop;
+}
+
+/* free the planes associated with a bitplane */
+static void bitplane_free(struct bitplane * plane)
+{
+    free(plane->on);
+    free(plane->off);
+}
+
+/* find the first set bit at or after x (and at or before hi) in this row,
+ * returning -1 if there isn't one
+ */
+static inline int32_t scan_right_scalar(
+        const uint64_t * row, int32_t x, int32_t hi)
+{
+    int32_t i = x >> 6;
+    int32_t last = hi >> 6;
+    uint64_t word = row[i] & (~UINT64_C(0) << (x & 63));
+    while (!word) {
+        if (++i > last) {
+            return -1;
+        }
+        word = row[i];
+    }
+    int32_t found = i * 64 + __builtin_ctzll(word);
+    return found <= hi ? found : -1;
+}
+
+/* find the last set bit at or before x (and at or after lo) in this row,
+ * returning -1 if there isn't one
+ */
+static inline int32_t scan_left_scalar(
+        const uint64_t * row, int32_t x, int32_t lo)
+{
+    int32_t i = x >> 6;
+    int32_t first = lo >> 6;
+    uint64_t word = row[i] & (~UINT64_C(0) >> (63 - (x & 63)));
+    while (!word) {
+        if (--i < first) {
+            return -1;
+        }
+        word = row[i];
+    }
+    int32_t found = i * 64 + 63 - __builtin_clzll(word);
+    return found >= lo ? found : -1;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/* scan_right_scalar, skipping empty words four at a time */
+[[gnu::target("avx2")]] static inline int32_t scan_right_avx2(
+        const uint64_t * row, int32_t x, int32_t hi)
+{
+    int32_t i = x >> 6;
+    int32_t last = hi >> 6;
+    uint64_t word = row[i] & (~UINT64_C(0) << (x & 63));
+    if (!word) {
+        for (i++; i + 3 <= last; i += 4) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)&row[i]);
+            if (!_mm256_testz_si256(v, v)) {
+                break;
+            }
+        }
+        for (; i <= last; i++) {
+            if ((word = row[i])) {
+                break;
+            }
+        }
+        if (i > last) {
+            return -1;
+        }
+    }
+    int32_t found = i * 64 + __builtin_ctzll(word);
+    return found <= hi ? found : -1;
+}
+
+/* scan_left_scalar, skipping empty words four at a time */
+[[gnu::target("avx2")]] static inline int32_t scan_left_avx2(
+        const uint64_t * row, int32_t x, int32_t lo)
+{
+    int32_t i = x >> 6;
+    int32_t first = lo >> 6;
+    uint64_t word = row[i] & (~UINT64_C(0) >> (63 - (x & 63)));
+    if (!word) {
+        for (i--; i - 3 >= first; i -= 4) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)&row[i - 3]);
+            if (!_mm256_testz_si256(v, v)) {
+                break;
+            }
+        }
+        for (; i >= first; i--) {
+            if ((word = row[i])) {
+                break;
+            }
+        }
+        if (i < first) {
+            return -1;
+        }
+    }
+    int32_t found = i * 64 + 63 - __builtin_clzll(word);
+    return found >= lo ? found : -1;
+}
+
+/* scan_right_scalar, skipping empty words two at a time */
+[[gnu::target("sse4.1")]] static inline int32_t scan_right_sse4(
+        const uint64_t * row, int32_t x, int32_t hi)
+{
+    int32_t i = x >> 6;
+    int32_t last = hi >> 6;
+    uint64_t word = row[i] & (~UINT64_C(0) << (x & 63));
+    if (!word) {
+        for (i++; i + 1 <= last; i += 2) {
+            __m128i v = _mm_loadu_si128((const __m128i *)&row[i]);
+            if (!_mm_testz_si128(v, v)) {
+                break;
+            }
+        }
+        for (; i <= last; i++) {
+            if ((word = row[i])) {
+                break;
+            }
+        }
+        if (i > last) {
+            return -1;
+        }
+    }
+    int32_t found = i * 64 + __builtin_ctzll(word);
+    return found <= hi ? found : -1;
+}
+
+/* scan_left_scalar, skipping empty words two at a time */
+[[gnu::target("sse4.1")]] static inline int32_t scan_left_sse4(
+        const uint64_t * row, int32_t x, int32_t lo)
+{
+    int32_t i = x >> 6;
+    int32_t first = lo >> 6;
+    uint64_t word = row[i] & (~UINT64_C(0) >> (63 - (x & 63)));
+    if (!word) {
+        for (i--; i - 1 >= first; i -= 2) {
+            __m128i v = _mm_loadu_si128((const __m128i *)&row[i - 1]);
+            if (!_mm_testz_si128(v, v)) {
+                break;
+            }
+        }
+        for (; i >= first; i--) {
+            if ((word = row[i])) {
+                break;
+            }
+        }
+        if (i < first) {
+            return -1;
+        }
+    }
+    int32_t found = i * 64 + 63 - __builtin_clzll(word);
+    return found >= lo ? found : -1;
+}
+#endif /* defined(__x86_64__) || defined(__i386__) */
+
+/* generate the texels [x_begin, x_end) of one row of output from a bitplane,
+ * finding (for each of them) the same minimum generate_brute_force would
+ *
+ * the bitplane's window must hold every input row within spread of the one
+ * this output row samples
+ *
+ * rows of the neighborhood are visited nearest first, so we stop as soon as
+ * no remaining row could beat what we have, and the horizontal reach shrinks
+ * as the minimum does. within each row the scan functions find the nearest
+ * texel of the other state on either side
+ */
+[[gnu::always_inline]] static inline void bitplane_row(
+        const struct bitplane * plane,
+        int32_t y,
+        int32_t x_begin,
+        int32_t x_end,
+        double x_scale,
+        double y_scale,
+        int32_t spread,
+        int8_t * out,
+        int32_t (*scan_right)(const uint64_t *, int32_t, int32_t),
+        int32_t (*scan_left)(const uint64_t *, int32_t, int32_t)
+    )
+{
+    int32_t y_in = input_coordinate(y, y_scale, plane->height);
+
+    for (int32_t x = x_begin; x < x_end; x++) {
+        int32_t x_in = input_coordinate(x, x_scale, plane->width);
+        size_t index =
+            (size_t)(y_in - plane->first_row) * plane->stride + (x_in >> 6);
+        bool state = (plane->on[index] >> (x_in & 63)) & 1;
+        const uint64_t * other = state ? plane->off : plane->on;
+
+        int32_t minimum = INT32_MAX;
+        for (int32_t i = 0; i <= spread && i * i < minimum; i++) {
+            int32_t reach = spread;
+            if (minimum != INT32_MAX) {
+                int32_t limit = (int32_t)sqrt(minimum - i * i);
+                if (limit < reach) {
+                    reach = limit;
+                }
+            }
+            int32_t lo = x_in - reach > 0 ? x_in - reach : 0;
+            int32_t hi = x_in + reach < plane->width - 1 ?
+                x_in + reach : plane->width - 1;
+
+            for (int32_t sign = -1; sign <= 1; sign += 2) {
+                if (i == 0 && sign == 1) {
+                    break;
+                }
+                int32_t y_in2 = y_in + sign * i;
+                if (y_in2 < 0 || y_in2 >= plane->height) {
+                    continue;
+                }
+                const uint64_t * row =
+                    &other[(size_t)(y_in2 - plane->first_row) * plane->stride];
+
+                int32_t j = INT32_MAX;
+                int32_t found = scan_right(row, x_in, hi);
+                if (found >= 0) {
+                    j = found - x_in;
+                }
+                found = scan_left(row, x_in, lo);
+                if (found >= 0 && x_in - found < j) {
+                    j = x_in - found;
+                }
+                if (j != INT32_MAX && i * i + j * j < minimum) {
+                    minimum = i * i + j * j;
+                }
+            }
+        }
+
+        out[x] = quantize(minimum, state, spread);
+    }
+}
+
+/* the signature of the bitplane_row_* functions */
+typedef void (*bitplane_row_function)(
+        const struct bitplane * plane,
+        int32_t y,
+        int32_t x_begin,
+        int32_t x_end,
+        double x_scale,
+        double y_scale,
+        int32_t spread,
+        int8_t * out
+    );
+
+/* bitplane_row for any CPU */
+static void bitplane_row_scalar(
+        const struct bitplane * plane,
+        int32_t y,
+        int32_t x_begin,
+        int32_t x_end,
+        double x_scale,
+        double y_scale,
+        int32_t spread,
+        int8_t * out
+    )
+{
+    bitplane_row(plane, y, x_begin, x_end, x_scale, y_scale, spread, out,
+                 scan_right_scalar, scan_left_scalar);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/* bitplane_row for CPUs with AVX2 */
+[[gnu::target("avx2")]] static void bitplane_row_avx2(
+        const struct bitplane * plane,
+        int32_t y,
+        int32_t x_begin,
+        int32_t x_end,
+        double x_scale,
+        double y_scale,
+        int32_t spread,
+        int8_t * out
+    )
+{
+    bitplane_row(plane, y, x_begin, x_end, x_scale, y_scale, spread, out,
+                 scan_right_avx2, scan_left_avx2);
+}
+
+/* bitplane_row for CPUs with SSE4.1 */
+[[gnu::target("sse4.1")]] static void bitplane_row_sse4(
+        const struct bitplane * plane,
+        int32_t y,
+        int32_t x_begin,
+        int32_t x_end,
+        double x_scale,
+        double y_scale,
+        int32_t spread,
+        int8_t * out
+    )
+{
+    bitplane_row(plane, y, x_begin, x_end, x_scale, y_scale, spread, out,
+                 scan_right_sse4, scan_left_sse4);
+}
+#endif /* defined(__x86_64__) || defined(__i386__) */
+
+/* pick the best bitplane_row_* function this CPU supports */
+static bitplane_row_function bitplane_row_select()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return bitplane_row_avx2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return bitplane_row_sse4;
+    }
+#endif /* defined(__x86_64__) || defined(__i386__) */
+    return bitplane_row_scalar;
+}
+
+/* the DFIELD_ALGORITHM_BITPLANE implementation of dfield_generate, packing
+ * the input once and then generating each of the outputs from it
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result generate_bitplane(
+        const uint8_t * data,
+        int32_t input_width,
+        int32_t input_height,
+        size_t n_outputs,
+        const struct dfield_output * outputs,
+        int8_t ** fields
+    )
+{
+    struct bitplane plane;
+    enum dfield_result result =
+        bitplane_create(data, input_width, input_height, &plane);
+    if (result) {
+        return result;
+    }
+
+    bitplane_row_function row_function = bitplane_row_select();
+
+    for (size_t i = 0; i < n_outputs; i++) {
+        int32_t output_width = outputs[i].width;
+        int32_t output_height = outputs[i].height;
+        double y_scale = (double)input_height / output_height;
+        double x_scale = (double)input_width / output_width;
+
+        #pragma omp parallel for schedule(dynamic)
+        for (int32_t y = 0; y < output_height; y++) {
+            row_function(
+                    &plane,
+                    y,
+                    0,
+                    output_width,
+                    x_scale,
+                    y_scale,
+                    outputs[i].spread,
+                    &fields[i][(size_t)y * output_width]
+                );
+        }
+    }
+
+    bitplane_free(&plane);
+
+    return DFIELD_RESULT_OKAY;
+}
+
+/* the squared distance we use when there is no texel of the other state
+ *
+ * this is what DFIELD_ALGORITHM_BRUTE_FORCE ends up with when there is none
+ * in the neighborhood, so the two quantize the same way
+ */
+constexpr int32_t edt_infinity = INT32_MAX;
+
+/* d * d, or edt_infinity if that doesn't fit (squared distances that large
+ * are beyond what the output can hold anyway)
+ */
+static int32_t edt_square(int32_t d)
+{
+    int64_t dsq = (int64_t)d * d;
+    return dsq < edt_infinity ? (int32_t)dsq : edt_infinity;
+}
+
+/* the one-dimensional squared distance transform of Felzenszwalb and
+ * Huttenlocher: for every q in [0, n), set d[q] to the minimum over p of
+ * (q - p)^2 + f[p]
+ *
+ * entries of f that are edt_infinity are not features and never become part
+ * of the lower envelope. if every entry is, every d[q] is edt_infinity
+ *
+ * v (n entries) and z (n + 1 entries) are scratch space
+ */
+static void edt_1d(
+        const int32_t * f,
+        int32_t n,
+        int32_t * d,
+        int32_t * v,
+        double * z
+    )
+{
+    /* build the lower envelope of the parabolas rooted at each feature */
+    int32_t k = -1;
+    for (int32_t q = 0; q < n; q++) {
+        if (f[q] == edt_infinity) {
+            continue;
+        }
+        double s = -INFINITY;
+        while (k >= 0) {
+            int32_t p = v[k];
+            s = ((double)f[q] + (double)q * q - (double)f[p] - (double)p * p)
+                / (2.0 * (q - p));
+            if (s > z[k]) {
+                break;
+            }
+            k--;
+        }
+        k++;
+        v[k] = q;
+        z[k] = k == 0 ? -INFINITY : s;
+        z[k + 1] = INFINITY;
+    }
+
+    if (k < 0) {
+        for (int32_t q = 0; q < n; q++) {
+            d[q] = edt_infinity;
+        }
+        return;
+    }
+
+    /* and then read the distances back off it */
+    int32_t j = 0;
+    for (int32_t q = 0; q < n; q++) {
+        while (z[j + 1] < q) {
+            j++;
+        }
+        int64_t dsq = (int64_t)(q - v[j]) * (q - v[j]) + f[v[j]];
+        d[q] = dsq < edt_infinity ? (int32_t)dsq : edt_infinity;
+    }
+}
+
+/* compute the exact squared euclidean distance from every texel in data to
+ * the nearest texel of the other state, storing it in distances (which must
+ * hold width * height entries)
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result edt_2d(
+        const uint8_t * data,
+        int32_t width,
+        int32_t height,
+        int32_t * distances
+    )
+{
+    /* first pass: down the columns
+     *
+     * we sweep the rows in order (keeping the last texel of each state seen
+     * in each column) rather than walking one column at a time so that
+     * memory access stays sequential
+     */
+    int32_t * last_off = malloc(sizeof(*last_off) * width);
+    int32_t * last_on = malloc(sizeof(*last_on) * width);
+    if (!last_off || !last_on) {
+        free(last_off);
+        free(last_on);
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+    for (int32_t x = 0; x < width; x++) {
+        last_off[x] = -1;
+        last_on[x] = -1;
+    }
+    for (int32_t y = 0; y < height; y++) {
+        const uint8_t * row = &data[(size_t)y * width];
+        int32_t * out = &distances[(size_t)y * width];
+        for (int32_t x = 0; x < width; x++) {
+            int32_t other;
+            if (row[x] != 0) {
+                last_on[x] = y;
+                other = last_off[x];
+            } else {
+                last_off[x] = y;
+                other = last_on[x];
+            }
+            out[x] = other < 0 ? edt_infinity : edt_square(y - other);
+        }
+    }
+
+    for (int32_t x = 0; x < width; x++) {
+        last_off[x] = -1;
+        last_on[x] = -1;
+    }
+    for (int32_t y = height - 1; y >= 0; y--) {
+        const uint8_t * row = &data[(size_t)y * width];
+        int32_t * out = &distances[(size_t)y * width];
+        for (int32_t x = 0; x < width; x++) {
+            int32_t other;
+            if (row[x] != 0) {
+                last_on[x] = y;
+                other = last_off[x];
+            } else {
+                last_off[x] = y;
+                other = last_on[x];
+            }
+            if (other >= 0 && edt_square(other - y) < out[x]) {
+                out[x] = edt_square(other - y);
+            }
+        }
+    }
+
+    free(last_off);
+    free(last_on);
+
+    /* second pass: across the rows
+     *
+     * the column pass left each texel with the (squared) vertical distance to
+     * the nearest texel of the other state. a texel's vertical distance to
+     * the nearest texel of its own state is zero, so we can recover one
+     * column transform per state from that and run the 1D transform on each
+     */
+    bool failed = false;
+
+    #pragma omp parallel
+    {
+        int32_t * f_off = malloc(sizeof(*f_off) * width);
+        int32_t * f_on = malloc(sizeof(*f_on) * width);
+        int32_t * d_off = malloc(sizeof(*d_off) * width);
+        int32_t * d_on = malloc(sizeof(*d_on) * width);
+        int32_t * v = malloc(sizeof(*v) * width);
+        double * z = malloc(sizeof(*z) * (width + 1));
+
+        bool allocated = f_off && f_on && d_off && d_on && v && z;
+        if (!allocated) {
+            #pragma omp atomic write
+            failed = true;
+        }
+
+        /* every thread has to reach the loop (it ends in a barrier), so one
+         * that couldn't allocate just skips its share
+         */
+        #pragma omp for
+        for (int32_t y = 0; y < height; y++) {
+            if (!allocated) {
+                continue;
+            }
+            const uint8_t * row = &data[(size_t)y * width];
+            int32_t * out = &distances[(size_t)y * width];
+            for (int32_t x = 0; x < width; x++) {
+                f_off[x] = row[x] == 0 ? 0 : out[x];
+                f_on[x] = row[x] != 0 ? 0 : out[x];
+            }
+            edt_1d(f_off, width, d_off, v, z);
+            edt_1d(f_on, width, d_on, v, z);
+            for (int32_t x = 0; x < width; x++) {
+                out[x] = row[x] != 0 ? d_off[x] : d_on[x];
+            }
+        }
+
+        free(f_off);
+        free(f_on);
+        free(d_off);
+        free(d_on);
+        free(v);
+        free(z);
+    }
+
+    if (failed) {
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+    return DFIELD_RESULT_OKAY;
+}
+
+/* the DFIELD_ALGORITHM_EDT implementation of dfield_generate, transforming
+ * the input once and then sampling each of the outputs from it
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result generate_edt(
+        const uint8_t * data,
+        int32_t input_width,
+        int32_t input_height,
+        size_t n_outputs,
+        const struct dfield_output * outputs,
+        int8_t ** fields
+    )
+{
+    int32_t * distances =
+        malloc(sizeof(*distances) * (size_t)input_width * input_height);
+    if (!distances) {
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+    enum dfield_result result =
+        edt_2d(data, input_width, input_height, distances);
+    if (result) {
+        free(distances);
+        return result;
+    }
+
+    for (size_t i = 0; i < n_outputs; i++) {
+        int32_t output_width = outputs[i].width;
+        int32_t output_height = outputs[i].height;
+        int32_t spread = outputs[i].spread;
+        int8_t * field = fields[i];
+        double y_scale = (double)input_height / output_height;
+        double x_scale = (double)input_width / output_width;
+
+        #pragma omp parallel for
+        for (int32_t y = 0; y < output_height; y++) {
+            for (int32_t x = 0; x < output_width; x++) {
+                int32_t x_in = input_coordinate(x, x_scale, input_width);
+                int32_t y_in = input_coordinate(y, y_scale, input_height);
+                size_t index = (size_t)y_in * input_width + x_in;
+                field[y * output_width + x] =
+                    quantize(distances[index], data[index] != 0, spread);
+            }
+        }
+    }
+
+    free(distances);
+
+    return DFIELD_RESULT_OKAY;
+}
+
+/* an edge of an outline traced by msdf_trace, with the on texels on the side
+ * where cross(b - a, p - a) > 0
+ */
+struct msdf_edge {
+    double ax, ay,
+           bx, by;
+    uint8_t color; /* which channels this edge counts for (msdf_red, etc.) */
+};
+
+/* the channels of an msdf_edge's color */
+constexpr uint8_t msdf_red = 1;
+constexpr uint8_t msdf_green = 2;
+constexpr uint8_t msdf_blue = 4;
+constexpr uint8_t msdf_white = msdf_red | msdf_green | msdf_blue;
+
+/* the colors the edges between corners cycle through. any two share exactly
+ * one channel, which is what keeps a corner sharp
+ */
+constexpr uint8_t msdf_colors[] = {
+    msdf_green | msdf_blue,
+    msdf_red | msdf_blue,
+    msdf_red | msdf_green
+};
+
+/* how far (in input texels) simplifying may move a traced outline
+ *
+ * the trace cuts the corners of on texels, passing as close as sqrt(2) / 4
+ * to their centers, so simplifying by less than that never moves an outline
+ * across a texel center (which would flip the sign of the field there,
+ * however much smaller than an output texel the tolerance is)
+ */
+constexpr double msdf_simplify_tolerance = 0.3;
+
+/* a vertex of a simplified outline is a corner if the cosine of the angle
+ * between the edges meeting there is less than this (about 40 degrees)
+ */
+constexpr double msdf_corner_cosine = 0.75;
+
+/* a growable list of edges */
+struct msdf_edges {
+    size_t n_edges, capacity;
+    struct msdf_edge * edges;
+};
+
+/* a growable list of points (x and y interleaved) */
+struct point_list {
+    size_t n_points, capacity;
+    double * points;
+};
+
+/* add this point to points, returning false if we ran out of memory */
+static bool point_list_add(struct point_list * points, double x, double y)
+{
+    if (points->n_points == points->capacity) {
+        size_t capacity = points->capacity ? points->capacity * 2 : 256;
+        double * new_points =
+            realloc(points->points, sizeof(*new_points) * 2 * capacity);
+        if (!new_points) {
+            return false;
+        }
+        points->points = new_points;
+        points->capacity = capacity;
+    }
+    points->points[2 * points->n_points] = x;
+    points->points[2 * points->n_points + 1] = y;
+    points->n_points++;
+    return true;
+}
+
+/* add this edge to edges, returning false if we ran out of memory */
+static bool msdf_edges_add(struct msdf_edges * edges, struct msdf_edge edge)
+{
+    if (edges->n_edges == edges->capacity) {
+        size_t capacity = edges->capacity ? edges->capacity * 2 : 256;
+        struct msdf_edge * new_edges =
+            realloc(edges->edges, sizeof(*new_edges) * capacity);
+        if (!new_edges) {
+            return false;
+        }
+        edges->edges = new_edges;
+        edges->capacity = capacity;
+    }
+    edges->edges[edges->n_edges++] = edge;
+    return true;
+}
+
+/* the distance from point p to the segment from a to b */
+static double msdf_segment_distance(
+        const double * p, const double * a, const double * b)
+{
+    double dx = b[0] - a[0],
+           dy = b[1] - a[1];
+    double length_squared = dx * dx + dy * dy;
+    double t = 0.0;
+    if (length_squared > 0.0) {
+        t = ((p[0] - a[0]) * dx + (p[1] - a[1]) * dy) / length_squared;
+        t = t < 0.0 ? 0.0 : t > 1.0 ? 1.0 : t;
+    }
+    return hypot(p[0] - (a[0] + t * dx), p[1] - (a[1] + t * dy));
+}
+
+/* simplify this closed loop of points (Douglas-Peucker, to within
+ * tolerance), marking the points to keep in keep
+ *
+ * stack is scratch space for 2 * n_points entries
+ *
+ * returns the number of points kept
+ */
+static size_t msdf_simplify(
+        const double * points,
+        size_t n_points,
+        double tolerance,
+        bool * keep,
+        size_t * stack
+    )
+{
+    for (size_t i = 0; i < n_points; i++) {
+        keep[i] = false;
+    }
+
+    /* split the loop at point 0 and the point farthest from it */
+    size_t farthest = 0;
+    double farthest_distance = 0.0;
+    for (size_t i = 1; i < n_points; i++) {
+        double distance = hypot(
+                points[2 * i] - points[0], points[2 * i + 1] - points[1]);
+        if (distance > farthest_distance) {
+            farthest = i;
+            farthest_distance = distance;
+        }
+    }
+    keep[0] = true;
+    keep[farthest] = true;
+
+    /* indices of n_points mean point 0 again */
+    size_t n_stack = 0;
+    stack[n_stack++] = 0;
+    stack[n_stack++] = farthest;
+    stack[n_stack++] = farthest;
+    stack[n_stack++] = n_points;
+
+    while (n_stack) {
+        size_t last = stack[--n_stack];
+        size_t first = stack[--n_stack];
+        const double * a = &points[2 * first];
+        const double * b = &points[2 * (last % n_points)];
+
+        size_t worst = first;
+        double worst_distance = tolerance;
+        for (size_t i = first + 1; i < last; i++) {
+            double distance = msdf_segment_distance(&points[2 * i], a, b);
+            if (distance > worst_distance) {
+                worst = i;
+                worst_distance = distance;
+            }
+        }
+
+        if (worst != first) {
+            keep[worst] = true;
+            stack[n_stack++] = first;
+            stack[n_stack++] = worst;
+            stack[n_stack++] = worst;
+            stack[n_stack++] = last;
+        }
+    }
+
+    size_t n_kept = 0;
+    for (size_t i = 0; i < n_points; i++) {
+        n_kept += keep[i];
+    }
+    return n_kept;
+}
+
+/* add the edges of this polygon (of n_vertices vertices, x and y interleaved)
+ * to edges, colored so that the edges meeting at each corner share only one
+ * channel (this is the simple edge coloring of Chlumsky's msdfgen)
+ *
+ * returns false if we ran out of memory
+ */
+static bool msdf_add_polygon(
+        const double * vertices,
+        size_t n_vertices,
+        struct msdf_edges * edges
+    )
+{
+    /* find the corners */
+    size_t n_corners = 0,
+           first_corner = 0;
+    bool * corner = malloc(sizeof(*corner) * n_vertices);
+    if (!corner) {
+        return false;
+    }
+    for (size_t i = 0; i < n_vertices; i++) {
+        const double * previous =
+            &vertices[2 * ((i + n_vertices - 1) % n_vertices)];
+        const double * here = &vertices[2 * i];
+        const double * next = &vertices[2 * ((i + 1) % n_vertices)];
+        double ax = here[0] - previous[0],
+               ay = here[1] - previous[1],
+               bx = next[0] - here[0],
+               by = next[1] - here[1];
+        double cosine = (ax * bx + ay * by) / (hypot(ax, ay) * hypot(bx, by));
+        corner[i] = !(cosine >= msdf_corner_cosine);
+        if (corner[i]) {
+            if (n_corners == 0) {
+                first_corner = i;
+            }
+            n_corners++;
+        }
+    }
+
+    /* walk the edges starting at the first corner */
+    size_t spline = 0;
+    uint8_t color = msdf_white;
+    for (size_t j = 0; j < n_vertices; j++) {
+        size_t i = (first_corner + j) % n_vertices;
+
+        if (n_corners == 1) {
+            /* a teardrop: split it in three so the corner still gets two
+             * colors
+             */
+            constexpr uint8_t thirds[] = {
+                msdf_red | msdf_blue, msdf_white, msdf_red | msdf_green
+            };
+            color = thirds[3 * j / n_vertices];
+        } else if (n_corners > 1 && corner[i]) {
+            color = msdf_colors[spline % 3];
+            /* the last spline meets the first one too */
+            if (spline == n_corners - 1 && spline > 0 &&
+                    color == msdf_colors[0]) {
+                color = msdf_colors[(spline - 1) % 3 == 1 ? 2 : 1];
+            }
+            spline++;
+        }
+
+        const double * a = &vertices[2 * i];
+        const double * b = &vertices[2 * ((i + 1) % n_vertices)];
+        if (!msdf_edges_add(edges, (struct msdf_edge) {
+                    .ax = a[0],
+                    .ay = a[1],
+                    .bx = b[0],
+                    .by = b[1],
+                    .color = color
+                })) {
+            free(corner);
+            return false;
+        }
+    }
+
+    free(corner);
+    return true;
+}
+
+/* the state of texel (i - 1, j - 1) of this data, or off if that's outside
+ * it
+ */
+static inline bool msdf_padded(
+        const uint8_t * data,
+        int32_t width,
+        int32_t height,
+        size_t i,
+        size_t j
+    )
+{
+    return i > 0 && j > 0 && i <= (size_t)width && j <= (size_t)height &&
+           data[(j - 1) * (size_t)width + i - 1] != 0;
+}
+
+/* the closed outlines traced by msdf_trace: outline i is points
+ * starts[i] to starts[i + 1] (exclusive) of points
+ */
+struct msdf_outlines {
+    size_t n_outlines;
+    size_t * starts;
+    struct point_list points;
+};
+
+/* free the data associated with a msdf_outlines */
+static void msdf_outlines_free(struct msdf_outlines * outlines)
+{
+    free(outlines->starts);
+    free(outlines->points.points);
+}
+
+/* trace the outlines of this data, in the coordinates of input texel
+ * centers
+ *
+ * this is marching squares over the texel centers, with everything outside
+ * the image treated as off, so every outline is closed. where a square has
+ * two on corners diagonal from each other they are treated as connected
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result msdf_trace(
+        const uint8_t * data,
+        int32_t width,
+        int32_t height,
+        struct msdf_outlines * outlines_out
+    )
+{
+    /* the image padded by one texel of off on each side */
+    size_t padded_width = (size_t)width + 2,
+           padded_height = (size_t)height + 2;
+
+    /* every crossing between two neighboring padded texels has an id: the
+     * one between (i, j) and (i + 1, j) is 2 * (j * padded_width + i), and the
+     * one between (i, j) and (i, j + 1) is that plus 1. next maps each
+     * crossing to the following one along its outline
+     */
+    size_t n_ids = 2 * padded_width * padded_height;
+    if (n_ids >= UINT32_MAX) {
+        return DFIELD_RESULT_ERROR_BAD_INPUT_SIZE;
+    }
+    uint32_t * next = malloc(sizeof(*next) * n_ids);
+    if (!next) {
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+    memset(next, 0xff, sizeof(*next) * n_ids);
+
+    #pragma omp parallel for
+    for (size_t j = 0; j < padded_height - 1; j++) {
+        for (size_t i = 0; i < padded_width - 1; i++) {
+            /* the corners and sides of this square, clockwise from the top
+             * left (with y down)
+             */
+            bool state[4] = {
+                msdf_padded(data, width, height, i, j),
+                msdf_padded(data, width, height, i + 1, j),
+                msdf_padded(data, width, height, i + 1, j + 1),
+                msdf_padded(data, width, height, i, j + 1)
+            };
+            uint32_t id[4] = {
+                (uint32_t)(2 * (j * padded_width + i)),
+                (uint32_t)(2 * (j * padded_width + i + 1) + 1),
+                (uint32_t)(2 * ((j + 1) * padded_width + i)),
+                (uint32_t)(2 * (j * padded_width + i) + 1)
+            };
+
+            /* join each crossing from on to off to the next crossing
+             * clockwise, which cuts off the off corners between them
+             */
+            for (int k = 0; k < 4; k++) {
+                if (!state[k] || state[(k + 1) % 4]) {
+                    continue;
+                }
+                for (int l = 1; l < 4; l++) {
+                    int m = (k + l) % 4;
+                    if (state[m] != state[(m + 1) % 4]) {
+                        next[id[k]] = id[m];
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    struct msdf_outlines outlines = { };
+    size_t starts_capacity = 0;
+    enum dfield_result result = DFIELD_RESULT_OKAY;
+
+    for (size_t start = 0; start < n_ids && !result; start++) {
+        if (next[start] == UINT32_MAX) {
+            continue;
+        }
+
+        if (outlines.n_outlines + 2 > starts_capacity) {
+            size_t capacity = starts_capacity ? starts_capacity * 2 : 64;
+            size_t * starts =
+                realloc(outlines.starts, sizeof(*starts) * capacity);
+            if (!starts) {
+                result = DFIELD_RESULT_ERROR_MEMORY;
+                break;
+            }
+            outlines.starts = starts;
+            starts_capacity = capacity;
+        }
+        outlines.starts[outlines.n_outlines++] = outlines.points.n_points;
+
+        /* follow the outline around, forgetting it as we go */
+        size_t id = start;
+        while (next[id] != UINT32_MAX) {
+            size_t i = (id / 2) % padded_width,
+                   j = (id / 2) / padded_width;
+            /* texel centers are at integer coordinates, and padded texel
+             * (i, j) is texel (i - 1, j - 1)
+             */
+            double x = (double)i - 1.0 + (id % 2 ? 0.0 : 0.5),
+                   y = (double)j - 1.0 + (id % 2 ? 0.5 : 0.0);
+            if (!point_list_add(&outlines.points, x, y)) {
+                result = DFIELD_RESULT_ERROR_MEMORY;
+                break;
+            }
+            size_t following = next[id];
+            next[id] = UINT32_MAX;
+            id = following;
+        }
+    }
+
+    free(next);
+
+    if (result) {
+        msdf_outlines_free(&outlines);
+        return result;
+    }
+
+    if (!outlines.starts) {
+        outlines.starts = malloc(sizeof(*outlines.starts));
+        if (!outlines.starts) {
+            return DFIELD_RESULT_ERROR_MEMORY;
+        }
+    }
+    outlines.starts[outlines.n_outlines] = outlines.points.n_points;
+
+    *outlines_out = outlines;
+    return DFIELD_RESULT_OKAY;
+}
+
+/* simplify these outlines (to within tolerance) into polygons and put their
+ * colored edges in edges_out
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result msdf_color_outlines(
+        const struct msdf_outlines * outlines,
+        double tolerance,
+        struct msdf_edges * edges_out
+    )
+{
+    size_t longest = 0;
+    for (size_t i = 0; i < outlines->n_outlines; i++) {
+        size_t n_points = outlines->starts[i + 1] - outlines->starts[i];
+        if (n_points > longest) {
+            longest = n_points;
+        }
+    }
+
+    bool * keep = malloc(sizeof(*keep) * (longest + 1));
+    size_t * stack = malloc(sizeof(*stack) * 2 * (longest + 1));
+    double * vertices = malloc(sizeof(*vertices) * 2 * (longest + 1));
+    if (!keep || !stack || !vertices) {
+        free(keep);
+        free(stack);
+        free(vertices);
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+    struct msdf_edges edges = { };
+    enum dfield_result result = DFIELD_RESULT_OKAY;
+
+    for (size_t i = 0; i < outlines->n_outlines; i++) {
+        const double * points =
+            &outlines->points.points[2 * outlines->starts[i]];
+        size_t n_points = outlines->starts[i + 1] - outlines->starts[i];
+
+        /* simplifying a very thin outline can leave too little of it to
+         * have an inside, so keep all of those
+         */
+        size_t n_vertices = 0;
+        bool simplify =
+            msdf_simplify(points, n_points, tolerance, keep, stack) >= 4;
+        for (size_t j = 0; j < n_points; j++) {
+            if (!simplify || keep[j]) {
+                vertices[2 * n_vertices] = points[2 * j];
+                vertices[2 * n_vertices + 1] = points[2 * j + 1];
+                n_vertices++;
+            }
+        }
+
+        if (!msdf_add_polygon(vertices, n_vertices, &edges)) {
+            result = DFIELD_RESULT_ERROR_MEMORY;
+            break;
+        }
+    }
+
+    free(keep);
+    free(stack);
+    free(vertices);
+
+    if (result) {
+        free(edges.edges);
+        return result;
+    }
+
+    *edges_out = edges;
+    return DFIELD_RESULT_OKAY;
+}
+
+/* the nearest edge (of some color) found so far from a point */
+struct msdf_nearest {
+    const struct msdf_edge * edge;
+    double distance; /* to the edge itself */
+    double dot; /* for breaking ties between edges meeting at a vertex: the
+                 * |cosine| between the edge and the direction to the point
+                 * from the vertex (0 if the nearest point is inside the edge)
+                 */
+};
+
+/* make edge (at this distance and dot) nearest if it is nearer */
+static inline void msdf_consider(
+        struct msdf_nearest * nearest,
+        const struct msdf_edge * edge,
+        double distance,
+        double dot
+    )
+{
+    if (!nearest->edge || distance < nearest->distance ||
+            (distance == nearest->distance && dot < nearest->dot)) {
+        *nearest = (struct msdf_nearest) {
+            .edge = edge,
+            .distance = distance,
+            .dot = dot
+        };
+    }
+}
+
+/* the signed pseudo-distance from (px, py) to this edge: the distance to the
+ * line through it, negative on the on side
+ */
+static inline double msdf_pseudo_distance(
+        const struct msdf_edge * edge, double px, double py)
+{
+    double dx = edge->bx - edge->ax,
+           dy = edge->by - edge->ay;
+    double cross = dx * (py - edge->ay) - dy * (px - edge->ax);
+    return -cross / hypot(dx, dy);
+}
+
+/* the grid cell (in one dimension) that this coordinate is in, for a grid of
+ * n_cells cells (anything beyond the grid is in the cell at its edge)
+ */
+static inline size_t msdf_cell(
+        double coordinate, double cell_size, size_t n_cells)
+{
+    double cell = (coordinate + 1) / cell_size;
+    if (!(cell > 0.0)) {
+        return 0;
+    }
+    return cell < (double)(n_cells - 1) ? (size_t)cell : n_cells - 1;
+}
+
+/* fill this field (of this output and format) from these edges, which are in
+ * the coordinates of input texel centers for an input of this size
+ *
+ * edges are bucketed in a grid of cells at least as large as the distance at
+ * which field values saturate, so each texel only looks at the edges in the
+ * cells around it. a channel with no edge of its color that close saturates
+ * on the side the nearest edge (or failing that, inside) says
+ *
+ * inside says whether each output texel is on. if exact is true it is also
+ * used for the sign of the plain signed distance, rather than the side of the
+ * nearest edge (which can be wrong where outlines overlap)
+ *
+ * a DFIELD_FORMAT_SDF field gets only the plain signed distance
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result msdf_fill(
+        const struct msdf_edges * edges,
+        int32_t input_width,
+        int32_t input_height,
+        const struct dfield_output * output,
+        enum dfield_format format,
+        const bool * inside,
+        bool exact,
+        int8_t * field
+    )
+{
+    int32_t output_width = output->width;
+    int32_t output_height = output->height;
+    int32_t spread = output->spread;
+    double y_scale = (double)input_height / output_height;
+    double x_scale = (double)input_width / output_width;
+    int32_t channels = dfield_format_channels(format);
+
+    /* past this, every value is saturated */
+    double reach = spread * M_SQRT2;
+
+    /* the grid covers [-1, width] by [-1, height], which holds every texel
+     * we sample (and every traced outline)
+     */
+    double cell_size = reach > 8.0 ? reach : 8.0;
+    size_t grid_width = (size_t)((input_width + 2) / cell_size) + 1,
+           grid_height = (size_t)((input_height + 2) / cell_size) + 1;
+    size_t n_cells = grid_width * grid_height;
+
+    size_t * cell_start = calloc(n_cells + 1, sizeof(*cell_start));
+    if (!cell_start) {
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+    /* count, then fill, the edges overlapping each cell */
+    size_t * cell_edges = NULL;
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t e = 0; e < edges->n_edges; e++) {
+            const struct msdf_edge * edge = &edges->edges[e];
+            size_t x0 = msdf_cell(
+                           fmin(edge->ax, edge->bx), cell_size, grid_width),
+                   x1 = msdf_cell(
+                           fmax(edge->ax, edge->bx), cell_size, grid_width),
+                   y0 = msdf_cell(
+                           fmin(edge->ay, edge->by), cell_size, grid_height),
+                   y1 = msdf_cell(
+                           fmax(edge->ay, edge->by), cell_size, grid_height);
+            for (size_t y = y0; y <= y1; y++) {
+                for (size_t x = x0; x <= x1; x++) {
+                    size_t cell = y * grid_width + x;
+                    if (pass == 0) {
+                        cell_start[cell + 1]++;
+                    } else {
+                        cell_edges[cell_start[cell]++] = e;
+                    }
+                }
+            }
+        }
+        if (pass == 0) {
+            for (size_t cell = 0; cell < n_cells; cell++) {
+                cell_start[cell + 1] += cell_start[cell];
+            }
+            cell_edges = malloc(
+                    sizeof(*cell_edges) * (cell_start[n_cells] + 1));
+            if (!cell_edges) {
+                free(cell_start);
+                return DFIELD_RESULT_ERROR_MEMORY;
+            }
+        } else {
+            /* filling moved each start to the next cell's */
+            for (size_t cell = n_cells; cell > 0; cell--) {
+                cell_start[cell] = cell_start[cell - 1];
+            }
+            cell_start[0] = 0;
+        }
+    }
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int32_t y = 0; y < output_height; y++) {
+        for (int32_t x = 0; x < output_width; x++) {
+            double px = x * x_scale,
+                   py = y * y_scale;
+
+            /* channels 0 to 2, then the nearest of any color */
+            struct msdf_nearest nearest[4] = { };
+
+            size_t x0 = (size_t)fmax(0.0, (px - reach + 1) / cell_size),
+                   x1 = (size_t)fmin(
+                           grid_width - 1, (px + reach + 1) / cell_size),
+                   y0 = (size_t)fmax(0.0, (py - reach + 1) / cell_size),
+                   y1 = (size_t)fmin(
+                           grid_height - 1, (py + reach + 1) / cell_size);
+            for (size_t cy = y0; cy <= y1; cy++) {
+                for (size_t cx = x0; cx <= x1; cx++) {
+                    size_t cell = cy * grid_width + cx;
+                    for (size_t k = cell_start[cell];
+                            k < cell_start[cell + 1]; k++) {
+                        const struct msdf_edge * edge =
+                            &edges->edges[cell_edges[k]];
+                        double dx = edge->bx - edge->ax,
+                               dy = edge->by - edge->ay;
+                        double length = hypot(dx, dy);
+                        double t = ((px - edge->ax) * dx +
+                                    (py - edge->ay) * dy) /
+                                   (length * length);
+                        double distance, dot = 0.0;
+                        if (t > 0.0 && t < 1.0) {
+                            distance = fabs(
+                                    dx * (py - edge->ay) -
+                                    dy * (px - edge->ax)) / length;
+                        } else {
+                            double vx = t <= 0.0 ? edge->ax : edge->bx,
+                                   vy = t <= 0.0 ? edge->ay : edge->by;
+                            distance = hypot(px - vx, py - vy);
+                            if (distance > 0.0) {
+                                dot = fabs(
+                                        (dx * (px - vx) +
+                                         dy * (py - vy)) /
+                                        (length * distance));
+                            }
+                        }
+                        if (channels == 4) {
+                            for (int c = 0; c < 3; c++) {
+                                if (edge->color & (1 << c)) {
+                                    msdf_consider(
+                                            &nearest[c],
+                                            edge,
+                                            distance,
+                                            dot
+                                        );
+                                }
+                            }
+                        }
+                        msdf_consider(&nearest[3], edge, distance, dot);
+                    }
+                }
+            }
+
+            /* which side we're on, for channels with nothing in reach */
+            bool on = inside[(size_t)y * output_width + x];
+            double any = on ? -1.0 : 1.0;
+            if (!exact && nearest[3].edge && nearest[3].distance <= reach) {
+                any = msdf_pseudo_distance(nearest[3].edge, px, py);
+                on = any < 0.0;
+            }
+            double saturated = on ? -2.0 * reach : 2.0 * reach;
+
+            int8_t * texel =
+                &field[channels * ((size_t)y * output_width + x)];
+            if (channels == 4) {
+                for (int c = 0; c < 3; c++) {
+                    double distance = saturated;
+                    if (nearest[c].edge && nearest[c].distance <= reach) {
+                        distance = msdf_pseudo_distance(
+                                nearest[c].edge, px, py);
+                    }
+                    texel[c] = quantize_edge_distance(distance, spread);
+                }
+            }
+            texel[channels - 1] = quantize_edge_distance(
+                    nearest[3].edge && nearest[3].distance <= reach ?
+                        copysign(nearest[3].distance, any) : saturated,
+                    spread
+                );
+        }
+    }
+
+    free(cell_edges);
+    free(cell_start);
+
+    return DFIELD_RESULT_OKAY;
+}
+
+/* like generate_edt, but tracing the outline of the input and generating
+ * DFIELD_FORMAT_MSDF fields from it (see msdf_fill)
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result generate_msdf(
+        const uint8_t * data,
+        int32_t input_width,
+        int32_t input_height,
+        size_t n_outputs,
+        const struct dfield_output * outputs,
+        int8_t ** fields
+    )
+{
+    struct msdf_outlines outlines;
+    enum dfield_result result =
+        msdf_trace(data, input_width, input_height, &outlines);
+    if (result) {
+        return result;
+    }
+
+    /* the tolerance doesn't depend on the output, so neither do the edges */
+    struct msdf_edges edges;
+    result = msdf_color_outlines(&outlines, msdf_simplify_tolerance, &edges);
+    msdf_outlines_free(&outlines);
+    if (result) {
+        return result;
+    }
+
+    for (size_t i = 0; i < n_outputs; i++) {
+        int32_t output_width = outputs[i].width;
+        int32_t output_height = outputs[i].height;
+        double y_scale = (double)input_height / output_height;
+        double x_scale = (double)input_width / output_width;
+
+        bool * inside =
+            malloc(sizeof(*inside) * output_width * output_height);
+        if (!inside) {
+            free(edges.edges);
+            return DFIELD_RESULT_ERROR_MEMORY;
+        }
+        for (int32_t y = 0; y < output_height; y++) {
+            int32_t y_in = input_coordinate(y, y_scale, input_height);
+            for (int32_t x = 0; x < output_width; x++) {
+                int32_t x_in = input_coordinate(x, x_scale, input_width);
+                inside[(size_t)y * output_width + x] =
+                    data[(size_t)y_in * input_width + x_in] != 0;
+            }
+        }
+
+        result = msdf_fill(
+                &edges,
+                input_width,
+                input_height,
+                &outputs[i],
+                DFIELD_FORMAT_MSDF,
+                inside,
+                false,
+                fields[i]
+            );
+        free(inside);
+
+        if (result) {
+            free(edges.edges);
+            return result;
+        }
+    }
+
+    free(edges.edges);
+
+    return DFIELD_RESULT_OKAY;
+}
+
+/* the signed distance from the center of a texel with this coverage (0 to 1)
+ * to the edge passing through it, along a coverage gradient of (gx, gy):
+ * positive when the center is outside (the edgedf of Gustavson and Strand's
+ * anti-aliased euclidean distance transform)
+ */
+static double coverage_edge_distance(double gx, double gy, double a)
+{
+    if (gx == 0.0 || gy == 0.0) {
+        /* along an axis this is exact (and otherwise a fair guess) */
+        return 0.5 - a;
+    }
+
+    /* it's symmetric, so work in the first octant (gx >= gy >= 0) */
+    double length = hypot(gx, gy);
+    gx = fabs(gx) / length;
+    gy = fabs(gy) / length;
+    if (gx < gy) {
+        double swap = gx;
+        gx = gy;
+        gy = swap;
+    }
+
+    double a1 = 0.5 * gy / gx;
+    if (a < a1) {
+        return 0.5 * (gx + gy) - sqrt(2.0 * gx * gy * a);
+    } else if (a < 1.0 - a1) {
+        return (0.5 - a) * gx;
+    } else {
+        return -0.5 * (gx + gy) + sqrt(2.0 * gx * gy * (1.0 - a));
+    }
+}
+
+/* the coverage (0 to 1) of texel (x, y), clamped to the edge of the image */
+static inline double coverage_at(
+        const uint8_t * data,
+        int32_t width,
+        int32_t height,
+        int32_t x,
+        int32_t y
+    )
+{
+    x = x < 0 ? 0 : x >= width ? width - 1 : x;
+    y = y < 0 ? 0 : y >= height ? height - 1 : y;
+    return data[(size_t)y * width + x] / 255.0;
+}
+
+/* find the points where the edges of this coverage data pass, in the
+ * coordinates of input texel centers, and put them in points_out
+ *
+ * every partly-covered texel has one, placed by its coverage and gradient.
+ * fully on texels next to fully off ones (hard edges) have one between them
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result coverage_edge_points(
+        const uint8_t * data,
+        int32_t width,
+        int32_t height,
+        struct point_list * points_out
+    )
+{
+    struct point_list points = { };
+
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            uint8_t value = data[(size_t)y * width + x];
+
+            if (value > 0 && value < 255) {
+                /* the sobel gradient (weighted as Gustavson and Strand
+                 * do), which points toward more coverage
+                 */
+                double nw = coverage_at(data, width, height, x - 1, y - 1),
+                       n = coverage_at(data, width, height, x, y - 1),
+                       ne = coverage_at(data, width, height, x + 1, y - 1),
+                       w = coverage_at(data, width, height, x - 1, y),
+                       e = coverage_at(data, width, height, x + 1, y),
+                       sw = coverage_at(data, width, height, x - 1, y + 1),
+                       s = coverage_at(data, width, height, x, y + 1),
+                       se = coverage_at(data, width, height, x + 1, y + 1);
+                double gx = ne + M_SQRT2 * e + se - nw - M_SQRT2 * w - sw,
+                       gy = sw + M_SQRT2 * s + se - nw - M_SQRT2 * n - ne;
+
+                double px = x,
+                       py = y;
+                double length = hypot(gx, gy);
+                if (length > 0.0) {
+                    double distance =
+                        coverage_edge_distance(gx, gy, value / 255.0);
+                    px += gx / length * distance;
+                    py += gy / length * distance;
+                }
+                if (!point_list_add(&points, px, py)) {
+                    free(points.points);
+                    return DFIELD_RESULT_ERROR_MEMORY;
+                }
+                continue;
+            }
+
+            /* hard edges to the right and below */
+            if (x + 1 < width &&
+                    (value ^ data[(size_t)y * width + x + 1]) == 255) {
+                if (!point_list_add(&points, x + 0.5, y)) {
+                    free(points.points);
+                    return DFIELD_RESULT_ERROR_MEMORY;
+                }
+            }
+            if (y + 1 < height &&
+                    (value ^ data[(size_t)(y + 1) * width + x]) == 255) {
+                if (!point_list_add(&points, x, y + 0.5)) {
+                    free(points.points);
+                    return DFIELD_RESULT_ERROR_MEMORY;
+                }
+            }
+        }
+    }
+
+    *points_out = points;
+    return DFIELD_RESULT_OKAY;
+}
+
+/* like generate_edt, but treating the input as coverage (0 is off, 255 is
+ * on, and anything between is partly covered by the shape) and measuring to
+ * where the edges pass through the texels rather than between texel centers
+ *
+ * the edge points are bucketed in a grid and each texel searches the cells
+ * around it in rings, stopping once no nearer point is possible
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result generate_coverage(
+        const uint8_t * data,
+        int32_t input_width,
+        int32_t input_height,
+        size_t n_outputs,
+        const struct dfield_output * outputs,
+        int8_t ** fields
+    )
+{
+    struct point_list points;
+    enum dfield_result result =
+        coverage_edge_points(data, input_width, input_height, &points);
+    if (result) {
+        return result;
+    }
+
+    for (size_t i = 0; i < n_outputs; i++) {
+        int32_t output_width = outputs[i].width;
+        int32_t output_height = outputs[i].height;
+        int32_t spread = outputs[i].spread;
+        double y_scale = (double)input_height / output_height;
+        double x_scale = (double)input_width / output_width;
+
+        /* past this, every value is saturated */
+        double reach = spread * M_SQRT2;
+
+        /* every point is in [-0.5, width - 0.5] by [-0.5, height - 0.5] */
+        double cell_size = reach / 4 > 4.0 ? reach / 4 : 4.0;
+        int32_t grid_width = (int32_t)((input_width + 1) / cell_size) + 1,
+                grid_height = (int32_t)((input_height + 1) / cell_size) + 1;
+        size_t n_cells = (size_t)grid_width * grid_height;
+
+        size_t * cell_start = calloc(n_cells + 1, sizeof(*cell_start));
+        double * cell_points = malloc(
+                sizeof(*cell_points) * 2 * (points.n_points + 1));
+        if (!cell_start || !cell_points) {
+            free(cell_start);
+            free(cell_points);
+            free(points.points);
+            return DFIELD_RESULT_ERROR_MEMORY;
+        }
+
+        /* sort the points into their cells */
+        for (size_t j = 0; j < points.n_points; j++) {
+            size_t cell =
+                (size_t)((points.points[2 * j + 1] + 1) / cell_size) *
+                    grid_width +
+                (size_t)((points.points[2 * j] + 1) / cell_size);
+            cell_start[cell + 1]++;
+        }
+        for (size_t cell = 0; cell < n_cells; cell++) {
+            cell_start[cell + 1] += cell_start[cell];
+        }
+        for (size_t j = 0; j < points.n_points; j++) {
+            size_t cell =
+                (size_t)((points.points[2 * j + 1] + 1) / cell_size) *
+                    grid_width +
+                (size_t)((points.points[2 * j] + 1) / cell_size);
+            size_t k = cell_start[cell]++;
+            cell_points[2 * k] = points.points[2 * j];
+            cell_points[2 * k + 1] = points.points[2 * j + 1];
+        }
+        for (size_t cell = n_cells; cell > 0; cell--) {
+            cell_start[cell] = cell_start[cell - 1];
+        }
+        cell_start[0] = 0;
+
+        int8_t * field = fields[i];
+
+        #pragma omp parallel for schedule(dynamic)
+        for (int32_t y = 0; y < output_height; y++) {
+            for (int32_t x = 0; x < output_width; x++) {
+                int32_t x_in = input_coordinate(x, x_scale, input_width);
+                int32_t y_in = input_coordinate(y, y_scale, input_height);
+                bool on = data[(size_t)y_in * input_width + x_in] >= 128;
+
+                int32_t cx = (int32_t)((x_in + 1) / cell_size),
+                        cy = (int32_t)((y_in + 1) / cell_size);
+
+                /* ring r is the cells r away from ours, none of which can
+                 * be nearer than (r - 1) * cell_size
+                 */
+                double minimum_squared = INFINITY;
+                for (int32_t r = 0; (r - 1) * cell_size <= reach; r++) {
+                    if ((r - 1) * cell_size >= 0 &&
+                            (r - 1) * cell_size * (r - 1) * cell_size >=
+                                minimum_squared) {
+                        break;
+                    }
+                    for (int32_t gy = cy - r; gy <= cy + r; gy++) {
+                        if (gy < 0 || gy >= grid_height) {
+                            continue;
+                        }
+                        /* only the ends of the inner rows are in the ring */
+                        int32_t step = gy == cy - r || gy == cy + r ?
+                            1 : 2 * r;
+                        for (int32_t gx = cx - r; gx <= cx + r;
+                                gx += step > 0 ? step : 1) {
+                            if (gx < 0 || gx >= grid_width) {
+                                continue;
+                            }
+                            size_t cell = (size_t)gy * grid_width + gx;
+                            for (size_t k = cell_start[cell];
+                                    k < cell_start[cell + 1]; k++) {
+                                double dx = cell_points[2 * k] - x_in,
+                                       dy = cell_points[2 * k + 1] - y_in;
+                                double distance_squared = dx * dx + dy * dy;
+                                if (distance_squared < minimum_squared) {
+                                    minimum_squared = distance_squared;
+                                }
+                            }
+                        }
+                    }
+                }
+
+                double distance = minimum_squared <= reach * reach ?
+                    sqrt(minimum_squared) : 2.0 * reach;
+                field[(size_t)y * output_width + x] =
+                    quantize_edge_distance(on ? -distance : distance, spread);
+            }
+        }
+
+        free(cell_points);
+        free(cell_start);
+    }
+
+    free(points.points);
+
+    return DFIELD_RESULT_OKAY;
+}
+
+/* how far (in input texels) the lines that curves are flattened into may be
+ * from the curves
+ */
+constexpr double shape_flatness = 1.0 / 64;
+
+/* the most lines a single curve is flattened into */
+constexpr int32_t shape_max_curve_lines = 1024;
+
+/* add point (x, y) to the outline being built in outlines, unless it is the
+ * same as the last one, returning false if we ran out of memory
+ */
+static bool shape_add_point(
+        struct msdf_outlines * outlines, double x, double y)
+{
+    struct point_list * points = &outlines->points;
+    size_t start = outlines->starts[outlines->n_outlines];
+    if (points->n_points > start &&
+            points->points[2 * points->n_points - 2] == x &&
+            points->points[2 * points->n_points - 1] == y) {
+        return true;
+    }
+    return point_list_add(points, x, y);
+}
+
+/* finish the outline being built in outlines (dropping it if it has no area
+ * to speak of), returning false if we ran out of memory
+ */
+static bool shape_end_outline(
+        struct msdf_outlines * outlines, size_t * starts_capacity)
+{
+    struct point_list * points = &outlines->points;
+    size_t start = outlines->starts[outlines->n_outlines];
+
+    /* outlines are closed implicitly */
+    if (points->n_points > start + 1 &&
+            points->points[2 * points->n_points - 2] ==
+                points->points[2 * start] &&
+            points->points[2 * points->n_points - 1] ==
+                points->points[2 * start + 1]) {
+        points->n_points--;
+    }
+
+    if (points->n_points < start + 3) {
+        points->n_points = start;
+        return true;
+    }
+
+    if (outlines->n_outlines + 2 > *starts_capacity) {
+        size_t capacity = *starts_capacity * 2;
+        size_t * new_starts =
+            realloc(outlines->starts, sizeof(*new_starts) * capacity);
+        if (!new_starts) {
+            return false;
+        }
+        outlines->starts = new_starts;
+        *starts_capacity = capacity;
+    }
+    outlines->starts[++outlines->n_outlines] = points->n_points;
+    return true;
+}
+
+/* the nonzero winding number of these outlines around (px, py) */
+static int32_t shape_winding(
+        const struct msdf_outlines * outlines, double px, double py)
+{
+    int32_t winding = 0;
+    const double * points = outlines->points.points;
+    for (size_t i = 0; i < outlines->n_outlines; i++) {
+        size_t first = outlines->starts[i],
+               last = outlines->starts[i + 1];
+        for (size_t j = first; j < last; j++) {
+            const double * a = &points[2 * j];
+            const double * b = &points[2 * (j + 1 < last ? j + 1 : first)];
+            if ((a[1] <= py) != (b[1] <= py)) {
+                double x = a[0] + (py - a[1]) * (b[0] - a[0]) / (b[1] - a[1]);
+                if (x > px) {
+                    winding += b[1] > a[1] ? 1 : -1;
+                }
+            }
+        }
+    }
+    return winding;
+}
+
+/* flatten this shape into outlines (in the coordinates of input texel
+ * centers for an input of this size) and put them in outlines_out
+ *
+ * each outline is turned, if need be, so that the inside of the shape is
+ * where cross(b - a, p - a) > 0 along its edges, as msdf_trace's are
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result shape_flatten(
+        const struct dfield_shape * shape,
+        int32_t input_width,
+        int32_t input_height,
+        struct msdf_outlines * outlines_out
+    )
+{
+    double x_scale = 1.0, y_scale = 1.0,
+           x_offset = -0.5, y_offset = -0.5;
+    if (shape->has_view_box) {
+        x_scale = input_width / shape->view_width;
+        y_scale = input_height / shape->view_height;
+        x_offset -= shape->view_x * x_scale;
+        y_offset -= shape->view_y * y_scale;
+    }
+
+    size_t starts_capacity = 16;
+    struct msdf_outlines outlines = {
+        .starts = malloc(sizeof(*outlines.starts) * starts_capacity)
+    };
+    if (!outlines.starts) {
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+    outlines.starts[0] = 0;
+
+    for (size_t i = 0; i < shape->n_segments; i++) {
+        const struct dfield_shape_segment * segment = &shape->segments[i];
+
+        double p[8];
+        for (int32_t j = 0; j <= segment->degree; j++) {
+            p[2 * j] = segment->points[2 * j] * x_scale + x_offset;
+            p[2 * j + 1] = segment->points[2 * j + 1] * y_scale + y_offset;
+        }
+
+        if (segment->starts_outline) {
+            if ((i > 0 && !shape_end_outline(&outlines, &starts_capacity)) ||
+                    !shape_add_point(&outlines, p[0], p[1])) {
+                msdf_outlines_free(&outlines);
+                return DFIELD_RESULT_ERROR_MEMORY;
+            }
+        }
+
+        /* enough lines to be within shape_flatness of the curve (Wang's
+         * formula)
+         */
+        int32_t n_lines = 1;
+        if (segment->degree > 1) {
+            double largest = 0.0;
+            for (int32_t j = 0; j + 2 <= segment->degree; j++) {
+                double dx = p[2 * j] - 2 * p[2 * j + 2] + p[2 * j + 4],
+                       dy = p[2 * j + 1] - 2 * p[2 * j + 3] + p[2 * j + 5];
+                largest = fmax(largest, hypot(dx, dy));
+            }
+            double factor = segment->degree == 2 ? 0.25 : 0.75;
+            double lines = ceil(sqrt(factor * largest / shape_flatness));
+            n_lines = lines < 1.0 ? 1 :
+                      lines > shape_max_curve_lines ? shape_max_curve_lines :
+                      (int32_t)lines;
+        }
+
+        for (int32_t k = 1; k <= n_lines; k++) {
+            double t = (double)k / n_lines,
+                   u = 1.0 - t;
+            double x, y;
+            switch (segment->degree) {
+                case 2:
+                    x = u * u * p[0] + 2 * u * t * p[2] + t * t * p[4];
+                    y = u * u * p[1] + 2 * u * t * p[3] + t * t * p[5];
+                    break;
+                case 3:
+                    x = u * u * u * p[0] + 3 * u * u * t * p[2] +
+                        3 * u * t * t * p[4] + t * t * t * p[6];
+                    y = u * u * u * p[1] + 3 * u * u * t * p[3] +
+                        3 * u * t * t * p[5] + t * t * t * p[7];
+                    break;
+                default:
+                    x = p[2];
+                    y = p[3];
+                    break;
+            }
+            if (!shape_add_point(&outlines, x, y)) {
+                msdf_outlines_free(&outlines);
+                return DFIELD_RESULT_ERROR_MEMORY;
+            }
+        }
+    }
+
+    if (shape->n_segments > 0 &&
+            !shape_end_outline(&outlines, &starts_capacity)) {
+        msdf_outlines_free(&outlines);
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+    /* check which side of its longest edge the inside of each outline is
+     * on, just off the middle of it
+     */
+    double * points = outlines.points.points;
+    for (size_t i = 0; i < outlines.n_outlines; i++) {
+        size_t first = outlines.starts[i],
+               last = outlines.starts[i + 1];
+        size_t longest = first;
+        double longest_length = 0.0;
+        for (size_t j = first; j < last; j++) {
+            const double * a = &points[2 * j];
+            const double * b = &points[2 * (j + 1 < last ? j + 1 : first)];
+            double length = hypot(b[0] - a[0], b[1] - a[1]);
+            if (length > longest_length) {
+                longest = j;
+                longest_length = length;
+            }
+        }
+
+        const double * a = &points[2 * longest];
+        const double * b =
+            &points[2 * (longest + 1 < last ? longest + 1 : first)];
+        constexpr double offset = 1.0 / 1024;
+        double px = (a[0] + b[0]) / 2 -
+                    (b[1] - a[1]) / longest_length * offset,
+               py = (a[1] + b[1]) / 2 +
+                    (b[0] - a[0]) / longest_length * offset;
+        if (shape_winding(&outlines, px, py) == 0) {
+            for (size_t j = first, k = last - 1; j < k; j++, k--) {
+                for (int c = 0; c < 2; c++) {
+                    double swap = points[2 * j + c];
+                    points[2 * j + c] = points[2 * k + c];
+                    points[2 * k + c] = swap;
+                }
+            }
+        }
+    }
+
+    *outlines_out = outlines;
+    return DFIELD_RESULT_OKAY;
+}
+
+/* a place where a row crosses an outline, for shape_inside */
+struct shape_crossing {
+    double x;
+    int32_t direction;
+};
+
+/* qsort comparison putting crossings in order of x */
+static int compare_crossings(const void * a, const void * b)
+{
+    const struct shape_crossing * crossing_a = a;
+    const struct shape_crossing * crossing_b = b;
+    return (crossing_a->x > crossing_b->x) - (crossing_a->x < crossing_b->x);
+}
+
+/* work out which texels of this output are inside these outlines (by the
+ * nonzero rule), as msdf_fill wants them
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result shape_inside(
+        const struct msdf_outlines * outlines,
+        int32_t input_width,
+        int32_t input_height,
+        const struct dfield_output * output,
+        bool * inside
+    )
+{
+    double y_scale = (double)input_height / output->height;
+    double x_scale = (double)input_width / output->width;
+
+    struct shape_crossing * crossings = malloc(
+            sizeof(*crossings) * (outlines->points.n_points + 1));
+    if (!crossings) {
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+    const double * points = outlines->points.points;
+    for (int32_t y = 0; y < output->height; y++) {
+        double py = y * y_scale;
+
+        size_t n_crossings = 0;
+        for (size_t i = 0; i < outlines->n_outlines; i++) {
+            size_t first = outlines->starts[i],
+                   last = outlines->starts[i + 1];
+            for (size_t j = first; j < last; j++) {
+                const double * a = &points[2 * j];
+                const double * b =
+                    &points[2 * (j + 1 < last ? j + 1 : first)];
+                if ((a[1] <= py) != (b[1] <= py)) {
+                    crossings[n_crossings++] = (struct shape_crossing) {
+                        .x = a[0] +
+                             (py - a[1]) * (b[0] - a[0]) / (b[1] - a[1]),
+                        .direction = b[1] > a[1] ? 1 : -1
+                    };
+                }
+            }
+        }
+        qsort(crossings, n_crossings, sizeof(*crossings), compare_crossings);
+
+        /* the crossings to the left wind the opposite way to those to the
+         * right, so either gives the winding number
+         */
+        int32_t winding = 0;
+        size_t k = 0;
+        for (int32_t x = 0; x < output->width; x++) {
+            double px = x * x_scale;
+            while (k < n_crossings && crossings[k].x <= px) {
+                winding += crossings[k++].direction;
+            }
+            inside[(size_t)y * output->width + x] = winding != 0;
+        }
+    }
+
+    free(crossings);
+    return DFIELD_RESULT_OKAY;
+}
+
+/* check that these outputs have valid sizes and spreads
+ *
+ * returns DFIELD_RESULT_OKAY (0) if they do, non-zero otherwise
+ */
+static enum dfield_result check_outputs(
+        size_t n_outputs, const struct dfield_output * outputs)
+{
+    for (size_t i = 0; i < n_outputs; i++) {
+        if (outputs[i].width <= 0 || outputs[i].height <= 0) {
+            return DFIELD_RESULT_ERROR_BAD_OUTPUT_SIZE;
+        }
+        /* 2 * spread * spread must fit in an int32_t
+         *
+         * (it shouldn't ever be close)
+         */
+        if (outputs[i].spread < 0 || outputs[i].spread > 32768) {
+            return DFIELD_RESULT_ERROR_BAD_SPREAD;
+        }
+    }
+    return DFIELD_RESULT_OKAY;
+}
+
+/* allocate a field in this format for each of these outputs, returning NULL
+ * if we ran out of memory
+ */
+static int8_t ** allocate_fields(
+        size_t n_outputs,
+        const struct dfield_output * outputs,
+        enum dfield_format format
+    )
+{
+    int8_t ** fields = calloc(n_outputs, sizeof(*fields));
+    if (!fields) {
+        return NULL;
+    }
+    for (size_t i = 0; i < n_outputs; i++) {
+        fields[i] = malloc((size_t)outputs[i].width * outputs[i].height *
+                           dfield_format_channels(format));
+        if (!fields[i]) {
+            for (size_t j = 0; j < i; j++) {
+                free(fields[j]);
+            }
+            free(fields);
+            return NULL;
+        }
+    }
+    return fields;
+}
+
+/* free the result of allocate_fields */
+static void free_fields(size_t n_outputs, int8_t ** fields)
+{
+    for (size_t i = 0; i < n_outputs; i++) {
+        free(fields[i]);
+    }
+    free(fields);
+}
+
+/* hand the fields from allocate_fields over to dfields_out (freeing the
+ * array that held them)
+ */
+static void fields_to_dfields(
+        size_t n_outputs,
+        const struct dfield_output * outputs,
+        enum dfield_format format,
+        int8_t ** fields,
+        struct dfield * dfields_out
+    )
+{
+    for (size_t i = 0; i < n_outputs; i++) {
+        dfields_out[i] = (struct dfield) {
+            .width = outputs[i].width,
+            .height = outputs[i].height,
+            .levels = 1,
+            .format = format,
+            .data = fields[i]
+        };
+    }
+    free(fields);
+}
+
+/* using this data (which should be boolean-like black and white data, with
+ * 0 treated as black and all other values treated as white) generate a
+ * distance field of this size with this spread value, using this algorithm,
+ * and put it in dfield_out
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+[[nodiscard]] enum dfield_result dfield_generate(
+        uint8_t * data,
+        int32_t input_width,
+        int32_t input_height,
+        int32_t output_width,
+        int32_t output_height,
+        int32_t spread,
+        enum dfield_algorithm algorithm,
+        struct dfield * dfield_out
+    ) [[gnu::nonnull(1)]]
+{
+    return dfield_generate_multiple(
+            data,
+            input_width,
+            input_height,
+            1,
+            &(struct dfield_output) {
+                .width = output_width,
+                .height = output_height,
+                .spread = spread
+            },
+            algorithm,
+            dfield_out
+        );
+}
+
+/* like dfield_generate, but generate a distance field for each of these
+ * n_outputs outputs (putting them in the corresponding entries of
+ * dfields_out) while only reading and preparing the input once
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error. on error,
+ * nothing is put in dfields_out
+ */
+[[nodiscard]] enum dfield_result dfield_generate_multiple(
+        uint8_t * data,
+        int32_t input_width,
+        int32_t input_height,
+        size_t n_outputs,
+        const struct dfield_output * outputs,
+        enum dfield_algorithm algorithm,
+        struct dfield * dfields_out
+    ) [[gnu::nonnull(1, 5, 7)]]
+{
+    if (input_width <= 0 || input_height <= 0) {
+        return DFIELD_RESULT_ERROR_BAD_INPUT_SIZE;
+    }
+    enum dfield_result result = check_outputs(n_outputs, outputs);
+    if (result) {
+        return result;
+    }
+    if (algorithm != DFIELD_ALGORITHM_BRUTE_FORCE &&
+            algorithm != DFIELD_ALGORITHM_BITPLANE &&
+            algorithm != DFIELD_ALGORITHM_EDT &&
+            algorithm != DFIELD_ALGORITHM_MSDF &&
+            algorithm != DFIELD_ALGORITHM_COVERAGE) {
+        return DFIELD_RESULT_ERROR_BAD_ALGORITHM;
+    }
+
+    enum dfield_format format = algorithm == DFIELD_ALGORITHM_MSDF ?
+        DFIELD_FORMAT_MSDF : DFIELD_FORMAT_SDF;
+
+    int8_t ** fields = allocate_fields(n_outputs, outputs, format);
+    if (!fields) {
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+    switch (algorithm) {
+        case DFIELD_ALGORITHM_BRUTE_FORCE:
+            for (size_t i = 0; i < n_outputs; i++) {
+                generate_brute_force(
+                        data,
+                        input_width,
+                        input_height,
+                        outputs[i].width,
+                        outputs[i].height,
+                        outputs[i].spread,
+                        fields[i]
+                    );
+            }
+            break;
+
+        case DFIELD_ALGORITHM_BITPLANE:
+            result = generate_bitplane(
+                    data,
+                    input_width,
+                    input_height,
+                    n_outputs,
+                    outputs,
+                    fields
+                );
+            break;
+
+        case DFIELD_ALGORITHM_EDT:
+            result = generate_edt(
+                    data,
+                    input_width,
+                    input_height,
+                    n_outputs,
+                    outputs,
+                    fields
+                );
+            break;
+
+        case DFIELD_ALGORITHM_MSDF:
+            result = generate_msdf(
+                    data,
+                    input_width,
+                    input_height,
+                    n_outputs,
+                    outputs,
+                    fields
+                );
+            break;
+
+        case DFIELD_ALGORITHM_COVERAGE:
+            result = generate_coverage(
+                    data,
+                    input_width,
+                    input_height,
+                    n_outputs,
+                    outputs,
+                    fields
+                );
+            break;
+    }
+
+    if (result) {
+        free_fields(n_outputs, fields);
+        return result;
+    }
+
+    fields_to_dfields(n_outputs, outputs, format, fields, dfields_out);
+
+    return DFIELD_RESULT_OKAY;
+}
+
+/* like dfield_generate_multiple (with DFIELD_ALGORITHM_BRUTE_FORCE, whose
+ * output this matches exactly) but streaming rows from this input instead of
+ * holding all of it in memory
+ *
+ * only the input rows within spread of the output rows being worked on are
+ * kept (packed as a bitplane), and the output is generated in square tiles
+ * of tile_size texels, each of which touches only a small part of that
+ * window
+ *
+ * the input is read from its current position to the end, and is not closed
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error. on error,
+ * nothing is put in dfields_out
+ */
+[[nodiscard]] enum dfield_result dfield_generate_tiled(
+        struct dfield_input * input,
+        size_t n_outputs,
+        const struct dfield_output * outputs,
+        int32_t tile_size,
+        struct dfield * dfields_out
+    ) [[gnu::nonnull(1, 3, 5)]]
+{
+    enum dfield_result result = check_outputs(n_outputs, outputs);
+    if (result) {
+        return result;
+    }
+    if (tile_size <= 0) {
+        return DFIELD_RESULT_ERROR_BAD_TILE_SIZE;
+    }
+
+    int32_t width = input->width;
+    int32_t height = input->height;
+
+    /* the window must hold the 2 * spread + 1 rows around any output row
+     * (that is always enough to make progress) plus enough for a band of
+     * tile_size output rows, so that there is a whole tile of work each time
+     * we stop to read
+     */
+    int32_t capacity = 1;
+    for (size_t i = 0; i < n_outputs; i++) {
+        double y_scale = (double)height / outputs[i].height;
+        int64_t need = 2 * (int64_t)outputs[i].spread + 2 +
+                       (int64_t)ceil(y_scale * (tile_size + 1));
+        if (need > height) {
+            need = height;
+        }
+        if (need > capacity) {
+            capacity = (int32_t)need;
+        }
+    }
+
+    int8_t ** fields =
+        allocate_fields(n_outputs, outputs, DFIELD_FORMAT_SDF);
+    int32_t * next_rows = calloc(n_outputs, sizeof(*next_rows));
+    uint8_t * row = malloc(width);
+    struct bitplane plane = { };
+    if (!fields || !next_rows || !row ||
+            bitplane_allocate(width, height, capacity, &plane)) {
+        if (fields) {
+            free_fields(n_outputs, fields);
+        }
+        free(next_rows);
+        free(row);
+        bitplane_free(&plane);
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+    bitplane_row_function row_function = bitplane_row_select();
+
+    /* invariant: plane.first_row + plane.rows == loaded */
+    int32_t loaded = 0;
+
+    for (;;) {
+        bool done = true;
+        bool progress = false;
+
+        /* generate every output row whose neighborhood is loaded */
+        for (size_t i = 0; i < n_outputs; i++) {
+            int32_t output_width = outputs[i].width;
+            int32_t output_height = outputs[i].height;
+            int32_t spread = outputs[i].spread;
+            double y_scale = (double)height / output_height;
+            double x_scale = (double)width / output_width;
+
+            int32_t begin = next_rows[i];
+            int32_t end = begin;
+            while (end < output_height) {
+                int32_t y_in = input_coordinate(end, y_scale, height);
+                int32_t last = y_in + spread < height - 1 ?
+                    y_in + spread : height - 1;
+                if (last >= loaded) {
+                    break;
+                }
+                end++;
+            }
+
+            int32_t n_bands = (end - begin + tile_size - 1) / tile_size;
+            int32_t n_tiles = (output_width + tile_size - 1) / tile_size;
+
+            #pragma omp parallel for collapse(2) schedule(dynamic)
+            for (int32_t band = 0; band < n_bands; band++) {
+                for (int32_t tile = 0; tile < n_tiles; tile++) {
+                    int32_t y_begin = begin + band * tile_size;
+                    int32_t y_end = y_begin + tile_size < end ?
+                        y_begin + tile_size : end;
+                    int32_t x_begin = tile * tile_size;
+                    int32_t x_end = x_begin + tile_size < output_width ?
+                        x_begin + tile_size : output_width;
+                    for (int32_t y = y_begin; y < y_end; y++) {
+                        row_function(
+                                &plane,
+                                y,
+                                x_begin,
+                                x_end,
+                                x_scale,
+                                y_scale,
+                                spread,
+                                &fields[i][(size_t)y * output_width]
+                            );
+                    }
+                }
+            }
+
+            if (end > begin) {
+                progress = true;
+            }
+            next_rows[i] = end;
+            if (end < output_height) {
+                done = false;
+            }
+        }
+
+        if (done) {
+            break;
+        }
+
+        /* forget the rows no remaining output row needs */
+        int32_t first_needed = loaded;
+        for (size_t i = 0; i < n_outputs; i++) {
+            if (next_rows[i] >= outputs[i].height) {
+                continue;
+            }
+            double y_scale = (double)height / outputs[i].height;
+            int32_t y_in = input_coordinate(next_rows[i], y_scale, height);
+            int32_t first = y_in - outputs[i].spread > 0 ?
+                y_in - outputs[i].spread : 0;
+            if (first < first_needed) {
+                first_needed = first;
+            }
+        }
+        bitplane_drop_rows(&plane, first_needed);
+
+        /* and read as many more as fit, skipping any nothing needs */
+        while (loaded < height && plane.rows < plane.capacity) {
+            if ((result = input_read_row(input, row))) {
+                break;
+            }
+            progress = true;
+            if (loaded < first_needed) {
+                loaded++;
+                plane.first_row = loaded;
+                continue;
+            }
+            bitplane_pack_row(
+                    row,
+                    width,
+                    plane.stride,
+                    &plane.on[plane.rows * plane.stride],
+                    &plane.off[plane.rows * plane.stride]
+                );
+            plane.rows++;
+            loaded++;
+        }
+
+        if (result) {
+            break;
+        }
+
+        /* the window always has room for the neighborhood of the lowest
+         * output row still to do, so this can't happen
+         */
+        assert(progress);
+    }
+
+    free(next_rows);
+    free(row);
+    bitplane_free(&plane);
+
+    if (result) {
+        free_fields(n_outputs, fields);
+        return result;
+    }
+
+    fields_to_dfields(
+            n_outputs, outputs, DFIELD_FORMAT_SDF, fields, dfields_out);
+
+    return DFIELD_RESULT_OKAY;
+}
+
+/* like dfield_generate_multiple, but generating the fields straight from
+ * the outlines of this shape, with its view box (if it has one) stretched
+ * over an input of this size
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error. on error,
+ * nothing is put in dfields_out
+ */
+[[nodiscard]] enum dfield_result dfield_generate_from_shape(
+        const struct dfield_shape * shape,
+        int32_t input_width,
+        int32_t input_height,
+        size_t n_outputs,
+        const struct dfield_output * outputs,
+        enum dfield_algorithm algorithm,
+        struct dfield * dfields_out
+    ) [[gnu::nonnull(1, 5, 7)]]
+{
+    if (input_width <= 0 || input_height <= 0) {
+        return DFIELD_RESULT_ERROR_BAD_INPUT_SIZE;
+    }
+    enum dfield_result result = check_outputs(n_outputs, outputs);
+    if (result) {
+        return result;
+    }
+    if (algorithm != DFIELD_ALGORITHM_BRUTE_FORCE &&
+            algorithm != DFIELD_ALGORITHM_BITPLANE &&
+            algorithm != DFIELD_ALGORITHM_EDT &&
+            algorithm != DFIELD_ALGORITHM_MSDF &&
+            algorithm != DFIELD_ALGORITHM_COVERAGE) {
+        return DFIELD_RESULT_ERROR_BAD_ALGORITHM;
+    }
 
-    #pragma omp parallel for
-    for (int32_t y = 0; y < output_height; y++) {
-        for (int32_t x = 0; x < output_width; x++) {
-            int32_t x_in = (int32_t)lrint(x * x_scale);
-            int32_t y_in = (int32_t)lrint(y * y_scale);
-            bool state = data[y_in * input_width + x_in] != 0;
+    enum dfield_format format = algorithm == DFIELD_ALGORITHM_MSDF ?
+        DFIELD_FORMAT_MSDF : DFIELD_FORMAT_SDF;
 
-            int32_t minimum = INT32_MAX;
-            for (int32_t i = -spread; i <= spread; i++) {
-                int32_t y_in2 = y_in + i;
-                if (y_in2 < 0) {
-                    continue;
-                }
-                if (y_in2 >= input_height) {
-                    break;
-                }
-                for (int32_t j = -spread; j <= spread; j++) {
-                    int32_t x_in2 = x_in + j;
-                    if (x_in2 < 0) {
-                        continue;
-                    }
-                    if (x_in2 >= input_width) {
-                        break;
-                    }
-                    bool state2 = data[y_in2 * input_width + x_in2] != 0;
-                    if (state2 != state) {
-                        int32_t dsq = i * i + j * j;
-                        if (dsq < minimum) {
-                            minimum = dsq;
-                        }
+    int8_t ** fields = allocate_fields(n_outputs, outputs, format);
+    if (!fields) {
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+    struct msdf_outlines outlines;
+    if ((result = shape_flatten(
+                    shape, input_width, input_height, &outlines))) {
+        free_fields(n_outputs, fields);
+        return result;
+    }
+
+    /* the flattened curves are already as accurate as we want, so only
+     * points that add nothing are simplified away
+     */
+    struct msdf_edges edges = { };
+    result = msdf_color_outlines(&outlines, 0.0, &edges);
+
+    for (size_t i = 0; i < n_outputs && !result; i++) {
+        bool * inside = malloc(
+                sizeof(*inside) * outputs[i].width * outputs[i].height);
+        if (!inside) {
+            result = DFIELD_RESULT_ERROR_MEMORY;
+            break;
+        }
+        result = shape_inside(
+                &outlines, input_width, input_height, &outputs[i], inside);
+        if (!result) {
+            result = msdf_fill(
+                    &edges,
+                    input_width,
+                    input_height,
+                    &outputs[i],
+                    format,
+                    inside,
+                    true,
+                    fields[i]
+                );
+        }
+        free(inside);
+    }
+
+    free(edges.edges);
+    msdf_outlines_free(&outlines);
+
+    if (result) {
+        free_fields(n_outputs, fields);
+        return result;
+    }
+
+    fields_to_dfields(n_outputs, outputs, format, fields, dfields_out);
+
+    return DFIELD_RESULT_OKAY;
+}
+
+/* combine these n_levels single-level dfields, each half the size of the last
+ * (rounding down, to a minimum of 1), into one dfield with that many levels
+ * and put it in dfield_out
+ *
+ * the dfields passed in are not modified or freed
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result dfield_combine_levels(
+        const struct dfield * levels,
+        int32_t n_levels,
+        struct dfield * dfield_out
+    ) [[gnu::nonnull(1, 3)]]
+{
+    if (n_levels <= 0 ||
+            n_levels > max_levels(levels[0].width, levels[0].height)) {
+        return DFIELD_RESULT_ERROR_BAD_LEVELS;
+    }
+
+    struct dfield combined = {
+        .width = levels[0].width,
+        .height = levels[0].height,
+        .levels = n_levels,
+        .format = levels[0].format
+    };
+
+    for (int32_t level = 0; level < n_levels; level++) {
+        if (levels[level].format != combined.format) {
+            return DFIELD_RESULT_ERROR_BAD_FORMAT;
+        }
+        if (levels[level].levels != 1 ||
+                levels[level].width !=
+                    dfield_level_width(combined.width, level) ||
+                levels[level].height !=
+                    dfield_level_width(combined.height, level)) {
+            return DFIELD_RESULT_ERROR_BAD_LEVELS;
+        }
+    }
+
+    combined.data = malloc(dfield_data_size(&combined));
+    if (!combined.data) {
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+    size_t offset = 0;
+    for (int32_t level = 0; level < n_levels; level++) {
+        size_t size = dfield_level_size(&combined, level);
+        memcpy(&combined.data[offset], levels[level].data, size);
+        offset += size;
+    }
+
+    *dfield_out = combined;
+
+    return DFIELD_RESULT_OKAY;
+}
+
+/* put the eight values these BC4 SNORM endpoints stand for in palette, in the
+ * order of the indices that pick them
+ *
+ * endpoints of -128 mean -1.0, the same as -127, so they are taken as -127
+ */
+static void bc4_palette(int8_t red0, int8_t red1, int8_t palette[8])
+{
+    int32_t r0 = red0 < -127 ? -127 : red0;
+    int32_t r1 = red1 < -127 ? -127 : red1;
+    palette[0] = (int8_t)r0;
+    palette[1] = (int8_t)r1;
+    if (red0 > red1) {
+        for (int32_t i = 1; i < 7; i++) {
+            int32_t sum = (7 - i) * r0 + i * r1;
+            palette[i + 1] = (int8_t)((sum + (sum < 0 ? -3 : 3)) / 7);
+        }
+    } else {
+        for (int32_t i = 1; i < 5; i++) {
+            int32_t sum = (5 - i) * r0 + i * r1;
+            palette[i + 1] = (int8_t)((sum + (sum < 0 ? -2 : 2)) / 5);
+        }
+        palette[6] = -127;
+        palette[7] = 127;
+    }
+}
+
+/* pick the palette entry closest to each of these sixteen values, putting
+ * their indices in indices_out, and return the total squared error
+ */
+static int32_t bc4_fit(
+        const int8_t values[16],
+        const int8_t palette[8],
+        uint64_t * indices_out
+    )
+{
+    uint64_t indices = 0;
+    int32_t error = 0;
+    for (int32_t i = 0; i < 16; i++) {
+        int32_t best = 0, best_error = INT32_MAX;
+        for (int32_t j = 0; j < 8; j++) {
+            int32_t difference = values[i] - palette[j];
+            if (difference * difference < best_error) {
+                best = j;
+                best_error = difference * difference;
+            }
+        }
+        indices |= (uint64_t)best << (3 * i);
+        error += best_error;
+    }
+    *indices_out = indices;
+    return error;
+}
+
+/* BC4 SNORM encode these sixteen values (a block, in rows) into block
+ *
+ * two palettes are tried: eight steps between the lowest and highest value,
+ * and six steps between the lowest and highest value that isn't -1.0 or 1.0
+ * plus those two, which fits the blocks of a field that are partly past its
+ * spread much better. the one with the lower error is kept
+ */
+static void bc4_encode_block(const int8_t values[16], uint8_t * block)
+{
+    int8_t low = 127, high = -127,
+           inner_low = 127, inner_high = -127;
+    for (int32_t i = 0; i < 16; i++) {
+        int8_t value = values[i] < -127 ? -127 : values[i];
+        low = value < low ? value : low;
+        high = value > high ? value : high;
+        if (value > -127 && value < 127) {
+            inner_low = value < inner_low ? value : inner_low;
+            inner_high = value > inner_high ? value : inner_high;
+        }
+    }
+    if (inner_low > inner_high) {
+        inner_low = inner_high = 0;
+    }
+
+    int8_t red0 = high, red1 = low, palette[8];
+    uint64_t indices;
+    bc4_palette(red0, red1, palette);
+    int32_t error = bc4_fit(values, palette, &indices);
+
+    if (error > 0) {
+        uint64_t inner_indices;
+        bc4_palette(inner_low, inner_high, palette);
+        if (bc4_fit(values, palette, &inner_indices) < error) {
+            red0 = inner_low;
+            red1 = inner_high;
+            indices = inner_indices;
+        }
+    }
+
+    block[0] = (uint8_t)red0;
+    block[1] = (uint8_t)red1;
+    for (size_t i = 0; i < 6; i++) {
+        block[2 + i] = (uint8_t)(indices >> (8 * i));
+    }
+}
+
+/* BC4 SNORM decode this block into the sixteen values (in rows) it stands
+ * for
+ */
+static void bc4_decode_block(const uint8_t * block, int8_t values[16])
+{
+    int8_t palette[8];
+    bc4_palette((int8_t)block[0], (int8_t)block[1], palette);
+    uint64_t indices = 0;
+    for (size_t i = 0; i < 6; i++) {
+        indices |= (uint64_t)block[2 + i] << (8 * i);
+    }
+    for (int32_t i = 0; i < 16; i++) {
+        values[i] = palette[(indices >> (3 * i)) & 7];
+    }
+}
+
+/* block compress this DFIELD_FORMAT_SDF dfield (every level of it) into a new
+ * DFIELD_FORMAT_BC4 dfield of the same size, and put it in dfield_out
+ *
+ * blocks that hang over the edge of a level are filled out by repeating its
+ * last row and column
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result dfield_encode_bc4(
+        const struct dfield * dfield,
+        struct dfield * dfield_out
+    ) [[gnu::nonnull(1, 2)]]
+{
+    if (dfield->format != DFIELD_FORMAT_SDF) {
+        return DFIELD_RESULT_ERROR_BAD_FORMAT;
+    }
+
+    struct dfield encoded = {
+        .width = dfield->width,
+        .height = dfield->height,
+        .levels = dfield->levels,
+        .format = DFIELD_FORMAT_BC4
+    };
+    encoded.data = malloc(dfield_data_size(&encoded));
+    if (!encoded.data) {
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+    size_t in_offset = 0, out_offset = 0;
+    for (int32_t level = 0; level < dfield->levels; level++) {
+        int32_t width = dfield_level_width(dfield->width, level);
+        int32_t height = dfield_level_width(dfield->height, level);
+        int32_t rows = level_rows(&encoded, level);
+        size_t stride = level_stride(&encoded, level);
+        const int8_t * in = &dfield->data[in_offset];
+        uint8_t * out = (uint8_t *)&encoded.data[out_offset];
+
+        #pragma omp parallel for schedule(static) if (rows > 16)
+        for (int32_t by = 0; by < rows; by++) {
+            for (int32_t bx = 0; (size_t)bx * bc4_block_size < stride; bx++) {
+                int8_t values[16];
+                for (int32_t y = 0; y < 4; y++) {
+                    int32_t iy = by * 4 + y < height ? by * 4 + y : height - 1;
+                    for (int32_t x = 0; x < 4; x++) {
+                        int32_t ix = bx * 4 + x < width ? bx * 4 + x : width - 1;
+                        values[y * 4 + x] = in[(size_t)iy * width + ix];
                     }
                 }
+                bc4_encode_block(
+                        values,
+                        &out[(size_t)by * stride + (size_t)bx * bc4_block_size]
+                    );
             }
+        }
 
-            double minimum_g = sqrt(minimum);
+        in_offset += dfield_level_size(dfield, level);
+        out_offset += dfield_level_size(&encoded, level);
+    }
 
-            if (state) {
-                minimum_g = -minimum_g;
-            }
+    *dfield_out = encoded;
+    return DFIELD_RESULT_OKAY;
+}
 
-            minimum_g = minimum_g / spread / M_SQRT2 * 128;
+/* decompress this DFIELD_FORMAT_BC4 dfield (every level of it) into a new
+ * DFIELD_FORMAT_SDF dfield, and put it in dfield_out
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result dfield_decode_bc4(
+        const struct dfield * dfield,
+        struct dfield * dfield_out
+    ) [[gnu::nonnull(1, 2)]]
+{
+    if (dfield->format != DFIELD_FORMAT_BC4) {
+        return DFIELD_RESULT_ERROR_BAD_FORMAT;
+    }
 
-            int32_t result = (int32_t)lrint(minimum_g);
-            if (result > 127) {
-                result = 127;
-            }
-            if (result < -127) {
-                result = -127;
+    struct dfield decoded = {
+        .width = dfield->width,
+        .height = dfield->height,
+        .levels = dfield->levels,
+        .format = DFIELD_FORMAT_SDF
+    };
+    decoded.data = malloc(dfield_data_size(&decoded));
+    if (!decoded.data) {
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+    size_t in_offset = 0, out_offset = 0;
+    for (int32_t level = 0; level < dfield->levels; level++) {
+        int32_t width = dfield_level_width(dfield->width, level);
+        int32_t height = dfield_level_width(dfield->height, level);
+        int32_t rows = level_rows(dfield, level);
+        size_t stride = level_stride(dfield, level);
+        const uint8_t * in = (const uint8_t *)&dfield->data[in_offset];
+        int8_t * out = &decoded.data[out_offset];
+
+        #pragma omp parallel for schedule(static) if (rows > 16)
+        for (int32_t by = 0; by < rows; by++) {
+            for (int32_t bx = 0; (size_t)bx * bc4_block_size < stride; bx++) {
+                int8_t values[16];
+                bc4_decode_block(
+                        &in[(size_t)by * stride + (size_t)bx * bc4_block_size],
+                        values
+                    );
+                for (int32_t y = 0; y < 4 && by * 4 + y < height; y++) {
+                    for (int32_t x = 0; x < 4 && bx * 4 + x < width; x++) {
+                        out[(size_t)(by * 4 + y) * width + bx * 4 + x] =
+                            values[y * 4 + x];
+                    }
+                }
             }
+        }
 
-            field[y * output_width + x] = (int8_t)result;
+        in_offset += dfield_level_size(dfield, level);
+        out_offset += dfield_level_size(&decoded, level);
+    }
+
+    *dfield_out = decoded;
+    return DFIELD_RESULT_OKAY;
+}
+
+/* an open pack */
+struct dfield_pack {
+    uint8_t * data; /* the whole file */
+    size_t size;
+    bool mapped; /* whether data is mapped (or else malloc'd) */
+    size_t n_dfields;
+    struct pack_entry {
+        char * name;
+        struct dfield dfield;
+    } * entries;
+};
+
+/* write these n_dfields dfields to a pack file at this path, under these
+ * names
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result dfield_pack_write(
+        const char * path,
+        size_t n_dfields,
+        const char * const * names,
+        const struct dfield * dfields
+    ) [[gnu::nonnull(1)]]
+{
+    if (n_dfields > UINT32_MAX) {
+        return DFIELD_RESULT_ERROR_BAD_PACK;
+    }
+
+    /* work out where everything goes */
+    size_t directory_size =
+        sizeof(magic_pack) + sizeof(pack_version) + sizeof(uint32_t);
+    for (size_t i = 0; i < n_dfields; i++) {
+        size_t name_length = strlen(names[i]);
+        if (name_length > UINT16_MAX) {
+            return DFIELD_RESULT_ERROR_BAD_PACK;
         }
+        directory_size += 2 * sizeof(uint64_t) + 3 * sizeof(int32_t) +
+                          sizeof(uint8_t) + sizeof(uint16_t) + name_length;
     }
 
-    *dfield_out = (struct dfield) {
-        .width = output_width,
-        .height = output_height,
-        .data = field
-    };
+    uint8_t * padding = calloc(pack_alignment, 1);
+    if (!padding) {
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+    FILE * pack_file = fopen(path, "wb");
+    if (!pack_file) {
+        free(padding);
+        return DFIELD_RESULT_ERROR_ERRNO;
+    }
+
+    uint32_t n = (uint32_t)n_dfields;
+    size_t expected = sizeof(magic_pack) + sizeof(pack_version) + sizeof(n);
+    size_t rd = fwrite(magic_pack, 1, sizeof(magic_pack), pack_file);
+    rd += fwrite(&pack_version, 1, sizeof(pack_version), pack_file);
+    rd += fwrite(&n, 1, sizeof(n), pack_file);
+
+    uint64_t offset = directory_size;
+    for (size_t i = 0; i < n_dfields; i++) {
+        const struct dfield * dfield = &dfields[i];
+        offset = (offset + pack_alignment - 1) / pack_alignment *
+                 pack_alignment;
+        uint64_t size = dfield_data_size(dfield);
+        uint8_t format = (uint8_t)dfield->format;
+        uint16_t name_length = (uint16_t)strlen(names[i]);
+
+        rd += fwrite(&offset, 1, sizeof(offset), pack_file);
+        rd += fwrite(&size, 1, sizeof(size), pack_file);
+        rd += fwrite(&dfield->width, 1, sizeof(dfield->width), pack_file);
+        rd += fwrite(&dfield->height, 1, sizeof(dfield->height), pack_file);
+        rd += fwrite(&dfield->levels, 1, sizeof(dfield->levels), pack_file);
+        rd += fwrite(&format, 1, sizeof(format), pack_file);
+        rd += fwrite(&name_length, 1, sizeof(name_length), pack_file);
+        rd += fwrite(names[i], 1, name_length, pack_file);
+        expected += sizeof(offset) + sizeof(size) + sizeof(dfield->width) +
+                    sizeof(dfield->height) + sizeof(dfield->levels) +
+                    sizeof(format) + sizeof(name_length) + name_length;
+
+        offset += size;
+    }
+
+    /* then the data, padded out to where the directory says it is */
+    offset = directory_size;
+    for (size_t i = 0; i < n_dfields; i++) {
+        size_t pad = (pack_alignment - offset % pack_alignment) %
+                     pack_alignment;
+        size_t size = dfield_data_size(&dfields[i]);
+        rd += fwrite(padding, 1, pad, pack_file);
+        rd += fwrite(dfields[i].data, 1, size, pack_file);
+        expected += pad + size;
+        offset += pad + size;
+    }
+    free(padding);
+
+    if (fclose(pack_file)) {
+        return DFIELD_RESULT_ERROR_ERRNO;
+    }
+    if (rd != expected) {
+        return DFIELD_RESULT_ERROR_WRITE_SIZE;
+    }
+
+    return DFIELD_RESULT_OKAY;
+}
+
+/* read a value of this size from the directory of a pack, advancing position,
+ * or return false if the directory ends first
+ */
+static bool pack_read(
+        const struct dfield_pack * pack,
+        size_t * position,
+        void * value,
+        size_t size
+    )
+{
+    if (size > pack->size - *position) {
+        return false;
+    }
+    memcpy(value, &pack->data[*position], size);
+    *position += size;
+    return true;
+}
+
+/* read the directory of this pack (whose data and size are set)
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result pack_read_directory(struct dfield_pack * pack)
+{
+    char magic_in[sizeof(magic_pack)];
+    uint8_t version;
+    uint32_t n;
+    size_t position = 0;
+    if (!pack_read(pack, &position, magic_in, sizeof(magic_in)) ||
+            !pack_read(pack, &position, &version, sizeof(version)) ||
+            !pack_read(pack, &position, &n, sizeof(n))) {
+        return DFIELD_RESULT_ERROR_READ_SIZE;
+    }
+    if (memcmp(magic_in, magic_pack, sizeof(magic_pack))) {
+        return DFIELD_RESULT_ERROR_MAGIC;
+    }
+    if (version != pack_version) {
+        return DFIELD_RESULT_ERROR_VERSION;
+    }
+
+    /* each directory entry takes at least this much room */
+    constexpr size_t min_entry_size = 2 * sizeof(uint64_t) +
+        3 * sizeof(int32_t) + sizeof(uint8_t) + sizeof(uint16_t);
+    if (n > (pack->size - position) / min_entry_size) {
+        return DFIELD_RESULT_ERROR_BAD_PACK;
+    }
+
+    pack->entries = calloc(n ? n : 1, sizeof(*pack->entries));
+    if (!pack->entries) {
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+        uint64_t offset, size;
+        int32_t width, height, levels;
+        uint8_t format;
+        uint16_t name_length;
+        if (!pack_read(pack, &position, &offset, sizeof(offset)) ||
+                !pack_read(pack, &position, &size, sizeof(size)) ||
+                !pack_read(pack, &position, &width, sizeof(width)) ||
+                !pack_read(pack, &position, &height, sizeof(height)) ||
+                !pack_read(pack, &position, &levels, sizeof(levels)) ||
+                !pack_read(pack, &position, &format, sizeof(format)) ||
+                !pack_read(
+                    pack, &position, &name_length, sizeof(name_length))) {
+            return DFIELD_RESULT_ERROR_BAD_PACK;
+        }
+
+        if (width <= 0 || height <= 0) {
+            return DFIELD_RESULT_ERROR_BAD_SIZE;
+        }
+        if (levels <= 0 || levels > max_levels(width, height)) {
+            return DFIELD_RESULT_ERROR_BAD_LEVELS;
+        }
+        if (format != DFIELD_FORMAT_SDF && format != DFIELD_FORMAT_MSDF &&
+                format != DFIELD_FORMAT_BC4) {
+            return DFIELD_RESULT_ERROR_BAD_FORMAT;
+        }
+
+        struct dfield dfield = {
+            .width = width,
+            .height = height,
+            .levels = levels,
+            .format = (enum dfield_format)format
+        };
+        if (size != dfield_data_size(&dfield) || offset > pack->size ||
+                size > pack->size - offset) {
+            return DFIELD_RESULT_ERROR_BAD_PACK;
+        }
+        dfield.data = (int8_t *)&pack->data[offset];
+
+        char * name = malloc((size_t)name_length + 1);
+        if (!name) {
+            return DFIELD_RESULT_ERROR_MEMORY;
+        }
+        if (!pack_read(pack, &position, name, name_length)) {
+            free(name);
+            return DFIELD_RESULT_ERROR_BAD_PACK;
+        }
+        name[name_length] = '\0';
+
+        pack->entries[pack->n_dfields++] = (struct pack_entry) {
+            .name = name,
+            .dfield = dfield
+        };
+    }
+
+    return DFIELD_RESULT_OKAY;
+}
+
+/* open the pack at this path and put it in pack_out
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result dfield_pack_open(
+        const char * path,
+        struct dfield_pack ** pack_out
+    ) [[gnu::nonnull(1, 2)]]
+{
+    struct dfield_pack * pack = calloc(1, sizeof(*pack));
+    if (!pack) {
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        free(pack);
+        return DFIELD_RESULT_ERROR_ERRNO;
+    }
+    struct stat st;
+    if (fstat(fd, &st)) {
+        close(fd);
+        free(pack);
+        return DFIELD_RESULT_ERROR_ERRNO;
+    }
+    pack->size = (size_t)st.st_size;
+    if (pack->size > 0) {
+        void * map =
+            mmap(NULL, pack->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            close(fd);
+            free(pack);
+            return DFIELD_RESULT_ERROR_ERRNO;
+        }
+        pack->data = map;
+        pack->mapped = true;
+    }
+    close(fd);
+#else
+    FILE * pack_file = fopen(path, "rb");
+    if (!pack_file) {
+        free(pack);
+        return DFIELD_RESULT_ERROR_ERRNO;
+    }
+    enum dfield_result read_result =
+        read_rest(pack_file, &pack->data, &pack->size);
+    fclose(pack_file);
+    if (read_result) {
+        free(pack);
+        return read_result;
+    }
+#endif /* _WIN32 */
+
+    enum dfield_result result = pack_read_directory(pack);
+    if (result) {
+        dfield_pack_close(pack);
+        return result;
+    }
 
+    *pack_out = pack;
     return DFIELD_RESULT_OKAY;
 }
 
+/* the number of dfields in this pack */
+size_t dfield_pack_count(
+        const struct dfield_pack * pack) [[gnu::nonnull(1)]]
+{
+    return pack->n_dfields;
+}
+
+/* the name of the dfield at this index of this pack */
+const char * dfield_pack_name(
+        const struct dfield_pack * pack, size_t index) [[gnu::nonnull(1)]]
+{
+    assert(index < pack->n_dfields);
+    return pack->entries[index].name;
+}
+
+/* look up the dfield with this name in this pack and put it in dfield_out
+ *
+ * returns true on success, false if there is no dfield with this name
+ */
+bool dfield_pack_find(
+        const struct dfield_pack * pack,
+        const char * name,
+        struct dfield * dfield_out
+    ) [[gnu::nonnull(1, 2, 3)]]
+{
+    for (size_t i = 0; i < pack->n_dfields; i++) {
+        if (!strcmp(pack->entries[i].name, name)) {
+            *dfield_out = pack->entries[i].dfield;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* close a pack, invalidating the dfields found in it */
+void dfield_pack_close(struct dfield_pack * pack)
+{
+    if (!pack) {
+        return;
+    }
+    if (pack->entries) {
+        for (size_t i = 0; i < pack->n_dfields; i++) {
+            free(pack->entries[i].name);
+        }
+        free(pack->entries);
+    }
+#ifndef _WIN32
+    if (pack->mapped) {
+        munmap(pack->data, pack->size);
+    }
+#else
+    free(pack->data);
+#endif /* _WIN32 */
+    free(pack);
+}
+
 /* free the data associated with a dfield
  *
  * this is equivalent to free(dfield->data)
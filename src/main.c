@@ -21,7 +21,45 @@
 
 #include "renderer/renderer.h"
 
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* is this environment variable set to something other than "" or "0"? */
+static bool environment_flag(const char * name)
+{
+    const char * value = getenv(name);
+    return value && *value && strcmp(value, "0");
+}
+
+/* the number in this environment variable, or 0 if it isn't set or isn't a
+ * number from 0 to UINT32_MAX (which is warned about)
+ */
+static uint32_t environment_count(const char * name)
+{
+    const char * value = getenv(name);
+    if (!value || !*value) {
+        return 0;
+    }
+
+    /* strtoul would take a minus sign and wrap the number around */
+    char * end;
+    errno = 0;
+    unsigned long n = strtoul(value, &end, 10);
+    if (*end || errno || strchr(value, '-') || n > UINT32_MAX) {
+        fprintf(
+                stderr,
+                "[engine] (WARNING) ignoring %s=%s (not a count)\n",
+                name,
+                value
+            );
+        return 0;
+    }
+    return (uint32_t)n;
+}
 
 int main(int argc, char ** argv)
 {
@@ -38,7 +76,13 @@ int main(int argc, char ** argv)
                     .sample_shading = true,
                     .msaa_samples = 2,
                     .width = 1920,
-                    .height = 1080
+                    .height = 1080,
+                    .texture_pack = getenv("SNRKOS_TEXTURE_PACK"),
+                    .cpu_culling = environment_flag("SNRKOS_CPU_CULLING"),
+                    .record_threads =
+                        environment_count("SNRKOS_RECORD_THREADS"),
+                    .frame_statistics =
+                        environment_flag("SNRKOS_FRAME_STATISTICS")
                 }
             );
     
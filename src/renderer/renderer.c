@@ -50,6 +50,41 @@
 #include <stdbool.h>
 
 #include <time.h>
+#include <omp.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif /* defined(__x86_64__) || defined(__i386__) */
+
+/* the bounding sphere of each object for CPU culling, as a structure of
+ * arrays padded to a multiple of 8. the radius is -INFINITY for objects that
+ * are disabled (and for the padding) so that they are always culled
+ */
+struct cull_spheres {
+    float * x,
+          * y,
+          * z,
+          * r;
+    size_t n; /* the padded length of the arrays */
+    uint64_t synced; /* the first scene generation whose changes haven't been
+                      * written here
+                      */
+};
+
+/* a function that writes the index of each of these spheres from first up
+ * to (but not including) last that is on the inside of all of these
+ * (normalized) planes to visible, returning how many there were (see
+ * cull_spheres_select())
+ *
+ * first must be a multiple of 8
+ */
+typedef size_t (*cull_spheres_function)(
+        const struct cull_spheres * spheres,
+        size_t first,
+        size_t last,
+        const float planes[4][4],
+        uint32_t * visible
+    );
 
 /* the big global stucture that holds the renderer's state */
 struct renderer {
@@ -86,6 +121,8 @@ struct renderer {
 
     bool anisotropy;
     bool sample_shading;
+    bool texture_compression_bc; /* can textures be VK_FORMAT_BC4_SNORM_BLOCK?
+                                  */
 
     VkDevice device; /* the logical device, created by setup_logical_device()
                       */
@@ -135,21 +172,73 @@ struct renderer {
     VkPipelineLayout layout;
     VkPipeline pipeline;
 
+    VkPipelineLayout cull_layout; /* these two are the compute pipeline
+                                   * that culls the objects, created by
+                                   * setup_cull_pipeline()
+                                   */
+    VkPipeline cull_pipeline;
+
     VkCommandPool command_pool,
                   transient_command_pool; /* these three created by
                                            * setup_command_pool()
                                            */
     VkCommandBuffer * command_buffers; /* indexed by current_frame */
 
+    uint32_t record_threads; /* how many threads record draws (see
+                              * struct renderer_configuration)
+                              */
+    VkCommandPool * record_pools; /* these two indexed by current_frame *
+                                   * record_threads + thread: a pool for each
+                                   * thread with one secondary command buffer
+                                   */
+    VkCommandBuffer * secondary_command_buffers;
+
     VkBuffer vertex_buffer; /* the vertex buffer */
     VkDeviceMemory vertex_buffer_memory;
 
     VkBuffer index_buffer;
     VkDeviceMemory index_buffer_memory;
 
-    VkBuffer * storage_buffers; /* these three indexed by current_frame */
+    VkBuffer * storage_buffers; /* these four indexed by current_frame */
     VkDeviceMemory * storage_buffer_memories;
     void ** storage_buffers_mapped;
+    uint64_t * storage_buffers_synced; /* the first scene generation whose
+                                        * changes haven't been written to
+                                        * this buffer (0 until it has been
+                                        * written in full)
+                                        */
+    size_t storage_bytes_written; /* how much object data has been written
+                                   * to the storage buffers since it was
+                                   * last reported
+                                   */
+
+    uint32_t batch_size; /* how many objects each indirect draw covers:
+                          * batch_objects, or all of them if the device
+                          * doesn't support drawIndirectFirstInstance
+                          */
+    struct draw_buffer_object * draws; /* the draws as they start each
+                                        * frame, before culling
+                                        */
+
+    /* the indices of the objects that survive culling, and the indirect
+     * draws of them (see cull.glsl). these four indexed by current_frame
+     */
+    VkBuffer * visible_buffers;
+    VkDeviceMemory * visible_buffer_memories;
+    VkBuffer * draw_buffers;
+    VkDeviceMemory * draw_buffer_memories;
+
+    bool cpu_culling; /* cull with cull_spheres instead of cull.glsl (see
+                       * struct renderer_configuration), in which case the
+                       * visible and draw buffers are mapped here
+                       */
+    void ** visible_buffers_mapped;
+    void ** draw_buffers_mapped;
+    struct cull_spheres spheres; /* for CPU culling */
+    cull_spheres_function cull_spheres; /* from cull_spheres_select() */
+    double cull_seconds; /* how long CPU culling has taken since it was last
+                          * reported
+                          */
 
     VkBuffer * uniform_buffers; /* these three indexed by current_frame */
     VkDeviceMemory * uniform_buffer_memories;
@@ -175,8 +264,16 @@ struct renderer {
     VkImageView texture_view; /* the texture array and related data */
     VkSampler texture_sampler;
     size_t texture_max;
+    uint32_t texture_levels; /* the number of mip levels of the texture array
+                              */
     VkImage texture;
     VkDeviceMemory texture_memory;
+    VkFormat texture_format; /* VK_FORMAT_R8_SNORM, or
+                              * VK_FORMAT_R8G8B8A8_SNORM if any of the
+                              * textures are multi-channel, or
+                              * VK_FORMAT_BC4_SNORM_BLOCK if all of them are
+                              * block compressed and that's supported
+                              */
 
     /*
     VkBufferView oit_abuffer_view;
@@ -187,7 +284,7 @@ struct renderer {
     VkImage oit_aux;
     */
 
-    size_t sbo_size; /* the padded size of a storage_buffer_object */
+    size_t sbo_size; /* the stride of the storage_buffer_objects */
     size_t ubo_size; /* the padded size of a uniform_buffer_object */
 
     size_t n_objects; /* the maximum number of objects supported */
@@ -247,14 +344,46 @@ uint16_t indices[] = {
     0, 1, 2, 2, 3, 0
 };
 
+/* one instance, as vertex.glsl reads it: the quad is scaled, then rotated,
+ * then moved to position
+ */
 struct storage_buffer_object {
-    struct matrix model;
-    uint32_t solid_index,
+    float position[3];
+    float scale;
+    int16_t rotation[4]; /* a unit quaternion (x, y, z, w) as snorm16 */
+    uint16_t solid_index,
              outline_index,
              glow_index;
-    uint32_t flags;
+    uint16_t flags; /* 1 if enabled, 2 if it glows */
+};
+
+/* std140 lays out struct object in vertex.glsl and cull.glsl as a vec4 at
+ * 0, two uvec2s at 16 and 24, and an array stride of 32, which doesn't
+ * depend on the device, so this has to match it exactly
+ */
+static_assert(offsetof(struct storage_buffer_object, rotation) == 16);
+static_assert(offsetof(struct storage_buffer_object, solid_index) == 24);
+static_assert(offsetof(struct storage_buffer_object, glow_index) == 28);
+static_assert(sizeof(struct storage_buffer_object) == 32);
+
+/* the indirect draws that cull.glsl fills in, one for each batch of
+ * batch_size objects, after how many objects it should look at
+ *
+ * each batch's visible indices start at its first object's index, which
+ * is the draw's firstInstance
+ */
+struct draw_buffer_object {
+    uint32_t n_objects;
+    uint32_t batch_size;
+    VkDrawIndexedIndirectCommand commands[];
 };
 
+/* how many objects go in each batch, when batches are supported. each batch
+ * is recorded on its own, so this is how finely the draws can be split
+ * across threads
+ */
+constexpr uint32_t batch_objects = 4096;
+
 struct uniform_buffer_object {
     float ambient_light;
     float padding[15];
@@ -291,6 +420,12 @@ static enum renderer_result record_command_buffer(
         VkCommandBuffer command_buffer,
         uint32_t image_index
     );
+static enum renderer_result record_draws(
+        uint32_t thread,
+        uint32_t image_index,
+        uint32_t first_batch,
+        uint32_t last_batch
+    );
 
 /*
  * INITIALIZATION FUNCTIONS
@@ -306,6 +441,7 @@ static enum renderer_result setup_image_views();
 //static enum renderer_result setup_oit_buffers();
 static enum renderer_result setup_descriptor_set_layout();
 static enum renderer_result setup_pipeline();
+static enum renderer_result setup_cull_pipeline();
 static enum renderer_result setup_framebuffers();
 static enum renderer_result setup_command_pool();
 static enum renderer_result setup_depth_image();
@@ -329,6 +465,7 @@ static enum renderer_result setup_swap_chain_details(
         VkPhysicalDevice candidate);
 static enum renderer_result find_memory_type(
         uint32_t filter, VkMemoryPropertyFlags properties, uint32_t * out);
+static bool host_cached_supported(VkBufferUsageFlags usage);
 
 static enum renderer_result setup_vertex_buffer();
 static enum renderer_result setup_index_buffer();
@@ -356,6 +493,7 @@ static enum renderer_result create_image(
         uint32_t width,
         uint32_t height,
         uint32_t layers,
+        uint32_t mip_levels,
         VkSampleCountFlagBits samples,
         VkFormat format,
         VkImageTiling tiling,
@@ -367,15 +505,27 @@ static enum renderer_result transition_image_layout(
         VkFormat format,
         VkImageLayout old_layout,
         VkImageLayout new_layout,
-        uint32_t layers
+        uint32_t layers,
+        uint32_t mip_levels
     );
 static enum renderer_result copy_buffer_to_image(
         VkBuffer buffer,
+        VkImage image,
+        uint32_t n_regions,
+        const VkBufferImageCopy * regions
+    );
+static enum renderer_result generate_mipmaps(
         VkImage image,
         uint32_t width,
         uint32_t height,
-        uint32_t layers
+        uint32_t layers,
+        uint32_t mip_levels
     );
+static size_t draw_buffer_size(uint32_t n_batches);
+static uint32_t draws_reset();
+static void pack_object(
+        struct storage_buffer_object * sbo, const struct object * object);
+static cull_spheres_function cull_spheres_select();
 
 static VkSampleCountFlagBits get_msaa_samples()
 {
@@ -787,8 +937,10 @@ static enum renderer_result setup_queue_families(
             candidate, &n_queue_families, queue_families);
 
     for (size_t i = 0; i < n_queue_families; i++) {
+        /* the graphics queue also runs the cull pass (see cull.glsl) */
         if (!renderer.queue_families.graphics.exists) {
-            if (queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+            VkQueueFlags flags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+            if ((queue_families[i].queueFlags & flags) == flags) {
                 renderer.queue_families.graphics.index = i;
                 renderer.queue_families.graphics.exists = true;
             }
@@ -1183,6 +1335,13 @@ static enum renderer_result setup_physical_device()
     renderer.physical_device = candidate;
     renderer.limits = device_properties.limits;
 
+    renderer.cpu_culling = renderer.config.cpu_culling ||
+        device_properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU;
+    if (renderer.cpu_culling) {
+        renderer.cull_spheres = cull_spheres_select();
+        fprintf(stderr, "[renderer] (INFO) culling on the CPU\n");
+    }
+
     return RENDERER_OKAY;
 }
 
@@ -1222,6 +1381,32 @@ static enum renderer_result setup_logical_device()
         renderer.sample_shading = true;
     }
 
+    if (features.drawIndirectFirstInstance) {
+        renderer.batch_size = batch_objects;
+    } else {
+        fprintf(
+                stderr,
+                "[renderer] (INFO) drawIndirectFirstInstance unsupported, drawing in one batch\n"
+            );
+        renderer.batch_size = (uint32_t)renderer.n_objects;
+    }
+
+    VkFormatProperties bc4_properties;
+    vkGetPhysicalDeviceFormatProperties(
+            renderer.physical_device,
+            VK_FORMAT_BC4_SNORM_BLOCK,
+            &bc4_properties
+        );
+    if (features.textureCompressionBC &&
+            (bc4_properties.optimalTilingFeatures &
+             VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
+        fprintf(
+                stderr,
+                "[renderer] (INFO) enabling BC texture compression\n"
+            );
+        renderer.texture_compression_bc = true;
+    }
+
     VkDeviceCreateInfo device_create_info = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
         .pQueueCreateInfos = queue_create_info,
@@ -1230,6 +1415,10 @@ static enum renderer_result setup_logical_device()
         .pEnabledFeatures = &(VkPhysicalDeviceFeatures){
             .samplerAnisotropy = renderer.anisotropy ? VK_TRUE : VK_FALSE,
             .sampleRateShading = renderer.sample_shading ? VK_TRUE : VK_FALSE,
+            .textureCompressionBC =
+                renderer.texture_compression_bc ? VK_TRUE : VK_FALSE,
+            .drawIndirectFirstInstance =
+                features.drawIndirectFirstInstance,
         },
         .enabledExtensionCount = sizeof(extensions) / sizeof(*extensions),
         .ppEnabledExtensionNames = extensions,
@@ -1440,13 +1629,14 @@ static enum renderer_result setup_descriptor_set_layout()
 {
     VkDescriptorSetLayoutCreateInfo layout_info = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-        .bindingCount = 3,
+        .bindingCount = 5,
         .pBindings = (VkDescriptorSetLayoutBinding[]) {
             {
                 .binding = 0,
                 .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
                 .descriptorCount = 1,
-                .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+                .stageFlags =
+                    VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT,
                 .pImmutableSamplers = NULL
             },
             {
@@ -1462,6 +1652,21 @@ static enum renderer_result setup_descriptor_set_layout()
                 .descriptorCount = 1,
                 .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
                 .pImmutableSamplers = NULL
+            },
+            {
+                .binding = 3,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags =
+                    VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT,
+                .pImmutableSamplers = NULL
+            },
+            {
+                .binding = 4,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .pImmutableSamplers = NULL
             }
         }
     };
@@ -1705,8 +1910,12 @@ static enum renderer_result setup_pipeline()
 
     struct fragment_specialization {
         uint32_t n_lights;
+        VkBool32 multi_channel;
     } fragment_specialization = {
-        .n_lights = N_LIGHTS
+        .n_lights = N_LIGHTS,
+        .multi_channel =
+            renderer.texture_format == VK_FORMAT_R8G8B8A8_SNORM ?
+                VK_TRUE : VK_FALSE
     };
 
     VkGraphicsPipelineCreateInfo pipeline_info = {
@@ -1725,13 +1934,21 @@ static enum renderer_result setup_pipeline()
                 .pName = "main",
                 .module = fragment_module,
                 .pSpecializationInfo = &(VkSpecializationInfo) {
-                    .mapEntryCount = 1,
+                    .mapEntryCount = 2,
                     .pMapEntries = (VkSpecializationMapEntry[]) {
                         {
                             .constantID = 0,
                             .offset = offsetof(
                                     struct fragment_specialization, n_lights),
                             .size = sizeof(fragment_specialization.n_lights)
+                        },
+                        {
+                            .constantID = 1,
+                            .offset = offsetof(
+                                    struct fragment_specialization,
+                                    multi_channel),
+                            .size = sizeof(
+                                    fragment_specialization.multi_channel)
                         }
                     },
                     .dataSize = sizeof(fragment_specialization),
@@ -1892,6 +2109,122 @@ static enum renderer_result setup_pipeline()
     return RENDERER_OKAY;
 }
 
+/* create the compute pipeline that culls the objects (see cull.glsl) */
+static enum renderer_result setup_cull_pipeline()
+{
+    char * shader_blob = NULL;
+    size_t shader_blob_size;
+
+    if (load_file(
+                "cull.spv",
+                SHADER_BASE_PATH,
+                &shader_blob,
+                &shader_blob_size)) {
+        fprintf(
+                stderr,
+                "[renderer] loading shaders failed\n"
+            );
+        if (shader_blob) {
+            free(shader_blob);
+        }
+        renderer_terminate();
+        return RENDERER_ERROR;
+    }
+
+    VkShaderModule module;
+
+    VkResult result = vkCreateShaderModule(
+            renderer.device,
+            &(VkShaderModuleCreateInfo) {
+                .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+                .codeSize = shader_blob_size,
+                .pCode = (const uint32_t *)shader_blob
+            },
+            NULL,
+            &module
+        );
+
+    free(shader_blob);
+
+    if (result != VK_SUCCESS) {
+        fprintf(
+                stderr,
+                "[renderer] vkCreateShaderModule() failed (%d) for cull shader\n",
+                result
+            );
+        renderer_terminate();
+        return RENDERER_ERROR;
+    }
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = (VkDescriptorSetLayout[]) {
+            renderer.descriptor_set_layout
+        },
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = (VkPushConstantRange[]) {
+            {
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .offset = 0,
+                .size = sizeof(renderer.push_constants)
+            }
+        }
+    };
+
+    result = vkCreatePipelineLayout(
+            renderer.device,
+            &pipeline_layout_info,
+            NULL,
+            &renderer.cull_layout
+        );
+
+    if (result != VK_SUCCESS) {
+        fprintf(
+                stderr,
+                "[renderer] vkCreatePipelineLayout() failed (%d)\n",
+                result
+            );
+        vkDestroyShaderModule(renderer.device, module, NULL);
+        renderer_terminate();
+        return RENDERER_ERROR;
+    }
+
+    VkComputePipelineCreateInfo pipeline_info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = module,
+            .pName = "main"
+        },
+        .layout = renderer.cull_layout
+    };
+
+    result = vkCreateComputePipelines(
+            renderer.device,
+            VK_NULL_HANDLE,
+            1,
+            &pipeline_info,
+            NULL,
+            &renderer.cull_pipeline
+        );
+
+    vkDestroyShaderModule(renderer.device, module, NULL);
+
+    if (result != VK_SUCCESS) {
+        fprintf(
+                stderr,
+                "[renderer] vkCreateComputePipelines() failed (%d)\n",
+                result
+            );
+        renderer_terminate();
+        return RENDERER_ERROR;
+    }
+
+    return RENDERER_OKAY;
+}
+
 /* create the framebuffers */
 static enum renderer_result setup_framebuffers()
 {
@@ -1954,6 +2287,42 @@ static enum renderer_result find_memory_type(
     return RENDERER_ERROR;
 }
 
+/* can buffers with this usage be put in memory that is host cached (and so
+ * fast to read back from, unlike the write-combined memory that is usually
+ * all that is host coherent)?
+ */
+static bool host_cached_supported(VkBufferUsageFlags usage)
+{
+    /* buffers with the same usage all accept the same memory types, so a
+     * small one stands in for whatever is created later
+     */
+    VkBufferCreateInfo buffer_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = 1,
+        .usage = usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE
+    };
+
+    VkBuffer buffer;
+    if (vkCreateBuffer(renderer.device, &buffer_info, NULL, &buffer) !=
+            VK_SUCCESS) {
+        return false;
+    }
+
+    VkMemoryRequirements memory_requirements;
+    vkGetBufferMemoryRequirements(
+            renderer.device, buffer, &memory_requirements);
+    vkDestroyBuffer(renderer.device, buffer, NULL);
+
+    uint32_t memory_type;
+    return !find_memory_type(
+            memory_requirements.memoryTypeBits,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+            &memory_type
+        );
+}
+
 /* create a VkBuffer and a VkDeviceMemory */
 static enum renderer_result create_buffer(
         VkBuffer * buffer,
@@ -2124,6 +2493,55 @@ static enum renderer_result setup_uniform_buffers()
             renderer.config.max_frames_in_flight,
             sizeof(*renderer.storage_buffers_mapped)
         );
+    renderer.storage_buffers_synced = calloc(
+            renderer.config.max_frames_in_flight,
+            sizeof(*renderer.storage_buffers_synced)
+        );
+
+    renderer.visible_buffers = calloc(
+            renderer.config.max_frames_in_flight,
+            sizeof(*renderer.visible_buffers)
+        );
+    renderer.visible_buffer_memories = calloc(
+            renderer.config.max_frames_in_flight,
+            sizeof(*renderer.visible_buffer_memories)
+        );
+    renderer.draw_buffers = calloc(
+            renderer.config.max_frames_in_flight,
+            sizeof(*renderer.draw_buffers)
+        );
+    renderer.draw_buffer_memories = calloc(
+            renderer.config.max_frames_in_flight,
+            sizeof(*renderer.draw_buffer_memories)
+        );
+    renderer.visible_buffers_mapped = calloc(
+            renderer.config.max_frames_in_flight,
+            sizeof(*renderer.visible_buffers_mapped)
+        );
+    renderer.draw_buffers_mapped = calloc(
+            renderer.config.max_frames_in_flight,
+            sizeof(*renderer.draw_buffers_mapped)
+        );
+
+    /* when culling on the CPU, these are written from here instead of by
+     * cull.glsl
+     */
+    VkMemoryPropertyFlags cull_properties = renderer.cpu_culling ?
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT :
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    /* enough batches for the most objects a scene can have */
+    size_t draw_size = draw_buffer_size(
+            (uint32_t)((renderer.n_objects + renderer.batch_size - 1) /
+                renderer.batch_size)
+        );
+    renderer.draws = malloc(draw_size);
+    if (!renderer.draws) {
+        fprintf(stderr, "[renderer] out of memory\n");
+        renderer_terminate();
+        return RENDERER_ERROR;
+    }
 
     renderer.uniform_buffers = calloc(
             renderer.config.max_frames_in_flight,
@@ -2138,13 +2556,10 @@ static enum renderer_result setup_uniform_buffers()
             sizeof(*renderer.uniform_buffers_mapped)
         );
 
-    uint32_t multiple = 16;
-    uint32_t base_size = sizeof(struct storage_buffer_object);
-    if (base_size % multiple != 0) {
-        renderer.sbo_size = base_size + (multiple - base_size % multiple);
-    } else {
-        renderer.sbo_size = base_size;
-    }
+    /* the std140 array stride, which is exactly the struct's size (see the
+     * static_asserts after it), so it isn't rounded here
+     */
+    renderer.sbo_size = sizeof(struct storage_buffer_object);
 
     fprintf(
             stderr,
@@ -2222,6 +2637,48 @@ static enum renderer_result setup_uniform_buffers()
                 &renderer.uniform_buffers_mapped[i]
             );
 
+        if (create_buffer(
+                &renderer.visible_buffers[i],
+                &renderer.visible_buffer_memories[i],
+                sizeof(uint32_t) * renderer.n_objects,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                cull_properties
+            )) {
+            return RENDERER_ERROR;
+        }
+
+        if (create_buffer(
+                &renderer.draw_buffers[i],
+                &renderer.draw_buffer_memories[i],
+                draw_size,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                cull_properties
+            )) {
+            return RENDERER_ERROR;
+        }
+
+        if (renderer.cpu_culling) {
+            vkMapMemory(
+                    renderer.device,
+                    renderer.visible_buffer_memories[i],
+                    0,
+                    sizeof(uint32_t) * renderer.n_objects,
+                    0,
+                    &renderer.visible_buffers_mapped[i]
+                );
+
+            vkMapMemory(
+                    renderer.device,
+                    renderer.draw_buffer_memories[i],
+                    0,
+                    draw_size,
+                    0,
+                    &renderer.draw_buffers_mapped[i]
+                );
+        }
+
     }
 
     return RENDERER_OKAY;
@@ -2287,6 +2744,7 @@ static enum renderer_result setup_depth_image()
                 renderer.chain_details.extent.width,
                 renderer.chain_details.extent.height,
                 1,
+                1,
                 get_msaa_samples(),
                 VK_FORMAT_D32_SFLOAT,
                 VK_IMAGE_TILING_OPTIMAL,
@@ -2303,6 +2761,7 @@ static enum renderer_result setup_depth_image()
                 renderer.chain_details.extent.width,
                 renderer.chain_details.extent.height,
                 1,
+                1,
                 get_msaa_samples(),
                 renderer.chain_details.format.format,
                 VK_IMAGE_TILING_OPTIMAL,
@@ -2393,6 +2852,85 @@ static enum renderer_result setup_command_pool()
         return RENDERER_ERROR;
     }
 
+    /* each recording thread gets a pool of its own for each frame, since a
+     * pool can only be used from one thread at a time
+     */
+    /* more threads than OpenMP would use would only take turns */
+    uint32_t max_threads = (uint32_t)omp_get_max_threads();
+    renderer.record_threads = renderer.config.record_threads;
+    if (renderer.record_threads == 0 ||
+            renderer.record_threads > max_threads) {
+        renderer.record_threads = max_threads;
+    }
+
+    fprintf(
+            stderr,
+            "[renderer] (INFO) recording draws on %u threads\n",
+            renderer.record_threads
+        );
+
+    size_t n_record_pools =
+        (size_t)renderer.record_threads * renderer.config.max_frames_in_flight;
+
+    renderer.record_pools = calloc(
+            n_record_pools, sizeof(*renderer.record_pools));
+    renderer.secondary_command_buffers = calloc(
+            n_record_pools, sizeof(*renderer.secondary_command_buffers));
+
+    if (!renderer.record_pools || !renderer.secondary_command_buffers) {
+        fprintf(stderr, "[renderer] out of memory\n");
+        renderer_terminate();
+        return RENDERER_ERROR;
+    }
+
+    VkCommandPoolCreateInfo record_pool_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = renderer.queue_families.graphics.index
+    };
+
+    for (size_t i = 0; i < n_record_pools; i++) {
+        result = vkCreateCommandPool(
+                renderer.device,
+                &record_pool_info,
+                NULL,
+                &renderer.record_pools[i]
+            );
+
+        if (result != VK_SUCCESS) {
+            fprintf(
+                    stderr,
+                    "[renderer] vkCreateCommandPool() failed (%d)\n",
+                    result
+                );
+            renderer_terminate();
+            return RENDERER_ERROR;
+        }
+
+        VkCommandBufferAllocateInfo secondary_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = renderer.record_pools[i],
+            .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+            .commandBufferCount = 1
+        };
+
+        result = vkAllocateCommandBuffers(
+                renderer.device,
+                &secondary_info,
+                &renderer.secondary_command_buffers[i]
+            );
+
+        if (result != VK_SUCCESS) {
+            fprintf(
+                    stderr,
+                    "[renderer] vkAllocateCommandBuffers() failed (%d)\n",
+                    result
+                );
+            renderer_terminate();
+            return RENDERER_ERROR;
+        }
+    }
+
     return RENDERER_OKAY;
 }
 
@@ -2404,7 +2942,7 @@ static enum renderer_result setup_descriptor_pool()
         .pPoolSizes = (VkDescriptorPoolSize[]) {
             {
                 .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-                .descriptorCount = renderer.config.max_frames_in_flight
+                .descriptorCount = 3 * renderer.config.max_frames_in_flight
             },
             {
                 .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
@@ -2482,6 +3020,18 @@ static enum renderer_result setup_descriptor_sets()
             .range = renderer.ubo_size
         };
 
+        VkDescriptorBufferInfo visible_buffer_info = {
+            .buffer = renderer.visible_buffers[i],
+            .offset = 0,
+            .range = sizeof(uint32_t) * renderer.n_objects
+        };
+
+        VkDescriptorBufferInfo draw_buffer_info = {
+            .buffer = renderer.draw_buffers[i],
+            .offset = 0,
+            .range = VK_WHOLE_SIZE
+        };
+
         VkWriteDescriptorSet descriptor_writes[] = {
             {
                 .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
@@ -2519,11 +3069,33 @@ static enum renderer_result setup_descriptor_sets()
                 .pBufferInfo = &uniform_buffer_info,
                 .pImageInfo = NULL,
                 .pTexelBufferView = NULL
-            }
-        };
+            },
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = renderer.descriptor_sets[i],
+                .dstBinding = 3,
+                .dstArrayElement = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .pBufferInfo = &visible_buffer_info,
+                .pImageInfo = NULL,
+                .pTexelBufferView = NULL
+            },
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = renderer.descriptor_sets[i],
+                .dstBinding = 4,
+                .dstArrayElement = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .pBufferInfo = &draw_buffer_info,
+                .pImageInfo = NULL,
+                .pTexelBufferView = NULL
+            }
+        };
 
         vkUpdateDescriptorSets(
-                renderer.device, 3, descriptor_writes, 0, NULL);
+                renderer.device, 5, descriptor_writes, 0, NULL);
     }
 
     return RENDERER_OKAY;
@@ -2583,6 +3155,37 @@ static enum renderer_result setup_sync_objects()
     return RENDERER_OKAY;
 }
 
+/* the size of a draw_buffer_object with this many batches */
+static size_t draw_buffer_size(uint32_t n_batches)
+{
+    return sizeof(struct draw_buffer_object) +
+        sizeof(VkDrawIndexedIndirectCommand) * n_batches;
+}
+
+/* set renderer.draws to draw nothing from each batch of the scene's
+ * objects, returning how many batches there are
+ */
+static uint32_t draws_reset()
+{
+    uint32_t n_objects = (uint32_t)renderer.scene.n_objects;
+    uint32_t n_batches =
+        (n_objects + renderer.batch_size - 1) / renderer.batch_size;
+
+    renderer.draws->n_objects = n_objects;
+    renderer.draws->batch_size = renderer.batch_size;
+    for (uint32_t batch = 0; batch < n_batches; batch++) {
+        renderer.draws->commands[batch] = (VkDrawIndexedIndirectCommand) {
+            .indexCount = (uint32_t)(sizeof(indices) / sizeof(*indices)),
+            .instanceCount = 0,
+            .firstIndex = 0,
+            .vertexOffset = 0,
+            .firstInstance = batch * renderer.batch_size
+        };
+    }
+
+    return n_batches;
+}
+
 /* record commands into a command buffer */
 static enum renderer_result record_command_buffer(
         VkCommandBuffer command_buffer,
@@ -2604,6 +3207,90 @@ static enum renderer_result record_command_buffer(
         return RENDERER_ERROR;
     }
 
+    /* cull: reset the draws, then have cull.glsl fill them in with the
+     * objects that are enabled and in view (unless update_uniform_buffer
+     * does that)
+     */
+    uint32_t n_batches = draws_reset();
+
+    if (!renderer.cpu_culling) {
+        vkCmdUpdateBuffer(
+                command_buffer,
+                renderer.draw_buffers[renderer.current_frame],
+                0,
+                draw_buffer_size(n_batches),
+                renderer.draws
+            );
+
+        vkCmdPipelineBarrier(
+                command_buffer,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0,
+                1,
+                &(VkMemoryBarrier) {
+                    .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                    .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                    .dstAccessMask =
+                        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+                },
+                0,
+                NULL,
+                0,
+                NULL
+            );
+
+        vkCmdBindPipeline(
+                command_buffer,
+                VK_PIPELINE_BIND_POINT_COMPUTE,
+                renderer.cull_pipeline
+            );
+
+        vkCmdBindDescriptorSets(
+                command_buffer,
+                VK_PIPELINE_BIND_POINT_COMPUTE,
+                renderer.cull_layout,
+                0,
+                1,
+                &renderer.descriptor_sets[renderer.current_frame],
+                0,
+                NULL
+            );
+
+        vkCmdPushConstants(
+                command_buffer,
+                renderer.cull_layout,
+                VK_SHADER_STAGE_COMPUTE_BIT,
+                0,
+                sizeof(renderer.push_constants),
+                &renderer.push_constants
+            );
+
+        /* cull.glsl has a local size of 64 */
+        vkCmdDispatch(
+                command_buffer, (renderer.draws->n_objects + 63) / 64, 1, 1);
+
+        vkCmdPipelineBarrier(
+                command_buffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                0,
+                1,
+                &(VkMemoryBarrier) {
+                    .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                    .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                    .dstAccessMask =
+                        VK_ACCESS_INDIRECT_COMMAND_READ_BIT |
+                        VK_ACCESS_SHADER_READ_BIT
+                },
+                0,
+                NULL,
+                0,
+                NULL
+            );
+    }
+
     VkRenderPassBeginInfo render_pass_begin_info = {
         .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
         .renderPass = renderer.render_pass,
@@ -2626,9 +3313,108 @@ static enum renderer_result record_command_buffer(
     vkCmdBeginRenderPass(
             command_buffer,
             &render_pass_begin_info,
-            VK_SUBPASS_CONTENTS_INLINE
+            VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+        );
+
+    /* split the batches between the threads, each recording its share into
+     * its own secondary command buffer, and then run those in order
+     */
+    uint32_t n_threads = renderer.record_threads;
+    if (n_threads > n_batches) {
+        n_threads = n_batches > 0 ? n_batches : 1;
+    }
+
+    int failed = 0;
+#pragma omp parallel for num_threads(n_threads) reduction(|:failed)
+    for (uint32_t thread = 0; thread < n_threads; thread++) {
+        failed |= record_draws(
+                thread,
+                image_index,
+                thread * n_batches / n_threads,
+                (thread + 1) * n_batches / n_threads
+            ) != RENDERER_OKAY;
+    }
+
+    if (failed) {
+        vkCmdEndRenderPass(command_buffer);
+        vkEndCommandBuffer(command_buffer);
+        return RENDERER_ERROR;
+    }
+
+    vkCmdExecuteCommands(
+            command_buffer,
+            n_threads,
+            &renderer.secondary_command_buffers[
+                renderer.current_frame * renderer.record_threads
+            ]
         );
 
+    vkCmdEndRenderPass(command_buffer);
+
+
+    result = vkEndCommandBuffer(command_buffer);
+
+    if (result != VK_SUCCESS) {
+        return RENDERER_ERROR;
+    }
+
+    return RENDERER_OKAY;
+}
+
+/* record the draws of batches first_batch up to (but not including)
+ * last_batch into this thread's secondary command buffer for the current
+ * frame, to be run inside the render pass on framebuffers[image_index]
+ *
+ * called from several threads at once by record_command_buffer, so this
+ * only touches the thread's own command pool and buffer
+ */
+static enum renderer_result record_draws(
+        uint32_t thread,
+        uint32_t image_index,
+        uint32_t first_batch,
+        uint32_t last_batch
+    )
+{
+    size_t index = renderer.current_frame * renderer.record_threads + thread;
+    VkCommandBuffer command_buffer =
+        renderer.secondary_command_buffers[index];
+
+    /* this frame's fence was waited on, so the last recording is done */
+    VkResult result = vkResetCommandPool(
+            renderer.device, renderer.record_pools[index], 0);
+
+    if (result != VK_SUCCESS) {
+        fprintf(
+                stderr,
+                "[renderer] vkResetCommandPool() failed (%d)\n",
+                result
+            );
+        return RENDERER_ERROR;
+    }
+
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT |
+                 VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = &(VkCommandBufferInheritanceInfo) {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+            .renderPass = renderer.render_pass,
+            .subpass = 0,
+            .framebuffer = renderer.framebuffers[image_index]
+        }
+    };
+
+    result = vkBeginCommandBuffer(command_buffer, &begin_info);
+
+    if (result != VK_SUCCESS) {
+        fprintf(
+                stderr,
+                "[renderer] vkBeginCommandBuffer() failed (%d)\n",
+                result
+            );
+        return RENDERER_ERROR;
+    }
+
     vkCmdBindPipeline(
             command_buffer,
             VK_PIPELINE_BIND_POINT_GRAPHICS,
@@ -2698,17 +3484,16 @@ static enum renderer_result record_command_buffer(
             &renderer.push_constants
         );
 
-    vkCmdDrawIndexed(
-            command_buffer,
-            (uint32_t)(sizeof(indices) / sizeof(*indices)),
-            renderer.scene.n_objects,
-            0,
-            0,
-            0
-        );
-
-    vkCmdEndRenderPass(command_buffer);
-
+    for (uint32_t batch = first_batch; batch < last_batch; batch++) {
+        vkCmdDrawIndexedIndirect(
+                command_buffer,
+                renderer.draw_buffers[renderer.current_frame],
+                offsetof(struct draw_buffer_object, commands) +
+                    sizeof(VkDrawIndexedIndirectCommand) * batch,
+                1,
+                sizeof(VkDrawIndexedIndirectCommand)
+            );
+    }
 
     result = vkEndCommandBuffer(command_buffer);
 
@@ -2719,9 +3504,335 @@ static enum renderer_result record_command_buffer(
     return RENDERER_OKAY;
 }
 
+/* rotate v by the unit quaternion q, putting the result in out */
+static void rotate_vector(
+        float out[3], const struct quaternion * q, const float v[3])
+{
+    /* v + 2w(u x v) + 2u x (u x v), where u is the vector part of q */
+    float t[3] = {
+        2.0f * (q->y * v[2] - q->z * v[1]),
+        2.0f * (q->z * v[0] - q->x * v[2]),
+        2.0f * (q->x * v[1] - q->y * v[0])
+    };
+    out[0] = v[0] + q->w * t[0] + q->y * t[2] - q->z * t[1];
+    out[1] = v[1] + q->w * t[1] + q->z * t[0] - q->x * t[2];
+    out[2] = v[2] + q->w * t[2] + q->x * t[1] - q->y * t[0];
+}
+
+/* fill in sbo for this object
+ *
+ * both kinds of object come down to scale, then rotate, then translate: an
+ * ordinary object is rotated around (cx, cy, cz) before it is scaled and
+ * moved to (x, y, z), and rain is scaled and moved to (x, y, z) before it is
+ * rotated around the origin, so the difference is folded into position
+ */
+static void pack_object(
+        struct storage_buffer_object * sbo, const struct object * object)
+{
+    struct quaternion q = object->rotation;
+    float length = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+    if (length > 0.0f) {
+        q.x /= length;
+        q.y /= length;
+        q.z /= length;
+        q.w /= length;
+    } else {
+        q = (struct quaternion) { .w = 1.0f };
+    }
+
+    float offset[3];
+    if (object->rain) {
+        rotate_vector(
+                offset, &q, (float[]){ object->x, object->y, object->z });
+        sbo->position[0] = offset[0];
+        sbo->position[1] = offset[1];
+        sbo->position[2] = offset[2];
+    } else {
+        rotate_vector(
+                offset, &q, (float[]){ object->cx, object->cy, object->cz });
+        sbo->position[0] = object->x + object->scale * offset[0];
+        sbo->position[1] = object->y + object->scale * offset[1];
+        sbo->position[2] = object->z + object->scale * offset[2];
+    }
+    sbo->scale = object->scale;
+
+    sbo->rotation[0] = (int16_t)lrintf(q.x * 32767.0f);
+    sbo->rotation[1] = (int16_t)lrintf(q.y * 32767.0f);
+    sbo->rotation[2] = (int16_t)lrintf(q.z * 32767.0f);
+    sbo->rotation[3] = (int16_t)lrintf(q.w * 32767.0f);
+
+    sbo->solid_index = (uint16_t)object->solid_index;
+    sbo->outline_index = (uint16_t)object->outline_index;
+    sbo->glow_index = (uint16_t)object->glow_index;
+    sbo->flags = 0;
+    sbo->flags |= object->enabled ? 1 : 0;
+    sbo->flags |= object->glows ? 2 : 0;
+}
+
+/* the cull_spheres_function for CPUs without SSE2 */
+static size_t cull_spheres_scalar(
+        const struct cull_spheres * spheres,
+        size_t first,
+        size_t last,
+        const float planes[4][4],
+        uint32_t * visible
+    )
+{
+    size_t n_visible = 0;
+    for (size_t i = first; i < last; i++) {
+        bool inside = true;
+        for (size_t p = 0; p < 4; p++) {
+            float distance = planes[p][0] * spheres->x[i] +
+                             planes[p][1] * spheres->y[i] +
+                             planes[p][2] * spheres->z[i] +
+                             planes[p][3];
+            inside = inside && distance >= -spheres->r[i];
+        }
+        if (inside) {
+            visible[n_visible++] = (uint32_t)i;
+        }
+    }
+    return n_visible;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/* cull_spheres_scalar, four spheres at a time */
+[[gnu::target("sse2")]] static size_t cull_spheres_sse2(
+        const struct cull_spheres * spheres,
+        size_t first,
+        size_t last,
+        const float planes[4][4],
+        uint32_t * visible
+    )
+{
+    __m128 a[4], b[4], c[4], d[4];
+    for (size_t p = 0; p < 4; p++) {
+        a[p] = _mm_set1_ps(planes[p][0]);
+        b[p] = _mm_set1_ps(planes[p][1]);
+        c[p] = _mm_set1_ps(planes[p][2]);
+        d[p] = _mm_set1_ps(planes[p][3]);
+    }
+
+    size_t n_visible = 0;
+    for (size_t i = first; i < last; i += 4) {
+        __m128 x = _mm_load_ps(&spheres->x[i]);
+        __m128 y = _mm_load_ps(&spheres->y[i]);
+        __m128 z = _mm_load_ps(&spheres->z[i]);
+        __m128 r = _mm_sub_ps(_mm_setzero_ps(), _mm_load_ps(&spheres->r[i]));
+        __m128 inside = _mm_cmpeq_ps(r, r);
+        for (size_t p = 0; p < 4; p++) {
+            __m128 distance = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(a[p], x), _mm_mul_ps(b[p], y)),
+                    _mm_add_ps(_mm_mul_ps(c[p], z), d[p])
+                );
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, r));
+        }
+        for (int mask = _mm_movemask_ps(inside); mask; mask &= mask - 1) {
+            visible[n_visible++] = (uint32_t)(i + __builtin_ctz(mask));
+        }
+    }
+    return n_visible;
+}
+
+/* cull_spheres_scalar, eight spheres at a time */
+[[gnu::target("avx")]] static size_t cull_spheres_avx(
+        const struct cull_spheres * spheres,
+        size_t first,
+        size_t last,
+        const float planes[4][4],
+        uint32_t * visible
+    )
+{
+    __m256 a[4], b[4], c[4], d[4];
+    for (size_t p = 0; p < 4; p++) {
+        a[p] = _mm256_set1_ps(planes[p][0]);
+        b[p] = _mm256_set1_ps(planes[p][1]);
+        c[p] = _mm256_set1_ps(planes[p][2]);
+        d[p] = _mm256_set1_ps(planes[p][3]);
+    }
+
+    size_t n_visible = 0;
+    for (size_t i = first; i < last; i += 8) {
+        __m256 x = _mm256_load_ps(&spheres->x[i]);
+        __m256 y = _mm256_load_ps(&spheres->y[i]);
+        __m256 z = _mm256_load_ps(&spheres->z[i]);
+        __m256 r = _mm256_sub_ps(
+                _mm256_setzero_ps(), _mm256_load_ps(&spheres->r[i]));
+        __m256 inside = _mm256_cmp_ps(r, r, _CMP_EQ_OQ);
+        for (size_t p = 0; p < 4; p++) {
+            __m256 distance = _mm256_add_ps(
+                    _mm256_add_ps(
+                        _mm256_mul_ps(a[p], x), _mm256_mul_ps(b[p], y)),
+                    _mm256_add_ps(_mm256_mul_ps(c[p], z), d[p])
+                );
+            inside = _mm256_and_ps(
+                    inside, _mm256_cmp_ps(distance, r, _CMP_GE_OQ));
+        }
+        for (int mask = _mm256_movemask_ps(inside); mask; mask &= mask - 1) {
+            visible[n_visible++] = (uint32_t)(i + __builtin_ctz(mask));
+        }
+    }
+    return n_visible;
+}
+#endif /* defined(__x86_64__) || defined(__i386__) */
+
+/* pick the best cull_spheres_* function this CPU supports */
+static cull_spheres_function cull_spheres_select()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx")) {
+        return cull_spheres_avx;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return cull_spheres_sse2;
+    }
+#endif /* defined(__x86_64__) || defined(__i386__) */
+    return cull_spheres_scalar;
+}
+
+/* the side planes of the frustum that the push constants were recorded
+ * with, normalized, as cull.glsl finds them
+ */
+static void cull_planes(float planes[4][4])
+{
+    /* vertex.glsl computes p * view * projection with these read as
+     * column-major, so clip coordinate j comes from row j of the row-major
+     * projection * view
+     */
+    const float * view = renderer.push_constants.view.matrix;
+    const float * projection = renderer.push_constants.projection.matrix;
+    float m[4][4];
+    for (size_t row = 0; row < 4; row++) {
+        for (size_t column = 0; column < 4; column++) {
+            m[row][column] = 0.0f;
+            for (size_t k = 0; k < 4; k++) {
+                m[row][column] +=
+                    projection[row * 4 + k] * view[k * 4 + column];
+            }
+        }
+    }
+
+    for (size_t p = 0; p < 4; p++) {
+        float sign = p % 2 == 0 ? 1.0f : -1.0f;
+        for (size_t k = 0; k < 4; k++) {
+            planes[p][k] = m[3][k] + sign * m[p / 2][k];
+        }
+        float length = sqrtf(
+                planes[p][0] * planes[p][0] +
+                planes[p][1] * planes[p][1] +
+                planes[p][2] * planes[p][2]
+            );
+        if (length > 0.0f) {
+            for (size_t k = 0; k < 4; k++) {
+                planes[p][k] /= length;
+            }
+        }
+    }
+}
+
 /* TODO: investigate push constants */
 static enum renderer_result update_uniform_buffer(uint32_t image_index)
 {
+    /* only write the objects that changed since this frame's buffer was
+     * last written, which for a mostly static scene is almost none of them
+     */
+    uint64_t synced = renderer.storage_buffers_synced[image_index];
+    size_t written = 0;
+#pragma omp parallel for reduction(+:written)
+    for (size_t i = 0; i < renderer.scene.n_objects; i++) {
+        if (renderer.scene.objects[i].changed < synced) {
+            continue;
+        }
+
+        struct storage_buffer_object sbo;
+        pack_object(&sbo, &renderer.scene.objects[i]);
+
+        memcpy(
+                renderer.storage_buffers_mapped[image_index] +
+                renderer.sbo_size * i,
+                &sbo,
+                sizeof(sbo)
+            );
+        written += sizeof(sbo);
+
+        /* the spheres are brought up to date every frame, so anything they
+         * are missing is also missing from this frame's buffer
+         */
+        if (renderer.cpu_culling &&
+                renderer.scene.objects[i].changed >= renderer.spheres.synced) {
+            renderer.spheres.x[i] = sbo.position[0];
+            renderer.spheres.y[i] = sbo.position[1];
+            renderer.spheres.z[i] = sbo.position[2];
+            renderer.spheres.r[i] = (sbo.flags & 1) ?
+                0.70710678f * fabsf(sbo.scale) : -INFINITY;
+        }
+    }
+    renderer.storage_buffers_synced[image_index] =
+        renderer.scene.generation + 1;
+
+    /* cull here instead of in cull.glsl, against the push constants that the
+     * command buffer was recorded with, before they're updated below
+     */
+    size_t n_visible = 0;
+    if (renderer.cpu_culling) {
+        double start = glfwGetTime();
+        renderer.spheres.synced = renderer.scene.generation + 1;
+
+        float planes[4][4];
+        cull_planes(planes);
+
+        /* each batch's visible indices start at its first object, which
+         * draws_reset() made its firstInstance
+         */
+        uint32_t n_batches = draws_reset();
+        uint32_t * visible = renderer.visible_buffers_mapped[image_index];
+        for (uint32_t batch = 0; batch < n_batches; batch++) {
+            size_t first = renderer.draws->commands[batch].firstInstance;
+            size_t last = first + renderer.batch_size;
+            if (last > renderer.spheres.n) {
+                last = renderer.spheres.n;
+            }
+            size_t n = renderer.cull_spheres(
+                    &renderer.spheres, first, last, planes, &visible[first]);
+            renderer.draws->commands[batch].instanceCount = (uint32_t)n;
+            n_visible += n;
+        }
+        memcpy(
+                renderer.draw_buffers_mapped[image_index],
+                renderer.draws,
+                draw_buffer_size(n_batches)
+            );
+
+        renderer.cull_seconds += glfwGetTime() - start;
+    }
+
+    /* report how much that was, averaged over the last 100 frames, if asked
+     * to
+     */
+    renderer.storage_bytes_written += written;
+    if (renderer.config.frame_statistics &&
+            renderer.scene.generation % 100 == 0) {
+        fprintf(
+                stderr,
+                "[renderer] (INFO) wrote %zu bytes of objects per frame\n",
+                renderer.storage_bytes_written / 100
+            );
+        if (renderer.cpu_culling) {
+            fprintf(
+                    stderr,
+                    "[renderer] (INFO) culled in %.3fms per frame (%zu of %zu objects visible)\n",
+                    renderer.cull_seconds / 100 * 1000.0,
+                    n_visible,
+                    renderer.scene.n_objects
+                );
+        }
+    }
+    if (renderer.scene.generation % 100 == 0) {
+        renderer.storage_bytes_written = 0;
+        renderer.cull_seconds = 0.0;
+    }
+
     /* push constants */
     {
         struct matrix view_matrix_a, view_matrix_b;
@@ -2748,71 +3859,6 @@ static enum renderer_result update_uniform_buffer(uint32_t image_index)
             );
     }
 
-#pragma omp parallel for
-    for (size_t i = 0; i < renderer.scene.n_objects; i++) {
-        struct storage_buffer_object sbo;
-
-        if (renderer.scene.objects[i].rain) {
-            sbo.model.matrix[0] = renderer.scene.objects[i].x;
-            sbo.model.matrix[1] = renderer.scene.objects[i].y;
-            sbo.model.matrix[2] = renderer.scene.objects[i].z;
-            sbo.model.matrix[4] = renderer.scene.objects[i].rotation.x;
-            sbo.model.matrix[5] = renderer.scene.objects[i].rotation.y;
-            sbo.model.matrix[6] = renderer.scene.objects[i].rotation.z;
-            sbo.model.matrix[7] = renderer.scene.objects[i].rotation.w;
-            sbo.model.matrix[8] = renderer.scene.objects[i].scale;
-            sbo.model.matrix[9] = renderer.scene.objects[i].velocity;
-            sbo.solid_index = renderer.scene.objects[i].solid_index;
-            sbo.outline_index = renderer.scene.objects[i].outline_index;
-            sbo.glow_index = renderer.scene.objects[i].glow_index;
-            sbo.flags = 0;
-            sbo.flags |= renderer.scene.objects[i].enabled ? 1 : 0;
-            sbo.flags |= renderer.scene.objects[i].glows ? 2 : 0;
-            sbo.flags |= 4;
-        } else {
-            struct matrix matrix_translate;
-            struct matrix matrix_rotate;
-
-            matrix_translation_scale(
-                    &sbo.model,
-                    renderer.scene.objects[i].x,
-                    renderer.scene.objects[i].y,
-                    renderer.scene.objects[i].z,
-                    renderer.scene.objects[i].scale,
-                    renderer.scene.objects[i].scale,
-                    renderer.scene.objects[i].scale
-                );
-
-            matrix_translation(
-                    &matrix_translate,
-                    renderer.scene.objects[i].cx,
-                    renderer.scene.objects[i].cy,
-                    renderer.scene.objects[i].cz
-                );
-
-            quaternion_matrix(
-                    &matrix_rotate,
-                    &renderer.scene.objects[i].rotation
-                );
-
-            matrix_multiply(&sbo.model, &sbo.model, &matrix_rotate);
-            matrix_multiply(&sbo.model, &sbo.model, &matrix_translate);
-            sbo.solid_index = renderer.scene.objects[i].solid_index;
-            sbo.outline_index = renderer.scene.objects[i].outline_index;
-            sbo.glow_index = renderer.scene.objects[i].glow_index;
-            sbo.flags = 0;
-            sbo.flags |= renderer.scene.objects[i].enabled ? 1 : 0;
-            sbo.flags |= renderer.scene.objects[i].glows ? 2 : 0;
-        }
-
-        memcpy(
-                renderer.storage_buffers_mapped[image_index] +
-                renderer.sbo_size * i,
-                &sbo,
-                sizeof(sbo)
-            );
-    }
-
     {
         ubo.ambient_light = renderer.scene.ambient_light;
         for (size_t i = 0; i < N_LIGHTS; i++) {
@@ -2900,6 +3946,7 @@ static enum renderer_result renderer_draw_frame()
     {
         /* for now, step here */
         double current_time = glfwGetTime();
+        renderer.scene.generation++;
         renderer.scene.step(&renderer.scene, current_time - renderer.time);
         renderer.time = current_time;
 
@@ -3218,6 +4265,9 @@ enum renderer_result renderer_init(
     result = setup_descriptor_sets();
     if (result) return result;
 
+    result = setup_cull_pipeline();
+    if (result) return result;
+
     result = setup_pipeline();
     if (result) return result;
 
@@ -3321,6 +4371,25 @@ void renderer_terminate()
         renderer.transient_command_pool = NULL;
     }
 
+    /* this frees the secondary command buffers too */
+    if (renderer.record_pools) {
+        size_t n_record_pools = (size_t)renderer.record_threads *
+            renderer.config.max_frames_in_flight;
+        for (size_t i = 0; i < n_record_pools; i++) {
+            if (renderer.record_pools[i]) {
+                vkDestroyCommandPool(
+                        renderer.device, renderer.record_pools[i], NULL);
+            }
+        }
+        free(renderer.record_pools);
+        renderer.record_pools = NULL;
+    }
+
+    if (renderer.secondary_command_buffers) {
+        free(renderer.secondary_command_buffers);
+        renderer.secondary_command_buffers = NULL;
+    }
+
     if (renderer.uniform_buffers) {
         for (uint32_t i = 0; i < renderer.config.max_frames_in_flight; i++) {
             vkDestroyBuffer(
@@ -3367,6 +4436,67 @@ void renderer_terminate()
         renderer.storage_buffers_mapped = NULL;
     }
 
+    if (renderer.storage_buffers_synced) {
+        free(renderer.storage_buffers_synced);
+        renderer.storage_buffers_synced = NULL;
+    }
+
+    if (renderer.visible_buffers) {
+        for (uint32_t i = 0; i < renderer.config.max_frames_in_flight; i++) {
+            vkDestroyBuffer(
+                    renderer.device, renderer.visible_buffers[i], NULL);
+        }
+        free(renderer.visible_buffers);
+        renderer.visible_buffers = NULL;
+    }
+
+    if (renderer.visible_buffer_memories) {
+        for (uint32_t i = 0; i < renderer.config.max_frames_in_flight; i++) {
+            vkFreeMemory(
+                    renderer.device, renderer.visible_buffer_memories[i], NULL);
+        }
+        free(renderer.visible_buffer_memories);
+        renderer.visible_buffer_memories = NULL;
+    }
+
+    if (renderer.draw_buffers) {
+        for (uint32_t i = 0; i < renderer.config.max_frames_in_flight; i++) {
+            vkDestroyBuffer(renderer.device, renderer.draw_buffers[i], NULL);
+        }
+        free(renderer.draw_buffers);
+        renderer.draw_buffers = NULL;
+    }
+
+    if (renderer.draw_buffer_memories) {
+        for (uint32_t i = 0; i < renderer.config.max_frames_in_flight; i++) {
+            vkFreeMemory(
+                    renderer.device, renderer.draw_buffer_memories[i], NULL);
+        }
+        free(renderer.draw_buffer_memories);
+        renderer.draw_buffer_memories = NULL;
+    }
+
+    if (renderer.visible_buffers_mapped) {
+        free(renderer.visible_buffers_mapped);
+        renderer.visible_buffers_mapped = NULL;
+    }
+
+    if (renderer.draw_buffers_mapped) {
+        free(renderer.draw_buffers_mapped);
+        renderer.draw_buffers_mapped = NULL;
+    }
+
+    if (renderer.draws) {
+        free(renderer.draws);
+        renderer.draws = NULL;
+    }
+
+    free(renderer.spheres.x);
+    free(renderer.spheres.y);
+    free(renderer.spheres.z);
+    free(renderer.spheres.r);
+    renderer.spheres = (struct cull_spheres) { };
+
     if (renderer.framebuffers) {
         for (uint32_t i = 0; i < renderer.n_swap_chain_images; i++) {
             if (renderer.framebuffers[i]) {
@@ -3440,6 +4570,16 @@ void renderer_terminate()
         renderer.layout = NULL;
     }
 
+    if (renderer.cull_pipeline) {
+        vkDestroyPipeline(renderer.device, renderer.cull_pipeline, NULL);
+        renderer.cull_pipeline = NULL;
+    }
+
+    if (renderer.cull_layout) {
+        vkDestroyPipelineLayout(renderer.device, renderer.cull_layout, NULL);
+        renderer.cull_layout = NULL;
+    }
+
     if (renderer.descriptor_set_layout) {
         vkDestroyDescriptorSetLayout(
                 renderer.device, renderer.descriptor_set_layout, NULL);
@@ -3642,6 +4782,7 @@ static enum renderer_result create_image(
         uint32_t width,
         uint32_t height,
         uint32_t layers,
+        uint32_t mip_levels,
         VkSampleCountFlagBits samples,
         VkFormat format,
         VkImageTiling tiling,
@@ -3657,7 +4798,7 @@ static enum renderer_result create_image(
             .height = height,
             .depth = 1
         },
-        .mipLevels = 1,
+        .mipLevels = mip_levels,
         .arrayLayers = layers,
         .format = format,
         .tiling = tiling,
@@ -3735,6 +4876,37 @@ static enum renderer_result setup_scene()
         return RENDERER_ERROR;
     }
 
+    if (renderer.cpu_culling) {
+        struct cull_spheres * spheres = &renderer.spheres;
+        spheres->n = (renderer.scene.n_objects + 7) / 8 * 8;
+        spheres->x = aligned_alloc(32, sizeof(float) * spheres->n);
+        spheres->y = aligned_alloc(32, sizeof(float) * spheres->n);
+        spheres->z = aligned_alloc(32, sizeof(float) * spheres->n);
+        spheres->r = aligned_alloc(32, sizeof(float) * spheres->n);
+        if (!spheres->x || !spheres->y || !spheres->z || !spheres->r) {
+            fprintf(stderr, "[renderer] out of memory\n");
+            renderer_terminate();
+            return RENDERER_ERROR;
+        }
+        for (size_t i = 0; i < spheres->n; i++) {
+            spheres->x[i] = spheres->y[i] = spheres->z[i] = 0.0f;
+            spheres->r[i] = -INFINITY;
+        }
+        spheres->synced = 0;
+    }
+
+    /* a storage_buffer_object holds texture indices in 16 bits */
+    if (renderer.scene.n_textures > UINT16_MAX + 1) {
+        fprintf(
+                stderr,
+                "[renderer] loaded scene has more textures (%zu) than renderer maximum (%zu)\n",
+                renderer.scene.n_textures,
+                (size_t)UINT16_MAX + 1
+            );
+        renderer_terminate();
+        return RENDERER_ERROR;
+    }
+
     return RENDERER_OKAY;
 }
 
@@ -3756,36 +4928,171 @@ static enum renderer_result setup_texture(
         return RENDERER_ERROR;
     }
 
+    /* textures in the pack (if there is one) are copied straight out of its
+     * mapping, and only the rest are loaded and decoded
+     */
+    struct dfield_pack * pack = NULL;
+    if (renderer.config.texture_pack) {
+        enum dfield_result pack_result =
+            dfield_pack_open(renderer.config.texture_pack, &pack);
+        if (pack_result) {
+            fprintf(
+                    stderr,
+                    "[renderer] (WARNING) dfield_pack_open(%s) failed: %s\n",
+                    renderer.config.texture_pack,
+                    dfield_result_string(pack_result)
+                );
+            pack = NULL;
+        }
+    }
+
+    /* only the headers of the textures not in the pack are read here, so
+     * that the staging buffer can be sized, and their data is then decoded
+     * straight into it. both are done for many files at once, with each
+     * file's result (and errno, which is per-thread) kept so that every
+     * failure can be reported afterwards
+     */
     struct dfield * dfields = malloc(sizeof(*dfields) * n_filenames);
+    bool * packed = malloc(sizeof(*packed) * n_filenames);
+    enum dfield_result * results = malloc(sizeof(*results) * n_filenames);
+    int * errors = malloc(sizeof(*errors) * n_filenames);
 
+#pragma omp parallel for schedule(dynamic)
     for (size_t i = 0; i < n_filenames; i++) {
-        enum dfield_result dfield_result =
-            dfield_from_file(filenames[i], &dfields[i]);
+        packed[i] = pack && dfield_pack_find(pack, filenames[i], &dfields[i]);
+        results[i] = packed[i] ? DFIELD_RESULT_OKAY :
+            dfield_header_from_file(filenames[i], &dfields[i]);
+        errors[i] = errno;
+    }
 
-        if (dfield_result) {
+    bool failed = false;
+    for (size_t i = 0; i < n_filenames; i++) {
+        if (results[i]) {
+            errno = errors[i];
             fprintf(
                     stderr,
-                    "[renderer] dfield_from_file(%s) failed: %s\n",
+                    "[renderer] dfield_header_from_file(%s) failed: %s\n",
                     filenames[i],
-                    dfield_result_string(dfield_result)
+                    dfield_result_string(results[i])
                 );
-            for (size_t j = 0; j < i; j++) {
-                dfield_free(&dfields[j]);
-            }
-            free(dfields);
-
-            /* TODO renderer terminate here is triggering segfault */
-            renderer_terminate();
-            return RENDERER_ERROR;
+            failed = true;
         }
     }
 
+    if (failed) {
+        free(results);
+        free(errors);
+        free(packed);
+        free(dfields);
+        dfield_pack_close(pack);
+
+        /* TODO renderer terminate here is triggering segfault */
+        renderer_terminate();
+        return RENDERER_ERROR;
+    }
+
     renderer.texture_max = n_filenames;
 
     uint32_t width = dfields[0].width;
     uint32_t height = dfields[0].height;
-    VkDeviceSize size =
-        width * height * sizeof(*dfields[0].data) * n_filenames;
+    for (size_t i = 0; i < n_filenames; i++) {
+        if ((uint32_t)dfields[i].width != width ||
+                (uint32_t)dfields[i].height != height) {
+            fprintf(
+                    stderr,
+                    "[renderer] texture %s is %dx%d, but %s is %ux%u\n",
+                    filenames[i],
+                    dfields[i].width,
+                    dfields[i].height,
+                    filenames[0],
+                    width,
+                    height
+                );
+            free(results);
+            free(errors);
+            free(packed);
+            free(dfields);
+            dfield_pack_close(pack);
+            return RENDERER_ERROR;
+        }
+    }
+
+    /* the texture array has one format. it's kept block compressed if all of
+     * the textures are and the device supports it, and otherwise any that
+     * are get decompressed as they're loaded. then if any of the textures
+     * are multi-channel, the plain ones get their distance copied into every
+     * channel (the median of which is that same distance)
+     */
+    enum dfield_format format = DFIELD_FORMAT_SDF;
+    bool all_bc4 = renderer.texture_compression_bc;
+    for (size_t i = 0; i < n_filenames; i++) {
+        if (dfields[i].format == DFIELD_FORMAT_MSDF) {
+            format = DFIELD_FORMAT_MSDF;
+        }
+        if (dfields[i].format != DFIELD_FORMAT_BC4) {
+            all_bc4 = false;
+        }
+    }
+    if (all_bc4) {
+        format = DFIELD_FORMAT_BC4;
+    }
+    renderer.texture_format =
+        format == DFIELD_FORMAT_MSDF ? VK_FORMAT_R8G8B8A8_SNORM :
+        format == DFIELD_FORMAT_BC4 ? VK_FORMAT_BC4_SNORM_BLOCK :
+        VK_FORMAT_R8_SNORM;
+    size_t channels = dfield_format_channels(format);
+
+    /* the array has as many mip levels as every texture carries, which are
+     * uploaded as they are. if any of them carries only the one, the whole
+     * chain is made from it with blits instead, if the format allows that
+     */
+    int32_t upload_levels = dfields[0].levels;
+    for (size_t i = 0; i < n_filenames; i++) {
+        if (dfields[i].levels < upload_levels) {
+            upload_levels = dfields[i].levels;
+        }
+    }
+
+    bool blit = false;
+    renderer.texture_levels = (uint32_t)upload_levels;
+    if (upload_levels == 1) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(
+                renderer.physical_device,
+                renderer.texture_format,
+                &properties
+            );
+        VkFormatFeatureFlags needed =
+            VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+            VK_FORMAT_FEATURE_BLIT_DST_BIT |
+            VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        if ((properties.optimalTilingFeatures & needed) == needed) {
+            blit = true;
+            for (uint32_t largest = width > height ? width : height;
+                    largest > 1; largest >>= 1) {
+                renderer.texture_levels++;
+            }
+        }
+    }
+
+    fprintf(
+            stderr,
+            "[renderer] (INFO) textures have %u mip levels (%s)\n",
+            renderer.texture_levels,
+            blit ? "made with blits" : "from the files"
+        );
+
+    /* each layer's levels are next to each other in the staging buffer, the
+     * same as in a dfield
+     */
+    struct dfield layout = {
+        .width = width,
+        .height = height,
+        .levels = upload_levels,
+        .format = format
+    };
+    VkDeviceSize each_size = dfield_data_size(&layout);
+    VkDeviceSize size = each_size * n_filenames;
 
     fprintf(
             stderr,
@@ -3794,6 +5101,20 @@ static enum renderer_result setup_texture(
             n_filenames
         );
 
+    /* decoding reads back what it has written (LZ matches, the median
+     * filter, and the channel expansion below), which is very slow from
+     * uncached memory. so the data is only decoded in place if the staging
+     * buffer can be cached (and is then flushed), and otherwise each texture
+     * is decoded into memory of its own and copied in
+     */
+    bool cached = host_cached_supported(VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+
+    fprintf(
+            stderr,
+            "[renderer] (INFO) decoding textures %s\n",
+            cached ? "in place" : "through separate buffers"
+        );
+
     VkBuffer staging_buffer;
     VkDeviceMemory staging_buffer_memory;
     if (create_buffer(
@@ -3801,22 +5122,127 @@ static enum renderer_result setup_texture(
             &staging_buffer_memory,
             size,
             VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+            cached ?
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                VK_MEMORY_PROPERTY_HOST_CACHED_BIT :
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
         )) {
+        free(results);
+        free(errors);
+        free(packed);
+        free(dfields);
+        dfield_pack_close(pack);
         return RENDERER_ERROR;
     }
 
     void * data;
     vkMapMemory(renderer.device, staging_buffer_memory, 0, size, 0, &data);
-    VkDeviceSize each_size = width * height * sizeof(*dfields[0].data);
+#pragma omp parallel for schedule(dynamic)
     for (size_t i = 0; i < n_filenames; i++) {
-        memcpy(data + each_size * i, dfields[i].data, (size_t)each_size);
-        dfield_free(&dfields[i]);
+        int8_t * layer = data + each_size * i;
+
+        /* a texture whose data fits in its layer (all of them, unless it has
+         * more mip levels than the array or has to be decompressed) is
+         * decoded into it if the layer is cached, and any other is loaded
+         * into a buffer of its own and the levels the array has copied in
+         */
+        struct dfield dfield = dfields[i];
+        bool owned = false;
+        bool decompress =
+            dfield.format == DFIELD_FORMAT_BC4 && format != DFIELD_FORMAT_BC4;
+        if (!packed[i]) {
+            if (cached && !decompress &&
+                    dfield_data_size(&dfields[i]) <= each_size) {
+                results[i] = dfield_from_file_into(
+                        filenames[i], layer, each_size, &dfield);
+            } else {
+                results[i] = dfield_from_file(filenames[i], &dfield);
+                owned = !results[i];
+            }
+            if (results[i]) {
+                errors[i] = errno;
+                continue;
+            }
+        }
+
+        if (decompress) {
+            struct dfield decompressed;
+            results[i] = dfield_decode_bc4(&dfield, &decompressed);
+            errors[i] = errno;
+            if (owned) {
+                dfield_free(&dfield);
+            }
+            if (results[i]) {
+                continue;
+            }
+            dfield = decompressed;
+            owned = true;
+        }
+
+        if (dfield.format != format) {
+            /* backwards, so that this works in place when the plain
+             * distances were decoded into the start of the (cached) layer
+             */
+            for (size_t j = (size_t)each_size / channels; j-- > 0;) {
+                for (size_t c = 0; c < channels; c++) {
+                    layer[j * channels + c] = dfield.data[j];
+                }
+            }
+        } else if (dfield.data != layer) {
+            memcpy(layer, dfield.data, (size_t)each_size);
+        }
+
+        if (owned) {
+            dfield_free(&dfield);
+        }
+    }
+
+    for (size_t i = 0; i < n_filenames; i++) {
+        if (results[i]) {
+            errno = errors[i];
+            fprintf(
+                    stderr,
+                    "[renderer] dfield_from_file(%s) failed: %s\n",
+                    filenames[i],
+                    dfield_result_string(results[i])
+                );
+            failed = true;
+        }
+    }
+
+    if (failed) {
+        vkUnmapMemory(renderer.device, staging_buffer_memory);
+        vkDestroyBuffer(renderer.device, staging_buffer, NULL);
+        vkFreeMemory(renderer.device, staging_buffer_memory, NULL);
+        free(results);
+        free(errors);
+        free(packed);
+        free(dfields);
+        dfield_pack_close(pack);
+        return RENDERER_ERROR;
+    }
+
+    /* cached memory need not be coherent */
+    if (cached) {
+        vkFlushMappedMemoryRanges(
+                renderer.device,
+                1,
+                &(VkMappedMemoryRange) {
+                    .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+                    .memory = staging_buffer_memory,
+                    .offset = 0,
+                    .size = VK_WHOLE_SIZE
+                }
+            );
     }
     vkUnmapMemory(renderer.device, staging_buffer_memory);
 
+    free(results);
+    free(errors);
+    free(packed);
     free(dfields);
+    dfield_pack_close(pack);
 
     if (create_image(
                 texture_image,
@@ -3824,10 +5250,12 @@ static enum renderer_result setup_texture(
                 width,
                 height,
                 n_filenames,
+                renderer.texture_levels,
                 VK_SAMPLE_COUNT_1_BIT,
-                VK_FORMAT_R8_SNORM,
+                renderer.texture_format,
                 VK_IMAGE_TILING_OPTIMAL,
                 VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                (blit ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0) |
                 VK_IMAGE_USAGE_SAMPLED_BIT,
                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
             )) {
@@ -3838,34 +5266,76 @@ static enum renderer_result setup_texture(
 
     if (transition_image_layout(
                 *texture_image,
-                VK_FORMAT_R8_SNORM,
+                renderer.texture_format,
                 VK_IMAGE_LAYOUT_UNDEFINED,
                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                n_filenames
+                n_filenames,
+                renderer.texture_levels
             )) {
         vkDestroyBuffer(renderer.device, staging_buffer, NULL);
         vkFreeMemory(renderer.device, staging_buffer_memory, NULL);
         return RENDERER_ERROR;
     }
 
+    /* one region for each level of each layer */
+    uint32_t n_regions = n_filenames * (uint32_t)upload_levels;
+    VkBufferImageCopy * regions = malloc(sizeof(*regions) * n_regions);
+    for (size_t i = 0; i < n_filenames; i++) {
+        VkDeviceSize offset = each_size * i;
+        for (int32_t level = 0; level < upload_levels; level++) {
+            regions[i * upload_levels + level] = (VkBufferImageCopy) {
+                .bufferOffset = offset,
+                .bufferRowLength = 0,
+                .bufferImageHeight = 0,
+                .imageSubresource = {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .mipLevel = level,
+                    .baseArrayLayer = i,
+                    .layerCount = 1
+                },
+                .imageOffset = { 0, 0, 0 },
+                .imageExtent = {
+                    dfield_level_width(width, level),
+                    dfield_level_width(height, level),
+                    1
+                }
+            };
+            offset += dfield_level_size(&layout, level);
+        }
+    }
+
     if (copy_buffer_to_image(
                 staging_buffer,
                 *texture_image,
-                width,
-                height,
-                n_filenames
+                n_regions,
+                regions
             )) {
+        free(regions);
         vkDestroyBuffer(renderer.device, staging_buffer, NULL);
         vkFreeMemory(renderer.device, staging_buffer_memory, NULL);
         return RENDERER_ERROR;
     }
-
-    if (transition_image_layout(
+    free(regions);
+
+    if (blit) {
+        if (generate_mipmaps(
+                    *texture_image,
+                    width,
+                    height,
+                    n_filenames,
+                    renderer.texture_levels
+                )) {
+            vkDestroyBuffer(renderer.device, staging_buffer, NULL);
+            vkFreeMemory(renderer.device, staging_buffer_memory, NULL);
+            return RENDERER_ERROR;
+        }
+    } else if (transition_image_layout(
                 *texture_image,
-                VK_FORMAT_R8_SNORM,
+                renderer.texture_format,
                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                 VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                n_filenames
+                n_filenames,
+                renderer.texture_levels
             )) {
         vkDestroyBuffer(renderer.device, staging_buffer, NULL);
         vkFreeMemory(renderer.device, staging_buffer_memory, NULL);
@@ -3883,7 +5353,8 @@ static enum renderer_result transition_image_layout(
         VkFormat format,
         VkImageLayout old_layout,
         VkImageLayout new_layout,
-        uint32_t layers
+        uint32_t layers,
+        uint32_t mip_levels
     )
 {
     /* TODO */
@@ -3904,7 +5375,7 @@ static enum renderer_result transition_image_layout(
         .subresourceRange = {
             .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
             .baseMipLevel = 0,
-            .levelCount = 1,
+            .levelCount = mip_levels,
             .baseArrayLayer = 0,
             .layerCount = layers
         }
@@ -3956,10 +5427,42 @@ static enum renderer_result transition_image_layout(
 
 static enum renderer_result copy_buffer_to_image(
         VkBuffer buffer,
+        VkImage image,
+        uint32_t n_regions,
+        const VkBufferImageCopy * regions
+    )
+{
+    VkCommandBuffer command_buffer;
+    if (command_buffer_oneoff_begin(&command_buffer)) {
+        return RENDERER_ERROR;
+    }
+
+    vkCmdCopyBufferToImage(
+            command_buffer,
+            buffer,
+            image,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            n_regions,
+            regions
+        );
+
+    if (command_buffer_oneoff_end(&command_buffer)) {
+        return RENDERER_ERROR;
+    }
+
+    return RENDERER_OKAY;
+}
+
+/* fill in the levels after the first of this image (all of which are in
+ * VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) by blitting each from the last,
+ * leaving them all in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+ */
+static enum renderer_result generate_mipmaps(
         VkImage image,
         uint32_t width,
         uint32_t height,
-        uint32_t layers
+        uint32_t layers,
+        uint32_t mip_levels
     )
 {
     VkCommandBuffer command_buffer;
@@ -3967,33 +5470,116 @@ static enum renderer_result copy_buffer_to_image(
         return RENDERER_ERROR;
     }
 
-    VkBufferImageCopy region = {
-        .bufferOffset = 0,
-        .bufferRowLength = 0,
-        .bufferImageHeight = 0,
-        .imageSubresource = {
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = {
             .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-            .mipLevel = 0,
+            .levelCount = 1,
             .baseArrayLayer = 0,
             .layerCount = layers
-        },
-        .imageOffset = { 0, 0, 0 },
-        .imageExtent = {
-            width,
-            height,
-            1
         }
     };
 
-    vkCmdCopyBufferToImage(
+    int32_t level_width = width, level_height = height;
+    for (uint32_t level = 1; level < mip_levels; level++) {
+        /* the last level is done being written, and is now read from */
+        barrier.subresourceRange.baseMipLevel = level - 1;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(
+                command_buffer,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0,
+                0,
+                NULL,
+                0,
+                NULL,
+                1,
+                &barrier
+            );
+
+        int32_t next_width = level_width > 1 ? level_width / 2 : 1;
+        int32_t next_height = level_height > 1 ? level_height / 2 : 1;
+
+        VkImageBlit blit = {
+            .srcSubresource = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .mipLevel = level - 1,
+                .baseArrayLayer = 0,
+                .layerCount = layers
+            },
+            .srcOffsets = {
+                { 0, 0, 0 },
+                { level_width, level_height, 1 }
+            },
+            .dstSubresource = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .mipLevel = level,
+                .baseArrayLayer = 0,
+                .layerCount = layers
+            },
+            .dstOffsets = {
+                { 0, 0, 0 },
+                { next_width, next_height, 1 }
+            }
+        };
+
+        vkCmdBlitImage(
+                command_buffer,
+                image,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                image,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                1,
+                &blit,
+                VK_FILTER_LINEAR
+            );
+
+        /* and now it's done being read from */
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(
+                command_buffer,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                0,
+                0,
+                NULL,
+                0,
+                NULL,
+                1,
+                &barrier
+            );
+
+        level_width = next_width;
+        level_height = next_height;
+    }
+
+    /* the last level is only ever written */
+    barrier.subresourceRange.baseMipLevel = mip_levels - 1;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(
             command_buffer,
-            buffer,
-            image,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            0,
+            0,
+            NULL,
+            0,
+            NULL,
             1,
-            (VkBufferImageCopy[]) {
-                region
-            }
+            &barrier
         );
 
     if (command_buffer_oneoff_end(&command_buffer)) {
@@ -4010,11 +5596,11 @@ static enum renderer_result setup_texture_view()
             .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
             .image = renderer.texture,
             .viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY,
-            .format = VK_FORMAT_R8_SNORM,
+            .format = renderer.texture_format,
             .subresourceRange = {
                 .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
                 .baseMipLevel = 0,
-                .levelCount = 1,
+                .levelCount = renderer.texture_levels,
                 .baseArrayLayer = 0,
                 .layerCount  = renderer.texture_max
             }
@@ -4056,7 +5642,7 @@ static enum renderer_result setup_texture_sampler()
             .mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
             .mipLodBias = 0.0f,
             .minLod = 0.0f,
-            .maxLod = 0.0f
+            .maxLod = (float)renderer.texture_levels
         }
     };
 
@@ -4219,6 +5805,7 @@ struct atlas * atlas_create(uint32_t element_size, uint32_t elements)
                 elements_wide * element_size,
                 elements_tall * element_size,
                 needed_layers,
+                1,
                 get_msaa_samples(),
                 VK_FORMAT_R8_SNORM,
                 VK_IMAGE_TILING_OPTIMAL,
@@ -4235,7 +5822,8 @@ struct atlas * atlas_create(uint32_t element_size, uint32_t elements)
                 VK_FORMAT_R8_SNORM,
                 VK_IMAGE_LAYOUT_UNDEFINED,
                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                needed_layers
+                needed_layers,
+                1
             )) {
         vkDestroyImage(renderer.device, atlas->image, NULL);
         vkFreeMemory(renderer.device, atlas->image_memory, NULL);
@@ -4386,6 +5974,7 @@ enum renderer_result atlas_upload(
                             VK_FORMAT_R8_SNORM,
                             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                             VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                            1,
                             1
                         )) {
                     return RENDERER_ERROR;
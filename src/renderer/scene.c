@@ -81,6 +81,7 @@ void rain_step(struct scene * scene, double delta)
             scene->objects[i].z = drop->z;
             scene->objects[i].velocity = drop->velocity;
             scene->objects[i].rain = true;
+            scene_object_changed(scene, i);
         } else {
             if (rand() % 100 < 1) {
                 drop->alive = true;
@@ -100,8 +101,10 @@ void rain_step(struct scene * scene, double delta)
                 scene->objects[i].solid_index = 19;
                 scene->objects[i].outline_index = 20;
                 scene->objects[i].rain = true;
-            } else {
+                scene_object_changed(scene, i);
+            } else if (scene->objects[i].enabled) {
                 scene->objects[i].enabled = false;
+                scene_object_changed(scene, i);
             }
         }
     }
@@ -875,6 +878,11 @@ void scene_load_soho(struct scene * scene)
     */
 }
 
+void scene_object_changed(struct scene * scene, size_t index)
+{
+    scene->objects[index].changed = scene->generation;
+}
+
 void scene_destroy(struct scene * scene)
 {
     free(scene->lights);
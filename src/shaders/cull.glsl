@@ -0,0 +1,105 @@
+#version 450
+/* File: src/shaders/cull.glsl
+ * Part of snrkos <github.com/rmkrupp/snrkos>
+ *
+ * Copyright (C) 2025 Noah Santer <n.ed.santer@gmail.com>
+ * Copyright (C) 2025 Rebecca Krupp <beka.krupp@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* frustum cull the enabled objects, writing the indices of the ones that
+ * might be visible to visible[] and counting them in the indirect draw of
+ * their batch
+ */
+
+layout(local_size_x = 64) in;
+
+/* one instance (see vertex.glsl) */
+struct object {
+    vec4 position_scale;
+    uvec2 rotation;
+    uvec2 indices;
+};
+
+layout(binding = 0, std140) buffer restrict readonly UniformBufferObject {
+    object objects[];
+} ubo;
+
+layout(binding = 3, std430) buffer restrict writeonly VisibleBuffer {
+    uint visible[];
+};
+
+/* a VkDrawIndexedIndirectCommand */
+struct command {
+    uint index_count;
+    uint instance_count;
+    uint first_index;
+    int vertex_offset;
+    uint first_instance;
+};
+
+/* how many objects there are and how many are in each batch, then the draw
+ * of each batch (see struct draw_buffer_object in renderer.c)
+ */
+layout(binding = 4, std430) buffer restrict DrawBuffer {
+    uint n_objects;
+    uint batch_size;
+    command commands[];
+} draw;
+
+layout(push_constant, std430) uniform pc {
+    mat4 view;
+    mat4 projection;
+};
+
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= draw.n_objects) {
+        return;
+    }
+
+    object o = ubo.objects[i];
+    if (((o.indices.y >> 16) & 1) == 0) {
+        // disabled
+        return;
+    }
+
+    // the corners of the quad are sqrt(1/2) from its center before scaling
+    vec4 center = vec4(o.position_scale.xyz, 1.0);
+    float radius = 0.70710678 * abs(o.position_scale.w);
+
+    // vertex.glsl computes clip = p * view * projection, so column j of m
+    // gives clip coordinate j. the side planes are w + x, w - x, w + y, and
+    // w - y, which between them also reject everything behind the camera
+    mat4 m = view * projection;
+    vec4 planes[4] = vec4[](
+        m[3] + m[0],
+        m[3] - m[0],
+        m[3] + m[1],
+        m[3] - m[1]
+    );
+    for (int p = 0; p < 4; p++) {
+        if (dot(planes[p], center) < -radius * length(planes[p].xyz)) {
+            return;
+        }
+    }
+
+    // each batch's visible indices start at its first_instance
+    uint batch = i / draw.batch_size;
+    visible[
+        draw.commands[batch].first_instance +
+        atomicAdd(draw.commands[batch].instance_count, 1)
+    ] = i;
+}
@@ -21,6 +21,7 @@
  */
 
 layout(constant_id = 0) const uint N_LIGHTS = 1;
+layout(constant_id = 1) const bool MULTI_CHANNEL = false;
 
 struct light {
     vec4 position;
@@ -45,11 +46,22 @@ layout(binding = 2, std140) uniform UniformBufferObjectG {
     light lights[N_LIGHTS];
 } ubo_g;
 
+/* the signed distance at this point of this layer: the field itself, or the
+ * median of the three channels of a multi-channel field
+ */
+float field(int layer) {
+    vec4 t = texture(texSampler, vec3(fragTexCoord, layer));
+    if (MULTI_CHANNEL) {
+        return max(min(t.r, t.g), min(max(t.r, t.g), t.b));
+    }
+    return t.x;
+}
+
 void main() {
 
-    float t_solid = texture(texSampler, vec3(fragTexCoord, texture_indices.x)).x;
-    float t_outline = texture(texSampler, vec3(fragTexCoord, texture_indices.y)).x;
-    float t_glow = texture(texSampler, vec3(fragTexCoord, texture_indices.z)).x;
+    float t_solid = field(texture_indices.x);
+    float t_outline = field(texture_indices.y);
+    float t_glow = field(texture_indices.z);
 
     bool glows = ((fragFlags & 2) == 2) && (texture_indices.z > 0);
 
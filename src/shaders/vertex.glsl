@@ -20,16 +20,26 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+/* one instance: the quad is scaled, then rotated, then moved to position
+ * (see struct storage_buffer_object in renderer.c)
+ */
 struct object {
-    mat4 model;
-    uint solid_index, outline_index, glow_index;
-    uint flags;
+    vec4 position_scale; // xyz position, w scale
+    uvec2 rotation; // a unit quaternion (x, y, z, w) as four snorm16s
+    uvec2 indices; // solid, outline, and glow index, then flags, as uint16s
 };
 
 layout(binding = 0, std140) buffer restrict readonly UniformBufferObject {
     object objects[];
 } ubo;
 
+/* the indices of the objects that survived culling (see cull.glsl), one per
+ * instance
+ */
+layout(binding = 3, std430) buffer restrict readonly VisibleBuffer {
+    uint visible[];
+};
+
 layout(push_constant, std430) uniform pc {
     mat4 view;
     mat4 projection;
@@ -47,65 +57,34 @@ layout(location = 3) out vec2 fragTexCoord;
 layout(location = 4) out flat ivec3 texture_indices;
 layout(location = 5) out flat uint fragFlags;
 
-void main() {
-    uint flags = ubo.objects[gl_InstanceIndex].flags;
-
-    if ((flags & 1) == 0) {
-        // disabled
-        gl_Position = vec4(0.0, 0.0, -10.0, 1.0);
-    } else if ((flags & 4) == 4) {
-        // rain
-
-        vec3 position = ubo.objects[gl_InstanceIndex].model[0].xyz;
-        vec4 rotation = ubo.objects[gl_InstanceIndex].model[1];
-        float scale = ubo.objects[gl_InstanceIndex].model[2].x;
-        float velocity = ubo.objects[gl_InstanceIndex].model[2].y;
-        mat4 m_scale_trans = mat4(
-            scale, 0.0, 0.0, position.x,
-            0.0, scale, 0.0, position.y,
-            0.0, 0.0, scale, position.z,
-            0.0, 0.0, 0.0, 1.0
-        );
-        mat4 m_rot = mat4(
-            1 - 2 * rotation.y * rotation.y - 2 * rotation.z * rotation.z,
-            2 * rotation.x * rotation.y - 2 * rotation.w * rotation.z,
-            2 * rotation.x * rotation.z + 2 * rotation.w * rotation.y,
-            0,
-
-            2 * rotation.x * rotation.y + 2 * rotation.w * rotation.z,
-            1 - 2 * rotation.x * rotation.x - 2 * rotation.z * rotation.z,
-            2 * rotation.y * rotation.z - 2 * rotation.w * rotation.x,
-            0,
-
-            2 * rotation.x * rotation.z - 2 * rotation.w * rotation.y,
-            2 * rotation.y * rotation.z + 2 * rotation.w * rotation.x,
-            1 - 2 * rotation.x * rotation.x - 2 * rotation.y * rotation.y,
-            0,
+/* rotate v by the unit quaternion q */
+vec3 rotate(vec4 q, vec3 v) {
+    vec3 t = 2.0 * cross(q.xyz, v);
+    return v + q.w * t + cross(q.xyz, t);
+}
 
-            0,
-            0,
-            0,
-            1
-        );
+void main() {
+    object o = ubo.objects[visible[gl_InstanceIndex]];
+    uint flags = o.indices.y >> 16;
 
-        vec4 worldPosition = vec4(inPosition, 1.0) * m_scale_trans * m_rot; 
-        gl_Position = worldPosition * view * projection;
-        fragWorldPosition = worldPosition.xyz;
-        fragColor = inColor;
-        fragTexCoord = inTexCoord;
-        texture_indices = ivec3(ubo.objects[gl_InstanceIndex].solid_index, ubo.objects[gl_InstanceIndex].outline_index, ubo.objects[gl_InstanceIndex].glow_index);
-        vec4 normal = vec4(inNormal, 1.0) * m_scale_trans * view * projection;
-        fragNormal = normalize(normal.xyz);
-        fragFlags = flags;
-    } else {
-        vec4 worldPosition = vec4(inPosition, 1.0) * ubo.objects[gl_InstanceIndex].model;
-        gl_Position = worldPosition * view * projection;
-        fragWorldPosition = worldPosition.xyz;
-        fragColor = inColor;
-        fragTexCoord = inTexCoord;
-        texture_indices = ivec3(ubo.objects[gl_InstanceIndex].solid_index, ubo.objects[gl_InstanceIndex].outline_index, ubo.objects[gl_InstanceIndex].glow_index);
-        vec4 normal = vec4(inNormal, 1.0) * ubo.objects[gl_InstanceIndex].model * view * projection;
-        fragNormal = normalize(normal.xyz);
-        fragFlags = flags;
-    }
+    vec4 rotation = normalize(vec4(
+        unpackSnorm2x16(o.rotation.x),
+        unpackSnorm2x16(o.rotation.y)
+    ));
+    vec4 worldPosition = vec4(
+        rotate(rotation, inPosition * o.position_scale.w) +
+            o.position_scale.xyz,
+        1.0
+    );
+    gl_Position = worldPosition * view * projection;
+    fragWorldPosition = worldPosition.xyz;
+    fragColor = inColor;
+    fragTexCoord = inTexCoord;
+    texture_indices = ivec3(
+        o.indices.x & 0xffffu,
+        o.indices.x >> 16,
+        o.indices.y & 0xffffu
+    );
+    fragNormal = rotate(rotation, inNormal);
+    fragFlags = flags;
 }
@@ -0,0 +1,819 @@
+/* File: src/test/bench-dfield.c
+ * Part of snrkos <github.com/rmkrupp/snrkos>
+ *
+ * Copyright (C) 2025 Noah Santer <n.ed.santer@gmail.com>
+ * Copyright (C) 2025 Rebecca Krupp <beka.krupp@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* benchmark dfield generation, compression, and decompression
+ *
+ * every result is printed to stdout as one line: a kind (generate, io, or
+ * sizes) followed by space-separated key=value pairs, so that runs can be
+ * compared by a script. progress and errors go to stderr
+ */
+#include "dfield.h"
+#include "tools/generate-dfield/image.h"
+
+#include <getopt.h>
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif /* _WIN32 */
+
+/* the pseudo-algorithm name for dfield_generate_tiled */
+constexpr char tiled_name[] = "tiled";
+
+/* the algorithms run when none are given, in the order of enum
+ * dfield_algorithm, with tiled last
+ */
+static const char * default_algorithms[] = {
+    "brute-force", "edt", "bitplane", "msdf", "coverage", tiled_name
+};
+
+/* a growable list of int32_t values, for repeatable options */
+struct int_list {
+    size_t n;
+    int32_t * values;
+};
+
+/* an input to benchmark against */
+struct bench_input {
+    char * name;
+    int32_t width, height;
+    uint8_t * data;
+};
+
+/* what to benchmark */
+struct bench_options {
+    struct int_list output_sizes,
+                    spreads,
+                    threads,
+                    synthetic_sizes,
+                    codecs,
+                    filters,
+                    band_rows;
+    size_t n_algorithms;
+    const char ** algorithms;
+    int32_t repeats;
+    int32_t tile_size;
+    int32_t raw_size; /* for inputs that are raw data */
+    const char * scratch_path;
+};
+
+static void usage()
+{
+    fprintf(stderr, "Usage: bench-dfield [--help] [-O|--output-size SIZE]... [-S|--spread SPREAD]... [-A|--algorithm ALGORITHM]... [-j|--threads N]... [-C|--codec CODEC]... [-F|--filter FILTER]... [-R|--band-rows ROWS]... [-s|--synthetic SIZE]... [-I|--input-size SIZE] [-T|--tile-size SIZE] [-n|--repeats N] [--scratch PATH] [INPUT_FILE]...\n");
+}
+
+/* add this value to list, returning false if we ran out of memory */
+static bool int_list_add(struct int_list * list, int32_t value)
+{
+    int32_t * values =
+        realloc(list->values, sizeof(*values) * (list->n + 1));
+    if (!values) {
+        return false;
+    }
+    values[list->n++] = value;
+    list->values = values;
+    return true;
+}
+
+/* the peak resident set size of this process so far, in KiB (or -1 if we
+ * don't know how to find it here)
+ */
+static long peak_rss_kib()
+{
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        return usage.ru_maxrss;
+    }
+#endif /* _WIN32 */
+    return -1;
+}
+
+/* make a synthetic input of this size: a five-pointed star with a ring
+ * around it, which has convex and concave corners, curves, and a hole
+ */
+static bool synthetic_input(int32_t size, struct bench_input * input_out)
+{
+    uint8_t * data = malloc((size_t)size * size);
+    char * name = malloc(32);
+    if (!data || !name) {
+        free(data);
+        free(name);
+        return false;
+    }
+    snprintf(name, 32, "synthetic-%d", (int)size);
+
+    double px[10], py[10];
+    for (int k = 0; k < 10; k++) {
+        double r = k % 2 ? 0.17 : 0.38,
+               a = M_PI / 2 + k * M_PI / 5 + 0.1;
+        px[k] = 0.5 + r * cos(a);
+        py[k] = 0.5 - r * sin(a);
+    }
+
+    #pragma omp parallel for
+    for (int32_t y = 0; y < size; y++) {
+        for (int32_t x = 0; x < size; x++) {
+            double fx = (x + 0.5) / size,
+                   fy = (y + 0.5) / size;
+            bool on = false;
+            for (int i = 0, j = 9; i < 10; j = i++) {
+                if ((py[i] > fy) != (py[j] > fy) &&
+                        fx < px[i] + (fy - py[i]) * (px[j] - px[i]) /
+                                     (py[j] - py[i])) {
+                    on = !on;
+                }
+            }
+            double r = hypot(fx - 0.5, fy - 0.5);
+            if (r > 0.42 && r < 0.47) {
+                on = true;
+            }
+            data[(size_t)y * size + x] = on ? 255 : 0;
+        }
+    }
+
+    *input_out = (struct bench_input) {
+        .name = name,
+        .width = size,
+        .height = size,
+        .data = data
+    };
+    return true;
+}
+
+/* load this file (a PNG, a PGM, or raw data of raw_size by raw_size) as an
+ * input
+ */
+static bool file_input(
+        const char * path,
+        int32_t raw_size,
+        struct bench_input * input_out
+    )
+{
+    struct dfield_input * input;
+    enum dfield_result result;
+    switch (image_kind_of_file(path)) {
+        case IMAGE_KIND_PNG:
+            result = image_input_open_png(path, false, &input);
+            break;
+        case IMAGE_KIND_PGM:
+            result = dfield_input_open_pgm(path, &input);
+            break;
+        default:
+            if (raw_size == 0) {
+                fprintf(stderr, "%s: input size not given for raw data\n", path);
+                return false;
+            }
+            result = dfield_input_open_raw(path, raw_size, raw_size, &input);
+            break;
+    }
+    if (result) {
+        fprintf(stderr, "%s: %s\n", path, dfield_result_string(result));
+        return false;
+    }
+
+    uint8_t * data;
+    result = dfield_input_read_all(input, &data);
+    int32_t width, height;
+    dfield_input_size(input, &width, &height);
+    dfield_input_close(input);
+    if (result) {
+        fprintf(stderr, "%s: %s\n", path, dfield_result_string(result));
+        return false;
+    }
+
+    /* names are printed as values, so they can't have spaces */
+    const char * base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    char * name = malloc(strlen(base) + 1);
+    if (!name) {
+        free(data);
+        return false;
+    }
+    for (size_t i = 0; i <= strlen(base); i++) {
+        name[i] = base[i] == ' ' ? '_' : base[i];
+    }
+
+    *input_out = (struct bench_input) {
+        .name = name,
+        .width = width,
+        .height = height,
+        .data = data
+    };
+    return true;
+}
+
+/* the state of an input reading rows from memory, for the tiled benchmark */
+struct memory_input {
+    const struct bench_input * input;
+    int32_t next_row;
+};
+
+/* read the next row of a memory_input (see dfield_read_row_function) */
+static enum dfield_result memory_input_read_row(void * state, uint8_t * row)
+{
+    struct memory_input * memory = state;
+    const struct bench_input * input = memory->input;
+    memcpy(row,
+           &input->data[(size_t)memory->next_row++ * input->width],
+           input->width);
+    return DFIELD_RESULT_OKAY;
+}
+
+/* generate one dfield from this input with this algorithm (or tiled_name),
+ * putting it in dfield_out
+ */
+static enum dfield_result generate(
+        const struct bench_input * input,
+        const char * algorithm_name,
+        const struct dfield_output * output,
+        int32_t tile_size,
+        struct dfield * dfield_out
+    )
+{
+    if (!strcmp(algorithm_name, tiled_name)) {
+        struct memory_input memory = { .input = input };
+        struct dfield_input * tiled_input;
+        enum dfield_result result = dfield_input_open(
+                input->width,
+                input->height,
+                memory_input_read_row,
+                NULL,
+                &memory,
+                &tiled_input
+            );
+        if (result) {
+            return result;
+        }
+        result = dfield_generate_tiled(
+                tiled_input, 1, output, tile_size, dfield_out);
+        dfield_input_close(tiled_input);
+        return result;
+    }
+
+    enum dfield_algorithm algorithm;
+    if (!dfield_algorithm_from_name(algorithm_name, &algorithm)) {
+        return DFIELD_RESULT_ERROR_BAD_ALGORITHM;
+    }
+    return dfield_generate_multiple(
+            input->data,
+            input->width,
+            input->height,
+            1,
+            output,
+            algorithm,
+            dfield_out
+        );
+}
+
+/* the size of this file, or -1 if we can't tell */
+static long file_size(const char * path)
+{
+    FILE * file = fopen(path, "rb");
+    if (!file) {
+        return -1;
+    }
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        size = ftell(file);
+    }
+    fclose(file);
+    return size;
+}
+
+/* the names of the codecs and filters, as printed */
+static const char * codec_names[] = {
+    [DFIELD_CODEC_LZMA] = "lzma",
+    [DFIELD_CODEC_LZ] = "lz"
+};
+static const char * filter_names[] = {
+    [DFIELD_FILTER_NONE] = "none",
+    [DFIELD_FILTER_MEDIAN] = "median"
+};
+
+/* time writing this dfield to the scratch file with this encoding and
+ * reading it back, print the result, and put the size of the file in
+ * file_size_out
+ */
+static bool bench_io(
+        const struct bench_options * options,
+        const struct bench_input * input,
+        const char * algorithm_name,
+        int32_t spread,
+        const struct dfield_encoding * encoding,
+        const struct dfield * dfield,
+        long * file_size_out
+    )
+{
+    double best_write = INFINITY,
+           best_read = INFINITY;
+    for (int32_t r = 0; r < options->repeats; r++) {
+        double start = omp_get_wtime();
+        enum dfield_result result = dfield_to_file_encoded(
+                options->scratch_path, dfield, encoding);
+        double written = omp_get_wtime();
+        if (result) {
+            fprintf(
+                    stderr,
+                    "error writing %s: %s\n",
+                    options->scratch_path,
+                    dfield_result_string(result)
+                );
+            return false;
+        }
+
+        struct dfield loaded;
+        result = dfield_from_file(options->scratch_path, &loaded);
+        double read = omp_get_wtime();
+        if (result) {
+            fprintf(
+                    stderr,
+                    "error reading %s: %s\n",
+                    options->scratch_path,
+                    dfield_result_string(result)
+                );
+            return false;
+        }
+        dfield_free(&loaded);
+
+        best_write = fmin(best_write, written - start);
+        best_read = fmin(best_read, read - written);
+    }
+
+    size_t bytes = dfield_data_size(dfield);
+    *file_size_out = file_size(options->scratch_path);
+    printf(
+            "io input=%s algorithm=%s output=%dx%d spread=%d codec=%s "
+            "filter=%s band_rows=%d threads=%d bytes=%zu file_bytes=%ld "
+            "write_seconds=%.6f write_mb_per_s=%.3f read_seconds=%.6f "
+            "read_mb_per_s=%.3f peak_rss_kib=%ld\n",
+            input->name,
+            algorithm_name,
+            (int)dfield->width,
+            (int)dfield->height,
+            (int)spread,
+            codec_names[encoding->codec],
+            filter_names[encoding->filter],
+            (int)encoding->band_rows,
+            (int)encoding->threads,
+            bytes,
+            *file_size_out,
+            best_write,
+            bytes / best_write / 1e6,
+            best_read,
+            bytes / best_read / 1e6,
+            peak_rss_kib()
+        );
+    fflush(stdout);
+    return true;
+}
+
+/* print the sizes of the files a dfield was written to with each codec and
+ * filter the options ask for (in file_sizes, by codec and then filter), and
+ * how much each filter changed the size by, as one line
+ */
+static void print_sizes(
+        const struct bench_options * options,
+        const struct bench_input * input,
+        const char * algorithm_name,
+        int32_t spread,
+        const struct dfield_encoding * encoding,
+        const struct dfield * dfield,
+        const long * file_sizes
+    )
+{
+    printf(
+            "sizes input=%s algorithm=%s output=%dx%d spread=%d "
+            "band_rows=%d threads=%d",
+            input->name,
+            algorithm_name,
+            (int)dfield->width,
+            (int)dfield->height,
+            (int)spread,
+            (int)encoding->band_rows,
+            (int)encoding->threads
+        );
+    size_t n_filters = options->filters.n;
+    for (size_t c = 0; c < options->codecs.n; c++) {
+        const char * codec_name = codec_names[options->codecs.values[c]];
+        long unfiltered = -1;
+        for (size_t f = 0; f < n_filters; f++) {
+            if (options->filters.values[f] == DFIELD_FILTER_NONE) {
+                unfiltered = file_sizes[c * n_filters + f];
+            }
+        }
+        for (size_t f = 0; f < n_filters; f++) {
+            enum dfield_filter filter =
+                (enum dfield_filter)options->filters.values[f];
+            long size = file_sizes[c * n_filters + f];
+            printf(" %s_%s_bytes=%ld", codec_name, filter_names[filter], size);
+            if (filter != DFIELD_FILTER_NONE && unfiltered > 0 && size >= 0) {
+                printf(
+                        " %s_%s_change=%+.1f%%",
+                        codec_name,
+                        filter_names[filter],
+                        100.0 * (size - unfiltered) / unfiltered
+                    );
+            }
+        }
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+/* benchmark writing and reading this dfield with every encoding the options
+ * ask for, printing the sizes of the files for each number of rows per band
+ */
+static bool bench_encodings(
+        const struct bench_options * options,
+        const struct bench_input * input,
+        const char * algorithm_name,
+        int32_t spread,
+        int32_t threads,
+        const struct dfield * dfield
+    )
+{
+    size_t n_filters = options->filters.n;
+    long * file_sizes =
+        malloc(sizeof(*file_sizes) * options->codecs.n * n_filters);
+    if (!file_sizes) {
+        fprintf(stderr, "out of memory\n");
+        return false;
+    }
+
+    bool ok = true;
+    for (size_t b = 0; ok && b < options->band_rows.n; b++) {
+        struct dfield_encoding encoding = {
+            .band_rows = options->band_rows.values[b],
+            .threads = threads
+        };
+        for (size_t c = 0; ok && c < options->codecs.n; c++) {
+            for (size_t f = 0; ok && f < n_filters; f++) {
+                encoding.codec = (enum dfield_codec)options->codecs.values[c];
+                encoding.filter =
+                    (enum dfield_filter)options->filters.values[f];
+                ok = bench_io(
+                        options,
+                        input,
+                        algorithm_name,
+                        spread,
+                        &encoding,
+                        dfield,
+                        &file_sizes[c * n_filters + f]
+                    );
+            }
+        }
+        if (ok) {
+            print_sizes(
+                    options,
+                    input,
+                    algorithm_name,
+                    spread,
+                    &encoding,
+                    dfield,
+                    file_sizes
+                );
+        }
+    }
+
+    free(file_sizes);
+    return ok;
+}
+
+/* run every benchmark the options ask for against this input */
+static bool bench_input(
+        const struct bench_options * options,
+        const struct bench_input * input
+    )
+{
+    for (size_t a = 0; a < options->n_algorithms; a++) {
+        const char * algorithm_name = options->algorithms[a];
+        for (size_t o = 0; o < options->output_sizes.n; o++) {
+            for (size_t s = 0; s < options->spreads.n; s++) {
+                struct dfield_output output = {
+                    .width = options->output_sizes.values[o],
+                    .height = options->output_sizes.values[o],
+                    .spread = options->spreads.values[s]
+                };
+
+                for (size_t t = 0; t < options->threads.n; t++) {
+                    int32_t threads = options->threads.values[t];
+                    omp_set_num_threads(threads);
+                    fprintf(
+                            stderr,
+                            "%s %s %d:%d with %d threads\n",
+                            input->name,
+                            algorithm_name,
+                            (int)output.width,
+                            (int)output.spread,
+                            (int)threads
+                        );
+
+                    double best = INFINITY;
+                    struct dfield dfield = { };
+                    for (int32_t r = 0; r < options->repeats; r++) {
+                        dfield_free(&dfield);
+                        double start = omp_get_wtime();
+                        enum dfield_result result = generate(
+                                input,
+                                algorithm_name,
+                                &output,
+                                options->tile_size,
+                                &dfield
+                            );
+                        double elapsed = omp_get_wtime() - start;
+                        if (result) {
+                            fprintf(
+                                    stderr,
+                                    "error generating with %s: %s\n",
+                                    algorithm_name,
+                                    dfield_result_string(result)
+                                );
+                            return false;
+                        }
+                        best = fmin(best, elapsed);
+                    }
+
+                    double input_texels =
+                        (double)input->width * input->height;
+                    double output_texels =
+                        (double)output.width * output.height;
+                    printf(
+                            "generate input=%s input_size=%dx%d "
+                            "algorithm=%s output=%dx%d spread=%d "
+                            "threads=%d seconds=%.6f "
+                            "input_texels_per_s=%.0f "
+                            "output_texels_per_s=%.0f peak_rss_kib=%ld\n",
+                            input->name,
+                            (int)input->width,
+                            (int)input->height,
+                            algorithm_name,
+                            (int)output.width,
+                            (int)output.height,
+                            (int)output.spread,
+                            (int)threads,
+                            best,
+                            input_texels / best,
+                            output_texels / best,
+                            peak_rss_kib()
+                        );
+                    fflush(stdout);
+
+                    /* banded and multi-threaded LZMA compression depend on
+                     * the thread count too
+                     */
+                    bool ok = bench_encodings(
+                            options,
+                            input,
+                            algorithm_name,
+                            output.spread,
+                            threads,
+                            &dfield
+                        );
+                    dfield_free(&dfield);
+                    if (!ok) {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static struct option long_options[] = {
+    { "output-size", required_argument, 0, 'O' },
+    { "spread", required_argument, 0, 'S' },
+    { "algorithm", required_argument, 0, 'A' },
+    { "threads", required_argument, 0, 'j' },
+    { "codec", required_argument, 0, 'C' },
+    { "filter", required_argument, 0, 'F' },
+    { "band-rows", required_argument, 0, 'R' },
+    { "synthetic", required_argument, 0, 's' },
+    { "input-size", required_argument, 0, 'I' },
+    { "tile-size", required_argument, 0, 'T' },
+    { "repeats", required_argument, 0, 'n' },
+    { "scratch", required_argument, 0, 1000 },
+    { "help", 0, 0, 2000 },
+    { }
+};
+
+int main(int argc, char ** argv)
+{
+    struct bench_options options = {
+        .repeats = 3,
+        .tile_size = 64,
+        .scratch_path = "bench-dfield.tmp"
+    };
+    const char ** algorithms = NULL;
+    int status = 0;
+
+    for (;;) {
+        int index = 0;
+        int c = getopt_long(
+                argc, argv, "O:S:A:j:C:F:R:s:I:T:n:", long_options, &index);
+        if (c == -1) {
+            break;
+        }
+
+        if (c == 'A') {
+            const char ** new_algorithms = realloc(
+                    algorithms,
+                    sizeof(*new_algorithms) * (options.n_algorithms + 1));
+            if (!new_algorithms) {
+                fprintf(stderr, "out of memory\n");
+                status = 1;
+                break;
+            }
+            algorithms = new_algorithms;
+            algorithms[options.n_algorithms++] = optarg;
+            continue;
+        }
+
+        if (c == 'C') {
+            enum dfield_codec codec;
+            if (!dfield_codec_from_name(optarg, &codec)) {
+                fprintf(stderr, "unknown codec %s\n", optarg);
+                status = 1;
+                break;
+            }
+            if (!int_list_add(&options.codecs, codec)) {
+                fprintf(stderr, "out of memory\n");
+                status = 1;
+                break;
+            }
+            continue;
+        }
+
+        if (c == 'F') {
+            enum dfield_filter filter;
+            if (!dfield_filter_from_name(optarg, &filter)) {
+                fprintf(stderr, "unknown filter %s\n", optarg);
+                status = 1;
+                break;
+            }
+            if (!int_list_add(&options.filters, filter)) {
+                fprintf(stderr, "out of memory\n");
+                status = 1;
+                break;
+            }
+            continue;
+        }
+
+        if (c == 1000) {
+            options.scratch_path = optarg;
+            continue;
+        }
+
+        if (c == 2000 || c == '?') {
+            usage();
+            status = 2;
+            break;
+        }
+
+        char * tmp;
+        unsigned long n = strtoul(optarg, &tmp, 0);
+        if (*tmp || (n == 0 && c != 'R') || n > INT32_MAX) {
+            fprintf(stderr, "failed to parse -%c %s\n", c, optarg);
+            status = 1;
+            break;
+        }
+
+        bool ok = true;
+        switch (c) {
+            case 'O':
+                ok = int_list_add(&options.output_sizes, (int32_t)n);
+                break;
+            case 'S':
+                ok = int_list_add(&options.spreads, (int32_t)n);
+                break;
+            case 'j':
+                ok = int_list_add(&options.threads, (int32_t)n);
+                break;
+            case 'R':
+                ok = int_list_add(&options.band_rows, (int32_t)n);
+                break;
+            case 's':
+                ok = int_list_add(&options.synthetic_sizes, (int32_t)n);
+                break;
+            case 'I':
+                options.raw_size = (int32_t)n;
+                break;
+            case 'T':
+                options.tile_size = (int32_t)n;
+                break;
+            case 'n':
+                options.repeats = (int32_t)n;
+                break;
+        }
+        if (!ok) {
+            fprintf(stderr, "out of memory\n");
+            status = 1;
+            break;
+        }
+    }
+
+    /* defaults for anything not given */
+    if (!status && options.output_sizes.n == 0) {
+        status = !int_list_add(&options.output_sizes, 64) ||
+                 !int_list_add(&options.output_sizes, 256);
+    }
+    if (!status && options.spreads.n == 0) {
+        status = !int_list_add(&options.spreads, 8) ||
+                 !int_list_add(&options.spreads, 32);
+    }
+    if (!status && options.threads.n == 0) {
+        status = !int_list_add(&options.threads, omp_get_max_threads());
+    }
+    if (!status && options.codecs.n == 0) {
+        status = !int_list_add(&options.codecs, DFIELD_CODEC_LZMA) ||
+                 !int_list_add(&options.codecs, DFIELD_CODEC_LZ);
+    }
+    if (!status && options.filters.n == 0) {
+        status = !int_list_add(&options.filters, DFIELD_FILTER_NONE) ||
+                 !int_list_add(&options.filters, DFIELD_FILTER_MEDIAN);
+    }
+    if (!status && options.band_rows.n == 0) {
+        status = !int_list_add(&options.band_rows, 0) ||
+                 !int_list_add(&options.band_rows, 64);
+    }
+    if (!status && options.synthetic_sizes.n == 0 && optind == argc) {
+        status = !int_list_add(&options.synthetic_sizes, 1024);
+    }
+    if (options.n_algorithms > 0) {
+        options.algorithms = algorithms;
+    } else {
+        options.algorithms = default_algorithms;
+        options.n_algorithms =
+            sizeof(default_algorithms) / sizeof(*default_algorithms);
+    }
+
+    for (size_t i = 0; !status && i < options.n_algorithms; i++) {
+        enum dfield_algorithm algorithm;
+        if (strcmp(options.algorithms[i], tiled_name) &&
+                !dfield_algorithm_from_name(
+                    options.algorithms[i], &algorithm)) {
+            fprintf(
+                    stderr,
+                    "unknown algorithm %s\n",
+                    options.algorithms[i]
+                );
+            status = 1;
+        }
+    }
+
+    size_t n_inputs = options.synthetic_sizes.n +
+                      (optind < argc ? (size_t)(argc - optind) : 0);
+    for (size_t i = 0; !status && i < n_inputs; i++) {
+        struct bench_input input;
+        bool ok = i < options.synthetic_sizes.n ?
+            synthetic_input(options.synthetic_sizes.values[i], &input) :
+            file_input(
+                    argv[optind + i - options.synthetic_sizes.n],
+                    options.raw_size,
+                    &input
+                );
+        if (!ok) {
+            status = 1;
+            break;
+        }
+
+        if (!bench_input(&options, &input)) {
+            status = 1;
+        }
+        free(input.name);
+        free(input.data);
+    }
+
+    remove(options.scratch_path);
+    free(algorithms);
+    free(options.output_sizes.values);
+    free(options.spreads.values);
+    free(options.threads.values);
+    free(options.synthetic_sizes.values);
+    free(options.codecs.values);
+    free(options.filters.values);
+    free(options.band_rows.values);
+    return status;
+}
@@ -32,44 +32,133 @@ const char * argp_program_bug_address =
     "<beka.krupp@gmail.com>";
 
 static char doc[] =
-    "generate-dfield -- generate .dfield files from .dat files";
+    "generate-dfield -- generate .dfield files from images"
+    "\v"
+    "INPUT_FILE may be a PNG (of which the alpha channel is used if there is "
+    "one, and the gray level otherwise), a binary PGM, or raw 8-bit data. "
+    "Images know their size, so --input-size is only needed for raw data.\n\n"
+    "Output sizes may be given more than once to generate several fields from "
+    "one pass over the input. Unless --mipmaps is given, OUTPUT_FILE must then "
+    "contain %w or %h, which are replaced with the width and height of each "
+    "output (%% for a literal %).\n\n"
+    "The msdf algorithm writes multi-channel fields, which keep corners sharp "
+    "at a fraction of the size. The coverage algorithm reads INPUT_FILE as "
+    "anti-aliased coverage, which gives accurate fields from a much smaller "
+    "rasterization.\n\n"
+    "With --vector, INPUT_FILE is an SVG document (of which only the drawn "
+    "<path> elements are used, filled, and which may not have transforms) or "
+    "bare SVG path data, and the fields are generated straight from its "
+    "outlines. The input size is then the size the view box (or, for bare "
+    "path data, the coordinates) are taken to be in texels.\n\n"
+    "With --batch, each non-blank line of MANIFEST not starting with # is a "
+    "job of the form OUTPUT_FILE INPUT_FILE [OPTION]... (separated by "
+    "whitespace). The options on the command line apply to every job, with "
+    "those on the line added to them (for output sizes) or overriding them "
+    "(for everything else). The jobs are run in parallel and their timings "
+    "are printed when they finish.\n\n"
+    "With --cache, a job whose input file and options match one run before "
+    "copies that job's outputs out of DIRECTORY instead, and how many jobs "
+    "did so is printed at the end.";
 
 static char args_doc[] =
-    "OUTPUT_FILE INPUT_FILE";
+    "OUTPUT_FILE INPUT_FILE\n"
+    "--batch=MANIFEST";
 
 static struct argp_option options[] = {
-    { "output-size", 'O', "SIZE", 0,
-        "set both the width and height of the output file" },
+    { "output-size", 'O', "SIZE[:SPREAD]", 0,
+        "add an output with this width and height (and optionally spread)" },
     { "input-size", 'I', "SIZE", 0,
-        "set both the width and height of the input file" },
+        "set both the width and height of the input file (needed for raw "
+        "data)" },
     { "output-width", 1000, "WIDTH", 0,
-        "set the width of the output file" },
+        "set the width of the last output (adding one if there are none)" },
     { "output-height", 1001, "HEIGHT", 0,
-        "set the height of the output file" },
+        "set the height of the last output (adding one if there are none)" },
     { "input-width", 1002, "WIDTH", 0,
         "set the width of the input file" },
     { "input-height", 1003, "HEIGHT", 0,
         "set the height of the input file" },
     { "spread", 'S', "SPREAD", 0,
         "set the spread" },
+    { "algorithm", 'A', "ALGORITHM", 0,
+        "set the algorithm (brute-force, edt, bitplane, msdf, or coverage; "
+        "default: brute-force)" },
+    { "codec", 'C', "CODEC", 0,
+        "set how the outputs are compressed (lzma, the smallest, or lz, "
+        "which is much faster to load; default: lzma)" },
+    { "filter", 'F', "FILTER", 0,
+        "set how the outputs are filtered before they are compressed (none, "
+        "or median, which makes LZMA files of large, clean fields smaller "
+        "but can make others larger; default: none)" },
+    { "band-rows", 'R', "ROWS", 0,
+        "compress the outputs in bands of this many rows, which are written "
+        "and loaded in parallel" },
+    { "bc4", '4', 0, 0,
+        "write the outputs block compressed as BC4, which the renderer keeps "
+        "compressed in memory (not with the msdf algorithm)" },
+    { "mipmaps", 'M', 0, 0,
+        "write the outputs as the mip levels of one file (each must be half "
+        "the size of the last)" },
+    { "vector", 'V', 0, 0,
+        "read INPUT_FILE as SVG path outlines instead of raw data" },
+    { "white-transparent", 'W', 0, 0,
+        "read opaque white in a PNG INPUT_FILE with alpha as transparent, so "
+        "that a white background counts as off" },
+    { "tile-size", 'T', "SIZE", 0,
+        "stream the input instead of loading all of it, generating the output "
+        "in tiles of this size (same output as brute-force)" },
+    { "batch", 'B', "MANIFEST", 0,
+        "run each job listed in MANIFEST instead of OUTPUT_FILE INPUT_FILE" },
+    { "cache", 'K', "DIRECTORY", 0,
+        "keep the outputs in DIRECTORY under a hash of the input and options, "
+        "and copy them from there instead of generating them again" },
     { }
 };
 
+/* add an output of this size and spread to args */
+static void add_output(
+        struct argp_state * state,
+        struct arguments * args,
+        int32_t width,
+        int32_t height,
+        int32_t spread
+    )
+{
+    struct dfield_output * outputs = realloc(
+            args->outputs, sizeof(*outputs) * (args->n_outputs + 1));
+    if (!outputs) {
+        argp_failure(state, 1, 0, "out of memory adding an output");
+        return;
+    }
+    outputs[args->n_outputs++] = (struct dfield_output) {
+        .width = width,
+        .height = height,
+        .spread = spread
+    };
+    args->outputs = outputs;
+}
+
 static error_t parse_opt(int key, char * argv, struct argp_state * state)
 {
     struct arguments * args = state->input;
 
     char * tmp;
-    unsigned long n;
+    unsigned long n, m;
 
     switch (key) {
         case 'O':
             n = strtoul(argv, &tmp, 0);
+            m = 0;
+            if (*tmp == ':') {
+                m = strtoul(tmp + 1, &tmp, 0);
+                if (m == 0 || m > INT32_MAX) {
+                    argp_failure(state, 1, 0, "failed to parse --output-size=%s", argv);
+                }
+            }
             if (*tmp || n == 0 || n > INT32_MAX) {
                 argp_failure(state, 1, 0, "failed to parse --output-size=%s", argv);
             }
-            args->output_width = (int32_t)n;
-            args->output_height = (int32_t)n;
+            add_output(state, args, (int32_t)n, (int32_t)n, (int32_t)m);
             break;
 
         case 'I':
@@ -86,7 +175,10 @@ static error_t parse_opt(int key, char * argv, struct argp_state * state)
             if (*tmp || n == 0 || n > INT32_MAX) {
                 argp_failure(state, 1, 0, "failed to parse --output-width=%s", argv);
             }
-            args->output_width = (int32_t)n;
+            if (args->n_outputs == 0) {
+                add_output(state, args, 0, 0, 0);
+            }
+            args->outputs[args->n_outputs - 1].width = (int32_t)n;
             break;
 
         case 1001:
@@ -94,7 +186,10 @@ static error_t parse_opt(int key, char * argv, struct argp_state * state)
             if (*tmp || n == 0 || n > INT32_MAX) {
                 argp_failure(state, 1, 0, "failed to parse --output-height=%s", argv);
             }
-            args->output_height = (int32_t)n;
+            if (args->n_outputs == 0) {
+                add_output(state, args, 0, 0, 0);
+            }
+            args->outputs[args->n_outputs - 1].height = (int32_t)n;
             break;
 
         case 1002:
@@ -121,6 +216,66 @@ static error_t parse_opt(int key, char * argv, struct argp_state * state)
             args->spread = (int32_t)n;
             break;
 
+        case 'A':
+            if (!dfield_algorithm_from_name(argv, &args->algorithm)) {
+                argp_failure(state, 1, 0, "failed to parse --algorithm=%s", argv);
+            }
+            break;
+
+        case 'C':
+            if (!dfield_codec_from_name(argv, &args->codec)) {
+                argp_failure(state, 1, 0, "failed to parse --codec=%s", argv);
+            }
+            break;
+
+        case 'F':
+            if (!dfield_filter_from_name(argv, &args->filter)) {
+                argp_failure(state, 1, 0, "failed to parse --filter=%s", argv);
+            }
+            break;
+
+        case 'R':
+            n = strtoul(argv, &tmp, 0);
+            if (*tmp || n == 0 || n > INT32_MAX) {
+                argp_failure(state, 1, 0, "failed to parse --band-rows=%s", argv);
+            }
+            args->band_rows = (int32_t)n;
+            break;
+
+        case '4':
+            args->bc4 = true;
+            break;
+
+        case 'M':
+            args->mipmaps = true;
+            break;
+
+        case 'V':
+            args->vector = true;
+            break;
+
+        case 'W':
+            args->white_transparent = true;
+            break;
+
+        case 'T':
+            n = strtoul(argv, &tmp, 0);
+            if (*tmp || n == 0 || n > INT32_MAX) {
+                argp_failure(state, 1, 0, "failed to parse --tile-size=%s", argv);
+            }
+            args->tile_size = (int32_t)n;
+            break;
+
+        case 'B':
+            free(args->batch_path);
+            args->batch_path = util_strdup(argv);
+            break;
+
+        case 'K':
+            free(args->cache_path);
+            args->cache_path = util_strdup(argv);
+            break;
+
         case ARGP_KEY_ARG:
             if (!args->output_path) {
                 args->output_path = util_strdup(argv);
@@ -133,7 +288,9 @@ static error_t parse_opt(int key, char * argv, struct argp_state * state)
             break;
 
         case ARGP_KEY_END:
-            if (!args->output_path || !args->input_path) {
+            /* a batch takes the place of OUTPUT_FILE INPUT_FILE */
+            if (args->batch_path ? args->output_path != NULL :
+                    !args->output_path || !args->input_path) {
                 argp_usage(state);
                 return 1;
             }
@@ -142,6 +299,13 @@ static error_t parse_opt(int key, char * argv, struct argp_state * state)
         case ARGP_KEY_ERROR:
             free(args->output_path);
             free(args->input_path);
+            free(args->batch_path);
+            free(args->outputs);
+            args->output_path = NULL;
+            args->input_path = NULL;
+            args->batch_path = NULL;
+            args->outputs = NULL;
+            args->n_outputs = 0;
             break;
         default:
             return ARGP_ERR_UNKNOWN;
@@ -28,13 +28,49 @@
 
 static void usage()
 {
-    fprintf(stderr, "Usage: generate-dfield [--help] [-O|--output-size SIZE] [-I|--input-size SIZE] [-S|--spread SIZE] OUTPUT_FILE INPUT_FILE\n");
+    fprintf(stderr, "Usage: generate-dfield [--help] [-O|--output-size SIZE[:SPREAD]]... [-I|--input-size SIZE] [-S|--spread SIZE] [-A|--algorithm ALGORITHM] [-C|--codec CODEC] [-F|--filter FILTER] [-R|--band-rows ROWS] [-4|--bc4] [-M|--mipmaps] [-V|--vector] [-W|--white-transparent] [-T|--tile-size SIZE] [-K|--cache DIRECTORY] (OUTPUT_FILE INPUT_FILE | -B|--batch MANIFEST)\n");
+}
+
+/* add an output of this size and spread to args, returning false if we ran
+ * out of memory
+ */
+static bool add_output(
+        struct arguments * args,
+        int32_t width,
+        int32_t height,
+        int32_t spread
+    )
+{
+    struct dfield_output * outputs = realloc(
+            args->outputs, sizeof(*outputs) * (args->n_outputs + 1));
+    if (!outputs) {
+        fprintf(stderr, "out of memory adding an output\n");
+        return false;
+    }
+    outputs[args->n_outputs++] = (struct dfield_output) {
+        .width = width,
+        .height = height,
+        .spread = spread
+    };
+    args->outputs = outputs;
+    return true;
 }
 
 static struct option options[] = {
     { "output-size", required_argument, 0, 'O' },
     { "input-size", required_argument, 0, 'I' },
     { "spread", required_argument, 0, 'S' },
+    { "algorithm", required_argument, 0, 'A' },
+    { "codec", required_argument, 0, 'C' },
+    { "filter", required_argument, 0, 'F' },
+    { "band-rows", required_argument, 0, 'R' },
+    { "bc4", no_argument, 0, '4' },
+    { "mipmaps", no_argument, 0, 'M' },
+    { "vector", no_argument, 0, 'V' },
+    { "white-transparent", no_argument, 0, 'W' },
+    { "tile-size", required_argument, 0, 'T' },
+    { "batch", required_argument, 0, 'B' },
+    { "cache", required_argument, 0, 'K' },
     { "output-width", required_argument, 0, 1000 },
     { "output-height", required_argument, 0, 1001 },
     { "input-width", required_argument, 0, 1002 },
@@ -46,26 +82,38 @@ static struct option options[] = {
 int parse_args(
         struct arguments * args, int argc, char ** argv) [[gnu::nonnull(1)]]
 {
+    /* start over, in case we're parsing a line of a batch manifest */
+    optind = 0;
+
     while (1) {
         int index = 0;
-        int c = getopt_long(argc, argv, "O:I:S:", options, &index);
+        int c = getopt_long(argc, argv, "O:I:S:A:C:F:R:4MVWT:B:K:", options, &index);
 
         if (c == -1) {
             break;
         }
 
         char * tmp;
-        unsigned long n;
+        unsigned long n, m;
 
         switch (c) {
             case 'O':
                 n = strtoul(optarg, &tmp, 0);
+                m = 0;
+                if (*tmp == ':') {
+                    m = strtoul(tmp + 1, &tmp, 0);
+                    if (m == 0 || m > INT32_MAX) {
+                        fprintf(stderr, "failed to parse --output-size=%s", optarg);
+                        return 1;
+                    }
+                }
                 if (*tmp || n == 0 || n > INT32_MAX) {
                     fprintf(stderr, "failed to parser --output-size=%s", optarg);
                     return 1;
                 }
-                args->output_width = (int32_t)n;
-                args->output_height = (int32_t)n;
+                if (!add_output(args, (int32_t)n, (int32_t)n, (int32_t)m)) {
+                    return 1;
+                }
                 break;
 
             case 'I':
@@ -82,7 +130,10 @@ int parse_args(
                     if (*tmp || n == 0 || n > INT32_MAX) {
                         fprintf(stderr, "failed to parse --output-width=%s", optarg);
                     }
-                args->output_width = (int32_t)n;
+                if (args->n_outputs == 0 && !add_output(args, 0, 0, 0)) {
+                    return 1;
+                }
+                args->outputs[args->n_outputs - 1].width = (int32_t)n;
                 break;
 
             case 1001:
@@ -90,7 +141,10 @@ int parse_args(
                     if (*tmp || n == 0 || n > INT32_MAX) {
                         fprintf(stderr, "failed to parse --output-height=%s", optarg);
                     }
-                args->output_height = (int32_t)n;
+                if (args->n_outputs == 0 && !add_output(args, 0, 0, 0)) {
+                    return 1;
+                }
+                args->outputs[args->n_outputs - 1].height = (int32_t)n;
                 break;
 
             case 1002:
@@ -117,6 +171,71 @@ int parse_args(
                 args->spread = (int32_t)n;
                 break;
 
+            case 'A':
+                if (!dfield_algorithm_from_name(optarg, &args->algorithm)) {
+                    fprintf(stderr, "failed to parse --algorithm=%s", optarg);
+                    return 1;
+                }
+                break;
+
+            case 'C':
+                if (!dfield_codec_from_name(optarg, &args->codec)) {
+                    fprintf(stderr, "failed to parse --codec=%s", optarg);
+                    return 1;
+                }
+                break;
+
+            case 'F':
+                if (!dfield_filter_from_name(optarg, &args->filter)) {
+                    fprintf(stderr, "failed to parse --filter=%s", optarg);
+                    return 1;
+                }
+                break;
+
+            case 'R':
+                n = strtoul(optarg, &tmp, 0);
+                if (*tmp || n == 0 || n > INT32_MAX) {
+                    fprintf(stderr, "failed to parse --band-rows=%s", optarg);
+                    return 1;
+                }
+                args->band_rows = (int32_t)n;
+                break;
+
+            case '4':
+                args->bc4 = true;
+                break;
+
+            case 'M':
+                args->mipmaps = true;
+                break;
+
+            case 'V':
+                args->vector = true;
+                break;
+
+            case 'W':
+                args->white_transparent = true;
+                break;
+
+            case 'T':
+                n = strtoul(optarg, &tmp, 0);
+                if (*tmp || n == 0 || n > INT32_MAX) {
+                    fprintf(stderr, "failed to parse --tile-size=%s", optarg);
+                    return 1;
+                }
+                args->tile_size = (int32_t)n;
+                break;
+
+            case 'B':
+                free(args->batch_path);
+                args->batch_path = util_strdup(optarg);
+                break;
+
+            case 'K':
+                free(args->cache_path);
+                args->cache_path = util_strdup(optarg);
+                break;
+
             case 2000:
             case '?':
                 usage();
@@ -127,6 +246,15 @@ int parse_args(
         }
     }
 
+    /* a batch takes the place of OUTPUT_FILE INPUT_FILE */
+    if (args->batch_path) {
+        if (optind != argc) {
+            usage();
+            return 1;
+        }
+        return 0;
+    }
+
     if (optind + 2 != argc) {
         usage();
         return 1;
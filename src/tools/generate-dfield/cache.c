@@ -0,0 +1,342 @@
+/* File: src/tools/generate-dfield/cache.c
+ * Part of snrkos <github.com/rmkrupp/snrkos>
+ *
+ * Copyright (C) 2025 Noah Santer <n.ed.santer@gmail.com>
+ * Copyright (C) 2025 Rebecca Krupp <beka.krupp@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "tools/generate-dfield/cache.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#include <process.h>
+#include <share.h>
+#else
+#include <unistd.h>
+#endif /* _WIN32 */
+
+/* how much of a file to read (or copy) at once */
+constexpr size_t cache_buffer_size = 64 * 1024;
+
+/* how many names for a temporary file to try before giving up */
+constexpr int cache_max_attempts = 1000;
+
+/* a temporary file this old (in seconds) was left behind by a store that
+ * didn't finish, since none takes anywhere near this long
+ */
+constexpr time_t cache_stale_seconds = 60 * 60;
+
+/* has this process removed the stale temporary files from its cache yet? */
+static atomic_flag cache_swept = ATOMIC_FLAG_INIT;
+
+/* start a new key */
+void cache_key_init(struct cache_key * key) [[gnu::nonnull(1)]]
+{
+    /* the FNV-128 offset basis */
+    key->hash = ((unsigned __int128)0x6c62272e07bb0142 << 64) |
+        0x62b821756295c58d;
+}
+
+/* add these size bytes to this key */
+void cache_key_add(
+        struct cache_key * key,
+        const void * data,
+        size_t size
+    ) [[gnu::nonnull(1, 2)]]
+{
+    /* the FNV-128 prime, 2^88 + 2^8 + 0x3b */
+    const unsigned __int128 prime =
+        ((unsigned __int128)1 << 88) | ((unsigned __int128)1 << 8) | 0x3b;
+
+    const uint8_t * bytes = data;
+    unsigned __int128 hash = key->hash;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= prime;
+    }
+    key->hash = hash;
+}
+
+/* add the contents of the file at this path to this key
+ *
+ * returns false (setting errno) if the file couldn't be read
+ */
+bool cache_key_add_file(
+        struct cache_key * key, const char * path) [[gnu::nonnull(1, 2)]]
+{
+    FILE * file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+
+    uint8_t * buffer = malloc(cache_buffer_size);
+    if (!buffer) {
+        fclose(file);
+        return false;
+    }
+
+    size_t rd;
+    while ((rd = fread(buffer, 1, cache_buffer_size, file)) > 0) {
+        cache_key_add(key, buffer, rd);
+    }
+
+    bool okay = !ferror(file);
+    free(buffer);
+    fclose(file);
+    return okay;
+}
+
+/* put the path of this key's entry in the cache in this directory, with this
+ * suffix, in a new string
+ */
+static char * entry_path(
+        const char * directory,
+        const struct cache_key * key,
+        const char * suffix
+    )
+{
+    char name[33];
+    for (int i = 0; i < 32; i++) {
+        name[i] = "0123456789abcdef"[(key->hash >> (124 - 4 * i)) & 0xf];
+    }
+    name[32] = '\0';
+
+    size_t size = strlen(directory) + 1 + sizeof(name) + strlen(suffix);
+    char * path = malloc(size);
+    if (!path) {
+        return NULL;
+    }
+    snprintf(path, size, "%s/%s%s", directory, name, suffix);
+    return path;
+}
+
+/* copy the rest of in to out
+ *
+ * returns false on error
+ */
+static bool copy_file(FILE * in, FILE * out)
+{
+    uint8_t * buffer = malloc(cache_buffer_size);
+    if (!buffer) {
+        return false;
+    }
+
+    size_t rd;
+    bool okay = true;
+    while (okay && (rd = fread(buffer, 1, cache_buffer_size, in)) > 0) {
+        okay = fwrite(buffer, 1, rd, out) == rd;
+    }
+
+    free(buffer);
+    return okay && !ferror(in);
+}
+
+/* if the cache in this directory has an entry for this key, copy it to path
+ *
+ * returns true on a hit, and false on a miss (or if the copy failed)
+ */
+bool cache_fetch(
+        const char * directory,
+        const struct cache_key * key,
+        const char * path
+    ) [[gnu::nonnull(1, 2, 3)]]
+{
+    char * cached_path = entry_path(directory, key, ".dfield");
+    if (!cached_path) {
+        return false;
+    }
+
+    FILE * in = fopen(cached_path, "rb");
+    free(cached_path);
+    if (!in) {
+        return false;
+    }
+
+    FILE * out = fopen(path, "wb");
+    if (!out) {
+        fclose(in);
+        return false;
+    }
+
+    bool okay = copy_file(in, out);
+    fclose(in);
+    if (fclose(out)) {
+        okay = false;
+    }
+    return okay;
+}
+
+/* remove the temporary files in the cache in this directory that were left
+ * behind by stores that didn't finish (because their process crashed or was
+ * killed)
+ */
+static void remove_stale_temporaries(const char * directory)
+{
+    DIR * dir = opendir(directory);
+    if (!dir) {
+        return;
+    }
+
+    time_t now = time(NULL);
+    struct dirent * entry;
+    while ((entry = readdir(dir))) {
+        size_t length = strlen(entry->d_name);
+        if (length < 4 || strcmp(&entry->d_name[length - 4], ".tmp")) {
+            continue;
+        }
+
+        size_t size = strlen(directory) + 1 + length + 1;
+        char * path = malloc(size);
+        if (!path) {
+            break;
+        }
+        snprintf(path, size, "%s/%s", directory, entry->d_name);
+
+        struct stat info;
+        if (!stat(path, &info) && now - info.st_mtime > cache_stale_seconds) {
+            remove(path);
+        }
+        free(path);
+    }
+
+    closedir(dir);
+}
+
+/* create the file at path for writing, failing (with errno EEXIST) if it
+ * already exists
+ */
+static FILE * create_exclusive(const char * path)
+{
+#ifdef _WIN32
+    int fd;
+    if (_sopen_s(
+                &fd,
+                path,
+                _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY,
+                _SH_DENYNO,
+                _S_IREAD | _S_IWRITE
+            )) {
+        return NULL;
+    }
+    FILE * file = _fdopen(fd, "wb");
+    if (!file) {
+        _close(fd);
+    }
+#else
+    int fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0666);
+    if (fd < 0) {
+        return NULL;
+    }
+    FILE * file = fdopen(fd, "wb");
+    if (!file) {
+        close(fd);
+    }
+#endif /* _WIN32 */
+    return file;
+}
+
+/* store a copy of the file at path in the cache in this directory (creating
+ * it if it doesn't exist) under this key. entries appear whole or not at all,
+ * so many processes (or threads) can share a cache
+ *
+ * returns false (setting errno) on error
+ */
+bool cache_store(
+        const char * directory,
+        const struct cache_key * key,
+        const char * path
+    ) [[gnu::nonnull(1, 2, 3)]]
+{
+#ifdef _WIN32
+    if (_mkdir(directory) && errno != EEXIST) {
+#else
+    if (mkdir(directory, 0777) && errno != EEXIST) {
+#endif /* _WIN32 */
+        return false;
+    }
+
+    if (!atomic_flag_test_and_set(&cache_swept)) {
+        remove_stale_temporaries(directory);
+    }
+
+    FILE * in = fopen(path, "rb");
+    if (!in) {
+        return false;
+    }
+
+    /* the copy is written to a temporary file of its own and then renamed
+     * into place, so that nothing ever sees a partial entry. the name has
+     * the process ID in it, so other processes never compete for it, and
+     * the attempt number, so that threads of this one don't either
+     */
+#ifdef _WIN32
+    long pid = (long)_getpid();
+#else
+    long pid = (long)getpid();
+#endif /* _WIN32 */
+    char * cached_path = entry_path(directory, key, ".dfield");
+    char * temporary_path = NULL;
+    FILE * out = NULL;
+    for (int attempt = 0; cached_path && !out &&
+            attempt < cache_max_attempts; attempt++) {
+        char suffix[48];
+        snprintf(suffix, sizeof(suffix), ".%ld.%d.tmp", pid, attempt);
+        free(temporary_path);
+        temporary_path = entry_path(directory, key, suffix);
+        if (!temporary_path) {
+            break;
+        }
+        out = create_exclusive(temporary_path);
+        if (!out && errno != EEXIST) {
+            break;
+        }
+    }
+
+    if (!out) {
+        free(temporary_path);
+        free(cached_path);
+        fclose(in);
+        return false;
+    }
+
+    bool okay = copy_file(in, out);
+    fclose(in);
+    if (fclose(out)) {
+        okay = false;
+    }
+
+    /* on some systems rename won't replace an existing file, but an existing
+     * entry is as good as this one
+     */
+    if (!okay || rename(temporary_path, cached_path)) {
+        remove(temporary_path);
+    }
+
+    free(temporary_path);
+    free(cached_path);
+    return okay;
+}
@@ -20,95 +20,852 @@
  */
 #include "dfield.h"
 #include "tools/generate-dfield/args.h"
+#include "tools/generate-dfield/cache.h"
+#include "tools/generate-dfield/image.h"
+#include "tools/generate-dfield/svg.h"
 
+#include "util/strdup.h"
+
+#include <errno.h>
+#include <omp.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+/* the version of what generate-dfield writes for a given input and options,
+ * which is part of every cache key. bump this whenever a change to the
+ * generators or the file format changes the output, so that old entries
+ * stop being hit
+ */
+constexpr uint32_t cache_version = 2;
 
 static void free_args(struct arguments * args)
 {
     free(args->input_path);
     free(args->output_path);
+    free(args->batch_path);
+    free(args->cache_path);
+    free(args->outputs);
 }
 
-int main(int argc, char ** argv)
+/* expand %w and %h in this output path pattern to this width and height (and
+ * %% to %), returning a new string (or NULL if we ran out of memory)
+ */
+static char * expand_output_path(
+        const char * pattern, int32_t width, int32_t height)
 {
-    struct arguments args = { };
+    /* the first pass measures and the second writes */
+    char * path = NULL;
+    size_t length = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        size_t at = 0;
+        for (const char * c = pattern; *c; c++) {
+            char number[16];
+            const char * piece = number;
+            if (c[0] == '%' && c[1] == 'w') {
+                snprintf(number, sizeof(number), "%d", (int)width);
+                c++;
+            } else if (c[0] == '%' && c[1] == 'h') {
+                snprintf(number, sizeof(number), "%d", (int)height);
+                c++;
+            } else if (c[0] == '%' && c[1] == '%') {
+                piece = "%";
+                c++;
+            } else {
+                number[0] = *c;
+                number[1] = '\0';
+            }
+            size_t piece_length = strlen(piece);
+            if (path) {
+                memcpy(&path[at], piece, piece_length);
+            }
+            at += piece_length;
+        }
+        if (path) {
+            path[at] = '\0';
+        } else {
+            length = at;
+            path = malloc(length + 1);
+            if (!path) {
+                return NULL;
+            }
+        }
+    }
+    return path;
+}
 
-    int parse_result;
-    if ((parse_result = parse_args(&args, argc, argv))) {
-        free_args(&args);
-        return parse_result;
+/* does this output path pattern contain %w or %h? */
+static bool output_path_is_pattern(const char * pattern)
+{
+    for (const char * c = pattern; *c; c++) {
+        if (c[0] == '%' && (c[1] == 'w' || c[1] == 'h')) {
+            return true;
+        }
+        if (c[0] == '%' && c[1] == '%') {
+            c++;
+        }
     }
+    return false;
+}
+
+/* qsort comparison putting the largest outputs first */
+static int compare_outputs(const void * a, const void * b)
+{
+    const struct dfield_output * output_a = a;
+    const struct dfield_output * output_b = b;
+    if (output_a->width != output_b->width) {
+        return output_a->width > output_b->width ? -1 : 1;
+    }
+    if (output_a->height != output_b->height) {
+        return output_a->height > output_b->height ? -1 : 1;
+    }
+    return 0;
+}
+
+/* open the input file named by args, which may be a PNG, a PGM, or raw data
+ * (whose size args must then give), and put it in input_out
+ *
+ * returns 0 on success and non-zero on error, having printed the reason
+ */
+static int open_input(
+        const struct arguments * args,
+        struct dfield_input ** input_out
+    ) [[gnu::nonnull(1, 2)]]
+{
+    enum dfield_result result = DFIELD_RESULT_OKAY;
+    enum image_kind kind = image_kind_of_file(args->input_path);
+    switch (kind) {
+        case IMAGE_KIND_PNG:
+            result = image_input_open_png(
+                    args->input_path, args->white_transparent, input_out);
+            break;
+
+        case IMAGE_KIND_PGM:
+            result = dfield_input_open_pgm(args->input_path, input_out);
+            break;
 
-    if (args.input_width == 0 || args.input_height == 0) {
+        case IMAGE_KIND_RAW:
+            if (args->input_width == 0 || args->input_height == 0) {
+                fprintf(stderr, "input size not specified (no default)\n");
+                return 1;
+            }
+            result = dfield_input_open_raw(
+                    args->input_path,
+                    args->input_width,
+                    args->input_height,
+                    input_out
+                );
+            break;
+    }
+
+    if (result) {
+        fprintf(
+                stderr,
+                "error opening input file %s: %s\n",
+                args->input_path,
+                dfield_result_string(result)
+            );
+        return 1;
+    }
+
+    /* images know their own size, but it had better match any we were
+     * given
+     */
+    int32_t width, height;
+    dfield_input_size(*input_out, &width, &height);
+    if ((args->input_width && args->input_width != width) ||
+            (args->input_height && args->input_height != height)) {
+        fprintf(
+                stderr,
+                "input file %s is %dx%d, which doesn't match the input size given\n",
+                args->input_path,
+                (int)width,
+                (int)height
+            );
+        dfield_input_close(*input_out);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* how long each stage of a job took, in seconds (when reading the input in
+ * tiles, load is only the time taken to open it)
+ */
+struct job_timing {
+    double load, generate, write;
+    bool cached; /* the outputs were copied out of the cache, taking write */
+};
+
+/* put the cache key of the job these arguments (the outputs of which have
+ * been filled in) describe in key: a hash of everything that decides what it
+ * writes
+ *
+ * returns false (setting errno) if the input file couldn't be read
+ */
+static bool job_cache_key(
+        const struct arguments * args,
+        struct cache_key * key
+    ) [[gnu::nonnull(1, 2)]]
+{
+    int32_t options[] = {
+        (int32_t)cache_version,
+        args->input_width,
+        args->input_height,
+        (int32_t)args->algorithm,
+        (int32_t)args->codec,
+        (int32_t)args->filter,
+        args->band_rows,
+        args->bc4,
+        args->mipmaps,
+        args->vector,
+        args->white_transparent,
+        args->tile_size,
+        (int32_t)args->n_outputs
+    };
+    cache_key_init(key);
+    cache_key_add(key, options, sizeof(options));
+    for (size_t i = 0; i < args->n_outputs; i++) {
+        int32_t output[] = {
+            args->outputs[i].width,
+            args->outputs[i].height,
+            args->outputs[i].spread
+        };
+        cache_key_add(key, output, sizeof(output));
+    }
+    return cache_key_add_file(key, args->input_path);
+}
+
+/* the number of files the job these arguments describe writes */
+static size_t job_n_files(const struct arguments * args) [[gnu::nonnull(1)]]
+{
+    return args->mipmaps ? 1 : args->n_outputs;
+}
+
+/* the path of the ith file the job these arguments describe writes, in a new
+ * string (or NULL if we ran out of memory)
+ */
+static char * job_file_path(
+        const struct arguments * args, size_t i) [[gnu::nonnull(1)]]
+{
+    return args->mipmaps ?
+        util_strdup(args->output_path) :
+        expand_output_path(
+                args->output_path,
+                args->outputs[i].width,
+                args->outputs[i].height
+            );
+}
+
+/* the cache key of the ith file of a job whose key is key */
+static struct cache_key job_file_cache_key(
+        const struct cache_key * key, size_t i) [[gnu::nonnull(1)]]
+{
+    struct cache_key file_key = *key;
+    uint64_t index = i;
+    cache_key_add(&file_key, &index, sizeof(index));
+    return file_key;
+}
+
+/* copy every file the job these arguments describe writes out of the cache,
+ * given its key
+ *
+ * returns true if they were all there
+ */
+static bool job_fetch(
+        const struct arguments * args,
+        const struct cache_key * key
+    ) [[gnu::nonnull(1, 2)]]
+{
+    for (size_t i = 0; i < job_n_files(args); i++) {
+        char * path = job_file_path(args, i);
+        if (!path) {
+            return false;
+        }
+        struct cache_key file_key = job_file_cache_key(key, i);
+        bool hit = cache_fetch(args->cache_path, &file_key, path);
+        free(path);
+        if (!hit) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* store every file the job these arguments describe wrote in the cache,
+ * given its key, printing a warning (but carrying on) if that fails
+ */
+static void job_store(
+        const struct arguments * args,
+        const struct cache_key * key
+    ) [[gnu::nonnull(1, 2)]]
+{
+    for (size_t i = 0; i < job_n_files(args); i++) {
+        char * path = job_file_path(args, i);
+        if (!path) {
+            fprintf(stderr, "out of memory\n");
+            return;
+        }
+        struct cache_key file_key = job_file_cache_key(key, i);
+        if (!cache_store(args->cache_path, &file_key, path)) {
+            fprintf(
+                    stderr,
+                    "(WARNING) error storing %s in cache %s: %s\n",
+                    path,
+                    args->cache_path,
+                    strerror(errno)
+                );
+        }
+        free(path);
+    }
+}
+
+/* generate the dfields described by these arguments and write them out,
+ * putting how long that took in timing
+ *
+ * returns 0 on success and non-zero on error, having printed the reason
+ */
+static int run_job(
+        struct arguments * args,
+        struct job_timing * timing
+    ) [[gnu::nonnull(1, 2)]]
+{
+    if (args->vector && (args->input_width == 0 || args->input_height == 0)) {
         fprintf(stderr, "input size not specified (no default)\n");
-        free_args(&args);
         return 1;
     }
 
-    if (args.output_width == 0 || args.output_height == 0) {
+    if (args->n_outputs == 0) {
         fprintf(stderr, "output size not specified (no default)\n");
-        free_args(&args);
         return 1;
     }
 
-    if (args.spread == 0) {
-        fprintf(stderr, "spread not specified (no default)\n");
-        free_args(&args);
+    for (size_t i = 0; i < args->n_outputs; i++) {
+        if (args->outputs[i].width == 0 || args->outputs[i].height == 0) {
+            fprintf(stderr, "output size not specified (no default)\n");
+            return 1;
+        }
+
+        if (args->outputs[i].spread == 0) {
+            args->outputs[i].spread = args->spread;
+        }
+
+        if (args->outputs[i].spread == 0) {
+            fprintf(stderr, "spread not specified (no default)\n");
+            return 1;
+        }
+    }
+
+    if (args->mipmaps) {
+        qsort(args->outputs, args->n_outputs, sizeof(*args->outputs),
+              compare_outputs);
+    } else if (args->n_outputs > 1 &&
+            !output_path_is_pattern(args->output_path)) {
+        fprintf(
+                stderr,
+                "output file must contain %%w or %%h when there is more than one output size (or pass --mipmaps)\n"
+            );
         return 1;
     }
 
-    uint8_t * data;
-    enum dfield_result result;
-    if ((result = dfield_data_from_file(
-                args.input_path,
-                args.input_width,
-                args.input_height,
-                &data))) {
+    if (args->tile_size && args->algorithm != DFIELD_ALGORITHM_BRUTE_FORCE &&
+            args->algorithm != DFIELD_ALGORITHM_BITPLANE) {
         fprintf(
                 stderr,
-                "error reading input data from file %s: %s\n",
-                args.input_path,
-                dfield_result_string(result)
+                "--tile-size can only be used with the brute-force or bitplane algorithms\n"
             );
-        free_args(&args);
         return 1;
     }
 
-    struct dfield dfield;
-    if ((result = dfield_generate(
+    if (args->bc4 && args->algorithm == DFIELD_ALGORITHM_MSDF) {
+        fprintf(stderr, "--bc4 can't be used with the msdf algorithm\n");
+        return 1;
+    }
+
+    if (args->tile_size && args->vector) {
+        fprintf(stderr, "--tile-size can't be used with --vector\n");
+        return 1;
+    }
+
+    double start = omp_get_wtime(), loaded;
+
+    struct cache_key key;
+    if (args->cache_path) {
+        if (!job_cache_key(args, &key)) {
+            fprintf(
+                    stderr,
+                    "error reading input file %s: %s\n",
+                    args->input_path,
+                    strerror(errno)
+                );
+            return 1;
+        }
+        if (job_fetch(args, &key)) {
+            *timing = (struct job_timing) {
+                .write = omp_get_wtime() - start,
+                .cached = true
+            };
+            return 0;
+        }
+    }
+
+    struct dfield * dfields = malloc(sizeof(*dfields) * args->n_outputs);
+    if (!dfields) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    enum dfield_result result;
+    if (args->vector) {
+        struct dfield_shape * shape;
+        if ((result = svg_shape_from_file(args->input_path, &shape))) {
+            fprintf(
+                    stderr,
+                    "error reading shape from file %s: %s\n",
+                    args->input_path,
+                    dfield_result_string(result)
+                );
+            free(dfields);
+            return 1;
+        }
+        loaded = omp_get_wtime();
+
+        result = dfield_generate_from_shape(
+                shape,
+                args->input_width,
+                args->input_height,
+                args->n_outputs,
+                args->outputs,
+                args->algorithm,
+                dfields
+            );
+        svg_shape_free(shape);
+    } else {
+        struct dfield_input * input;
+        if (open_input(args, &input)) {
+            free(dfields);
+            return 1;
+        }
+
+        if (args->tile_size) {
+            loaded = omp_get_wtime();
+
+            result = dfield_generate_tiled(
+                    input,
+                    args->n_outputs,
+                    args->outputs,
+                    args->tile_size,
+                    dfields
+                );
+        } else {
+            uint8_t * data;
+            if ((result = dfield_input_read_all(input, &data))) {
+                fprintf(
+                        stderr,
+                        "error reading input data from file %s: %s\n",
+                        args->input_path,
+                        dfield_result_string(result)
+                    );
+                dfield_input_close(input);
+                free(dfields);
+                return 1;
+            }
+            loaded = omp_get_wtime();
+
+            int32_t input_width, input_height;
+            dfield_input_size(input, &input_width, &input_height);
+            result = dfield_generate_multiple(
                     data,
-                    args.input_width,
-                    args.input_height,
-                    args.output_width,
-                    args.output_height,
-                    args.spread,
-                    &dfield))) {
+                    input_width,
+                    input_height,
+                    args->n_outputs,
+                    args->outputs,
+                    args->algorithm,
+                    dfields
+                );
+            free(data);
+        }
+
+        dfield_input_close(input);
+    }
+
+    if (result) {
         fprintf(
                 stderr,
                 "error generating dfield: %s\n",
                 dfield_result_string(result)
             );
-        free(data);
-        free_args(&args);
+        free(dfields);
         return 1;
     }
 
-    free(data);
+    size_t n_dfields = args->n_outputs;
+    if (args->mipmaps) {
+        struct dfield combined;
+        if ((result = dfield_combine_levels(
+                        dfields, (int32_t)n_dfields, &combined))) {
+            fprintf(
+                    stderr,
+                    "error combining outputs into mip levels: %s\n",
+                    dfield_result_string(result)
+                );
+            for (size_t i = 0; i < n_dfields; i++) {
+                dfield_free(&dfields[i]);
+            }
+            free(dfields);
+            return 1;
+        }
+        for (size_t i = 0; i < n_dfields; i++) {
+            dfield_free(&dfields[i]);
+        }
+        dfields[0] = combined;
+        n_dfields = 1;
+    }
+
+    if (args->bc4) {
+        for (size_t i = 0; i < n_dfields; i++) {
+            struct dfield encoded;
+            if ((result = dfield_encode_bc4(&dfields[i], &encoded))) {
+                fprintf(
+                        stderr,
+                        "error block compressing output: %s\n",
+                        dfield_result_string(result)
+                    );
+                for (size_t j = 0; j < n_dfields; j++) {
+                    dfield_free(&dfields[j]);
+                }
+                free(dfields);
+                return 1;
+            }
+            dfield_free(&dfields[i]);
+            dfields[i] = encoded;
+        }
+    }
+
+    double generated = omp_get_wtime();
+
+    int status = 0;
+    for (size_t i = 0; i < n_dfields; i++) {
+        char * path = job_file_path(args, i);
+        if (!path) {
+            fprintf(stderr, "out of memory\n");
+            status = 1;
+            break;
+        }
+
+        result = dfield_to_file_encoded(
+                path,
+                &dfields[i],
+                &(struct dfield_encoding) {
+                    .codec = args->codec,
+                    .filter = args->filter,
+                    .band_rows = args->band_rows,
+                    .threads = omp_get_max_threads()
+                }
+            );
+        if (result) {
+            fprintf(
+                    stderr,
+                    "error writing dfield to file %s: %s\n",
+                    path,
+                    dfield_result_string(result)
+                );
+            free(path);
+            status = 1;
+            break;
+        }
+
+        free(path);
+    }
+
+    for (size_t i = 0; i < n_dfields; i++) {
+        dfield_free(&dfields[i]);
+    }
+    free(dfields);
 
-    if ((result = dfield_to_file(args.output_path, &dfield))) {
+    if (!status && args->cache_path) {
+        job_store(args, &key);
+    }
+
+    *timing = (struct job_timing) {
+        .load = loaded - start,
+        .generate = generated - loaded,
+        .write = omp_get_wtime() - generated
+    };
+
+    return status;
+}
+
+/* one line of a batch manifest */
+struct job {
+    struct arguments args;
+    struct job_timing timing;
+    int status;
+};
+
+/* read all of this file into a new string, returning NULL (having printed the
+ * reason) on error
+ */
+static char * read_manifest(const char * path) [[gnu::nonnull(1)]]
+{
+    FILE * file = fopen(path, "rb");
+    if (!file) {
         fprintf(
                 stderr,
-                "error writing dfield to file %s: %s\n",
-                args.output_path,
-                dfield_result_string(result)
+                "error opening manifest %s: %s\n",
+                path,
+                strerror(errno)
             );
-        free(dfield.data);
+        return NULL;
+    }
+
+    char * text = NULL;
+    size_t length = 0, capacity = 0;
+    while (true) {
+        if (capacity - length < 2) {
+            capacity = capacity ? capacity * 2 : 4096;
+            char * new_text = realloc(text, capacity);
+            if (!new_text) {
+                fprintf(stderr, "out of memory reading manifest %s\n", path);
+                free(text);
+                fclose(file);
+                return NULL;
+            }
+            text = new_text;
+        }
+
+        size_t n = fread(&text[length], 1, capacity - length - 1, file);
+        if (n == 0) {
+            break;
+        }
+        length += n;
+    }
+
+    if (ferror(file)) {
+        fprintf(stderr, "error reading manifest %s\n", path);
+        free(text);
+        fclose(file);
+        return NULL;
+    }
+
+    fclose(file);
+    text[length] = '\0';
+    return text;
+}
+
+/* parse this line of a manifest into a job (starting from the arguments given
+ * on the command line, in defaults) and add it to jobs, unless the line is
+ * blank or a comment
+ *
+ * returns 0 on success and non-zero on error, having printed the reason
+ */
+static int add_job(
+        const struct arguments * defaults,
+        char * line,
+        size_t line_number,
+        struct job ** jobs,
+        size_t * n_jobs
+    ) [[gnu::nonnull(1, 2, 4, 5)]]
+{
+    constexpr char separators[] = " \t\r\v\f";
+
+    /* every word is followed by at least one separator, except the last */
+    size_t max_words = strlen(line) / 2 + 1;
+    char ** argv = malloc(sizeof(*argv) * (max_words + 2));
+    if (!argv) {
+        fprintf(stderr, "out of memory reading manifest\n");
+        return 1;
+    }
+
+    /* argv[0] names the line, so that parse errors say where they are */
+    char location[4096];
+    snprintf(
+            location,
+            sizeof(location),
+            "%s:%zu",
+            defaults->batch_path,
+            line_number
+        );
+
+    int argc = 0;
+    argv[argc++] = location;
+    for (char * word = strtok(line, separators); word;
+            word = strtok(NULL, separators)) {
+        argv[argc++] = word;
+    }
+    argv[argc] = NULL;
+
+    if (argc == 1 || argv[1][0] == '#') {
+        free(argv);
+        return 0;
+    }
+
+    struct arguments args = *defaults;
+    args.input_path = NULL;
+    args.output_path = NULL;
+    args.batch_path = NULL;
+    args.cache_path = NULL;
+    if (defaults->cache_path) {
+        args.cache_path = util_strdup(defaults->cache_path);
+    }
+    args.outputs = NULL;
+    if (defaults->n_outputs > 0) {
+        args.outputs = malloc(sizeof(*args.outputs) * defaults->n_outputs);
+        if (!args.outputs) {
+            fprintf(stderr, "out of memory reading manifest\n");
+            free(argv);
+            return 1;
+        }
+        memcpy(
+                args.outputs,
+                defaults->outputs,
+                sizeof(*args.outputs) * defaults->n_outputs
+            );
+    }
+
+    int result = parse_args(&args, argc, argv);
+    free(argv);
+    if (result) {
+        free_args(&args);
+        return result;
+    }
+
+    struct job * new_jobs = realloc(*jobs, sizeof(**jobs) * (*n_jobs + 1));
+    if (!new_jobs) {
+        fprintf(stderr, "out of memory reading manifest\n");
         free_args(&args);
         return 1;
     }
+    new_jobs[(*n_jobs)++] = (struct job) { .args = args };
+    *jobs = new_jobs;
+    return 0;
+}
+
+/* run every job listed in the manifest named by args->batch_path (see the
+ * --batch option) and print how long each one took
+ *
+ * the jobs are spread across the available threads, and any left over are
+ * shared between the jobs for generating their dfields
+ *
+ * returns 0 if every job succeeded and non-zero otherwise
+ */
+static int run_batch(const struct arguments * args) [[gnu::nonnull(1)]]
+{
+    char * text = read_manifest(args->batch_path);
+    if (!text) {
+        return 1;
+    }
+
+    struct job * jobs = NULL;
+    size_t n_jobs = 0;
+    size_t line_number = 0;
+    int status = 0;
+    for (char * next = text; next && !status;) {
+        char * line = next;
+        next = strchr(line, '\n');
+        if (next) {
+            *next++ = '\0';
+        }
+        status = add_job(args, line, ++line_number, &jobs, &n_jobs);
+    }
+    free(text);
+
+    if (!status && n_jobs > 0) {
+        int threads = omp_get_max_threads();
+        int outer = n_jobs < (size_t)threads ? (int)n_jobs : threads;
+        int inner = threads / outer;
+
+        omp_set_max_active_levels(2);
+        double start = omp_get_wtime();
+
+        #pragma omp parallel for num_threads(outer) schedule(dynamic)
+        for (size_t i = 0; i < n_jobs; i++) {
+            omp_set_num_threads(inner);
+            jobs[i].status = run_job(&jobs[i].args, &jobs[i].timing);
+        }
+
+        double elapsed = omp_get_wtime() - start;
+
+        size_t n_failed = 0, n_cached = 0;
+        for (size_t i = 0; i < n_jobs; i++) {
+            if (jobs[i].status) {
+                printf("%s: failed\n", jobs[i].args.output_path);
+                n_failed++;
+                continue;
+            }
+            const struct job_timing * timing = &jobs[i].timing;
+            if (timing->cached) {
+                printf(
+                        "%s: cached, copied in %.3fs\n",
+                        jobs[i].args.output_path,
+                        timing->write
+                    );
+                n_cached++;
+                continue;
+            }
+            printf(
+                    "%s: load %.3fs, generate %.3fs, write %.3fs, "
+                    "total %.3fs\n",
+                    jobs[i].args.output_path,
+                    timing->load,
+                    timing->generate,
+                    timing->write,
+                    timing->load + timing->generate + timing->write
+                );
+        }
+        printf(
+                "%zu jobs (%zu failed) in %.3fs using %d threads\n",
+                n_jobs,
+                n_failed,
+                elapsed,
+                threads
+            );
+        if (args->cache_path) {
+            printf(
+                    "cache %s: %zu hits, %zu misses\n",
+                    args->cache_path,
+                    n_cached,
+                    n_jobs - n_cached
+                );
+        }
+
+        if (n_failed > 0) {
+            status = 1;
+        }
+    }
+
+    for (size_t i = 0; i < n_jobs; i++) {
+        free_args(&jobs[i].args);
+    }
+    free(jobs);
+    return status;
+}
+
+int main(int argc, char ** argv)
+{
+    struct arguments args = { };
+
+    int parse_result;
+    if ((parse_result = parse_args(&args, argc, argv))) {
+        free_args(&args);
+        return parse_result;
+    }
+
+    int status;
+    if (args.batch_path) {
+        status = run_batch(&args);
+    } else {
+        struct job_timing timing;
+        status = run_job(&args, &timing);
+        if (!status && args.cache_path) {
+            printf(
+                    "cache %s: %s\n",
+                    args.cache_path,
+                    timing.cached ? "hit" : "miss"
+                );
+        }
+    }
 
-    free(dfield.data);
     free_args(&args);
-    return 0;
+    return status;
 }
@@ -0,0 +1,230 @@
+/* File: src/tools/generate-dfield/image.c
+ * Part of snrkos <github.com/rmkrupp/snrkos>
+ *
+ * Copyright (C) 2025 Noah Santer <n.ed.santer@gmail.com>
+ * Copyright (C) 2025 Rebecca Krupp <beka.krupp@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "tools/generate-dfield/image.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <png.h>
+
+/* work out what kind of input file this is from the bytes at its start
+ *
+ * anything that isn't recognizably something else (including a file that
+ * can't be read) is IMAGE_KIND_RAW
+ */
+enum image_kind image_kind_of_file(const char * path) [[gnu::nonnull(1)]]
+{
+    FILE * file = fopen(path, "rb");
+    if (!file) {
+        return IMAGE_KIND_RAW;
+    }
+
+    png_byte start[8];
+    size_t rd = fread(start, 1, sizeof(start), file);
+    fclose(file);
+
+    if (rd == sizeof(start) && !png_sig_cmp(start, 0, sizeof(start))) {
+        return IMAGE_KIND_PNG;
+    }
+
+    if (rd >= 3 && start[0] == 'P' && start[1] == '5' &&
+            start[2] && strchr(" \t\n\r\v\f", start[2])) {
+        return IMAGE_KIND_PGM;
+    }
+
+    return IMAGE_KIND_RAW;
+}
+
+/* the state of an input opened by image_input_open_png */
+struct png_input {
+    FILE * file;
+    png_structp png;
+    png_infop info;
+    int32_t width;
+    int32_t channels; /* per texel of decoded rows */
+    int32_t channel; /* the one we want */
+    bool white_transparent; /* read opaque white as transparent (only set
+                             * when the image has alpha)
+                             */
+    png_bytep row; /* one decoded row */
+    png_bytep image; /* every decoded row, if the image is interlaced */
+    size_t row_size;
+    int32_t next_row;
+};
+
+/* close a png_input (see dfield_close_function) */
+static void png_input_close(void * state)
+{
+    struct png_input * input = state;
+    png_destroy_read_struct(&input->png, &input->info, NULL);
+    if (input->file) {
+        fclose(input->file);
+    }
+    free(input->row);
+    free(input->image);
+    free(input);
+}
+
+/* read the next row of a png_input (see dfield_read_row_function) */
+static enum dfield_result png_input_read_row(void * state, uint8_t * row)
+{
+    struct png_input * input = state;
+
+    if (setjmp(png_jmpbuf(input->png))) {
+        return DFIELD_RESULT_ERROR_BAD_IMAGE;
+    }
+
+    png_bytep texels;
+    if (input->image) {
+        texels = &input->image[(size_t)input->next_row * input->row_size];
+    } else {
+        png_read_row(input->png, input->row, NULL);
+        texels = input->row;
+    }
+    input->next_row++;
+
+    for (int32_t x = 0; x < input->width; x++) {
+        const png_byte * texel = &texels[(size_t)x * input->channels];
+        row[x] = texel[input->channel];
+        if (input->white_transparent) {
+            bool white = true;
+            for (int32_t c = 0; c < input->channels; c++) {
+                white = white && texel[c] == 255;
+            }
+            if (white) {
+                row[x] = 0;
+            }
+        }
+    }
+
+    return DFIELD_RESULT_OKAY;
+}
+
+/* open this PNG file as an input, putting it in input_out
+ *
+ * the input is the image's alpha channel if it has one, and otherwise its
+ * gray level (converting color to gray), at 8 bits. rows are decoded as they
+ * are read, unless the image is interlaced
+ *
+ * if white_transparent is true, opaque white texels of an image with alpha
+ * are read as transparent (as ImageMagick's -transparent "#FFFFFFFF" makes
+ * them), so that a white background counts as off
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result image_input_open_png(
+        const char * path,
+        bool white_transparent,
+        struct dfield_input ** input_out
+    ) [[gnu::nonnull(1, 3)]]
+{
+    struct png_input * input = calloc(1, sizeof(*input));
+    if (!input) {
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+    input->file = fopen(path, "rb");
+    if (!input->file) {
+        free(input);
+        return DFIELD_RESULT_ERROR_ERRNO;
+    }
+
+    input->png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if (input->png) {
+        input->info = png_create_info_struct(input->png);
+    }
+    if (!input->png || !input->info) {
+        png_input_close(input);
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+    /* libpng reports errors (after printing them) by jumping back here */
+    if (setjmp(png_jmpbuf(input->png))) {
+        png_input_close(input);
+        return DFIELD_RESULT_ERROR_BAD_IMAGE;
+    }
+
+    png_init_io(input->png, input->file);
+    png_read_info(input->png, input->info);
+
+    png_uint_32 width = png_get_image_width(input->png, input->info);
+    png_uint_32 height = png_get_image_height(input->png, input->info);
+    if (width == 0 || height == 0 || width > INT32_MAX || height > INT32_MAX) {
+        png_input_close(input);
+        return DFIELD_RESULT_ERROR_BAD_INPUT_SIZE;
+    }
+
+    /* expand everything to 8-bit gray or RGB, with alpha if there is any,
+     * and make color without alpha gray
+     */
+    png_set_expand(input->png);
+    png_set_strip_16(input->png);
+    png_byte color_type = png_get_color_type(input->png, input->info);
+    bool alpha = (color_type & PNG_COLOR_MASK_ALPHA) ||
+                 png_get_valid(input->png, input->info, PNG_INFO_tRNS);
+    if (!alpha && (color_type & PNG_COLOR_MASK_COLOR)) {
+        png_set_rgb_to_gray_fixed(input->png, 1, -1, -1);
+    }
+    int passes = png_set_interlace_handling(input->png);
+    png_read_update_info(input->png, input->info);
+
+    input->width = (int32_t)width;
+    input->channels = png_get_channels(input->png, input->info);
+    input->channel = alpha ? input->channels - 1 : 0;
+    input->white_transparent = alpha && white_transparent;
+    input->row_size = png_get_rowbytes(input->png, input->info);
+
+    if (passes > 1) {
+        /* an interlaced image's rows aren't done until the last pass, so
+         * decode all of it now
+         */
+        input->image = malloc(input->row_size * height);
+        png_bytepp rows = malloc(sizeof(*rows) * height);
+        if (!input->image || !rows) {
+            free(rows);
+            png_input_close(input);
+            return DFIELD_RESULT_ERROR_MEMORY;
+        }
+        for (png_uint_32 y = 0; y < height; y++) {
+            rows[y] = &input->image[y * input->row_size];
+        }
+        png_read_image(input->png, rows);
+        free(rows);
+    } else {
+        input->row = malloc(input->row_size);
+        if (!input->row) {
+            png_input_close(input);
+            return DFIELD_RESULT_ERROR_MEMORY;
+        }
+    }
+
+    enum dfield_result result = dfield_input_open(
+            (int32_t)width,
+            (int32_t)height,
+            png_input_read_row,
+            png_input_close,
+            input,
+            input_out
+        );
+    if (result) {
+        png_input_close(input);
+    }
+    return result;
+}
@@ -0,0 +1,576 @@
+/* File: src/tools/generate-dfield/svg.c
+ * Part of snrkos <github.com/rmkrupp/snrkos>
+ *
+ * Copyright (C) 2025 Noah Santer <n.ed.santer@gmail.com>
+ * Copyright (C) 2025 Rebecca Krupp <beka.krupp@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "tools/generate-dfield/svg.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* add this segment to shape, returning false if we ran out of memory */
+static bool shape_add_segment(
+        struct dfield_shape * shape, struct dfield_shape_segment segment)
+{
+    if (shape->n_segments == shape->capacity) {
+        size_t capacity = shape->capacity ? shape->capacity * 2 : 64;
+        struct dfield_shape_segment * new_segments =
+            realloc(shape->segments, sizeof(*new_segments) * capacity);
+        if (!new_segments) {
+            return false;
+        }
+        shape->segments = new_segments;
+        shape->capacity = capacity;
+    }
+    shape->segments[shape->n_segments++] = segment;
+    return true;
+}
+
+/* is c whitespace, as far as SVG is concerned? */
+static inline bool svg_is_whitespace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+/* is c whitespace or a comma, which separate things in SVG path data? */
+static inline bool path_is_separator(char c)
+{
+    return svg_is_whitespace(c) || c == ',';
+}
+
+/* skip any separators at *c */
+static inline void path_skip_separators(const char ** c)
+{
+    while (path_is_separator(**c)) {
+        (*c)++;
+    }
+}
+
+/* is c an SVG path command letter? */
+static inline bool path_is_command(char c)
+{
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+}
+
+/* read a number from *c (after any separators) into number_out, returning
+ * false if there isn't one
+ */
+static bool path_number(const char ** c, double * number_out)
+{
+    path_skip_separators(c);
+    if (path_is_command(**c)) {
+        return false;
+    }
+    char * end;
+    double number = strtod(*c, &end);
+    if (end == *c || !isfinite(number)) {
+        return false;
+    }
+    *c = end;
+    *number_out = number;
+    return true;
+}
+
+/* read count numbers from *c into numbers, adding (x, y) to each pair if
+ * relative is true, returning false if there aren't that many
+ */
+static bool path_points(
+        const char ** c,
+        double * numbers,
+        int count,
+        bool relative,
+        double x,
+        double y
+    )
+{
+    for (int i = 0; i < count; i++) {
+        if (!path_number(c, &numbers[i])) {
+            return false;
+        }
+        if (relative) {
+            numbers[i] += i % 2 ? y : x;
+        }
+    }
+    return true;
+}
+
+/* parse this SVG path data and add its outlines to shape
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result shape_add_path(
+        struct dfield_shape * shape, const char * path_data)
+{
+    /* the current point, the start of the current outline, and the control
+     * point that S and T reflect
+     */
+    double x = 0.0, y = 0.0,
+           start_x = 0.0, start_y = 0.0,
+           control_x = 0.0, control_y = 0.0;
+    /* segments in the current outline */
+    size_t n_outline = 0;
+    char command = '\0', previous = '\0';
+
+    const char * c = path_data;
+    for (;;) {
+        path_skip_separators(&c);
+
+        /* fill closes every outline, whether or not it ends in Z */
+        bool close = !*c || *c == 'M' || *c == 'm' || *c == 'Z' || *c == 'z';
+        if (close && n_outline > 0) {
+            if (x != start_x || y != start_y) {
+                if (!shape_add_segment(shape, (struct dfield_shape_segment) {
+                            .degree = 1,
+                            .points = { x, y, start_x, start_y }
+                        })) {
+                    return DFIELD_RESULT_ERROR_MEMORY;
+                }
+            }
+            n_outline = 0;
+            x = start_x;
+            y = start_y;
+        }
+
+        if (!*c) {
+            break;
+        }
+
+        if (path_is_command(*c)) {
+            command = *c++;
+        } else if (!command || command == 'Z' || command == 'z') {
+            /* numbers need a command to repeat */
+            return DFIELD_RESULT_ERROR_BAD_PATH;
+        }
+
+        bool relative = command >= 'a';
+        double p[6];
+        struct dfield_shape_segment segment = {
+            .starts_outline = n_outline == 0,
+            .points = { x, y }
+        };
+
+        switch (relative ? command - 'a' + 'A' : command) {
+            case 'M':
+                if (!path_points(&c, p, 2, relative, x, y)) {
+                    return DFIELD_RESULT_ERROR_BAD_PATH;
+                }
+                x = start_x = p[0];
+                y = start_y = p[1];
+                /* more points after a move are lines */
+                command = relative ? 'l' : 'L';
+                previous = 'M';
+                continue;
+
+            case 'Z':
+                previous = 'Z';
+                continue;
+
+            case 'L':
+                if (!path_points(&c, p, 2, relative, x, y)) {
+                    return DFIELD_RESULT_ERROR_BAD_PATH;
+                }
+                segment.degree = 1;
+                break;
+
+            case 'H':
+                if (!path_number(&c, &p[0])) {
+                    return DFIELD_RESULT_ERROR_BAD_PATH;
+                }
+                p[0] += relative ? x : 0.0;
+                p[1] = y;
+                segment.degree = 1;
+                break;
+
+            case 'V':
+                if (!path_number(&c, &p[1])) {
+                    return DFIELD_RESULT_ERROR_BAD_PATH;
+                }
+                p[0] = x;
+                p[1] += relative ? y : 0.0;
+                segment.degree = 1;
+                break;
+
+            case 'Q':
+                if (!path_points(&c, p, 4, relative, x, y)) {
+                    return DFIELD_RESULT_ERROR_BAD_PATH;
+                }
+                segment.degree = 2;
+                break;
+
+            case 'T':
+                p[0] = previous == 'Q' ? 2 * x - control_x : x;
+                p[1] = previous == 'Q' ? 2 * y - control_y : y;
+                if (!path_points(&c, &p[2], 2, relative, x, y)) {
+                    return DFIELD_RESULT_ERROR_BAD_PATH;
+                }
+                segment.degree = 2;
+                break;
+
+            case 'C':
+                if (!path_points(&c, p, 6, relative, x, y)) {
+                    return DFIELD_RESULT_ERROR_BAD_PATH;
+                }
+                segment.degree = 3;
+                break;
+
+            case 'S':
+                p[0] = previous == 'C' ? 2 * x - control_x : x;
+                p[1] = previous == 'C' ? 2 * y - control_y : y;
+                if (!path_points(&c, &p[2], 4, relative, x, y)) {
+                    return DFIELD_RESULT_ERROR_BAD_PATH;
+                }
+                segment.degree = 3;
+                break;
+
+            default:
+                /* including arcs (A), which we don't support */
+                return DFIELD_RESULT_ERROR_BAD_PATH;
+        }
+
+        for (int32_t i = 0; i < 2 * segment.degree; i++) {
+            segment.points[2 + i] = p[i];
+        }
+        if (!shape_add_segment(shape, segment)) {
+            return DFIELD_RESULT_ERROR_MEMORY;
+        }
+        n_outline++;
+
+        /* T and S reflect the last control point of a Q or C before them */
+        previous = segment.degree == 2 ? 'Q' :
+                   segment.degree == 3 ? 'C' : 'L';
+        control_x = segment.points[2 * segment.degree - 2];
+        control_y = segment.points[2 * segment.degree - 1];
+        x = segment.points[2 * segment.degree];
+        y = segment.points[2 * segment.degree + 1];
+    }
+
+    return DFIELD_RESULT_OKAY;
+}
+
+/* find the attribute with this name in the SVG tag whose attributes start at
+ * tag, returning its value (and putting its length in length_out) or NULL if
+ * it doesn't have one
+ */
+static const char * svg_attribute(
+        const char * tag, const char * name, size_t * length_out)
+{
+    size_t name_length = strlen(name);
+    const char * c = tag;
+    for (;;) {
+        while (svg_is_whitespace(*c)) {
+            c++;
+        }
+        if (!*c || *c == '>' || *c == '/' || *c == '<') {
+            return NULL;
+        }
+
+        const char * attribute = c;
+        while (*c && !svg_is_whitespace(*c) && *c != '=' && *c != '>' &&
+                *c != '/') {
+            c++;
+        }
+        size_t attribute_length = (size_t)(c - attribute);
+
+        while (svg_is_whitespace(*c)) {
+            c++;
+        }
+        if (*c != '=') {
+            /* an attribute without a value isn't valid XML, but skip it */
+            continue;
+        }
+        c++;
+        while (svg_is_whitespace(*c)) {
+            c++;
+        }
+        if (*c != '"' && *c != '\'') {
+            return NULL;
+        }
+        char quote = *c++;
+        const char * value = c;
+        while (*c && *c != quote) {
+            c++;
+        }
+        if (!*c) {
+            return NULL;
+        }
+
+        if (attribute_length == name_length &&
+                !strncmp(attribute, name, name_length)) {
+            *length_out = (size_t)(c - value);
+            return value;
+        }
+        c++;
+    }
+}
+
+/* does the SVG tag starting at tag (just past its <) have this name? */
+static bool svg_tag_is(const char * tag, const char * name)
+{
+    size_t length = strlen(name);
+    return !strncmp(tag, name, length) &&
+           (svg_is_whitespace(tag[length]) || tag[length] == '>' ||
+            tag[length] == '/');
+}
+
+/* the elements whose contents are never drawn by themselves */
+static const char * const svg_hidden_elements[] = {
+    "defs", "clipPath", "mask", "marker", "pattern", "symbol"
+};
+
+/* skip past the end of the SVG element with this name whose start tag
+ * starts at tag (just past its <), returning NULL if it doesn't end
+ */
+static const char * svg_skip_element(const char * tag, const char * name)
+{
+    size_t depth = 0;
+    for (const char * c = tag;;) {
+        /* c is just past the < of a start tag with this name, which only
+         * has contents (that we have to find the end of) if it doesn't
+         * close itself
+         */
+        c = strchr(c, '>');
+        if (!c) {
+            return NULL;
+        }
+        if (c[-1] != '/') {
+            depth++;
+        }
+        c++;
+        if (depth == 0) {
+            return c;
+        }
+
+        /* find the next start or end tag with this name */
+        for (;;) {
+            c = strchr(c, '<');
+            if (!c) {
+                return NULL;
+            }
+            c++;
+            if (*c == '/' && svg_tag_is(c + 1, name)) {
+                c = strchr(c, '>');
+                if (!c) {
+                    return NULL;
+                }
+                c++;
+                if (--depth == 0) {
+                    return c;
+                }
+            } else if (svg_tag_is(c, name)) {
+                break;
+            }
+        }
+    }
+}
+
+/* add the outlines of the <path> elements of this SVG document to shape, and
+ * take its view box from the <svg> element
+ *
+ * paths inside elements that aren't drawn (like <defs>) are skipped, and
+ * transforms aren't supported, so any transform attribute is an error rather
+ * than something to silently get wrong
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+static enum dfield_result shape_add_svg(
+        struct dfield_shape * shape, const char * text)
+{
+    bool seen_svg = false;
+    for (const char * c = text; (c = strchr(c, '<')); ) {
+        if (!strncmp(c, "<!--", 4)) {
+            c = strstr(c, "-->");
+            if (!c) {
+                break;
+            }
+            continue;
+        }
+        c++;
+
+        /* only start tags have attributes */
+        if (*c == '/' || *c == '?' || *c == '!') {
+            continue;
+        }
+
+        size_t length;
+        const char * value;
+        if (svg_attribute(c, "transform", &length)) {
+            return DFIELD_RESULT_ERROR_BAD_PATH;
+        }
+
+        bool hidden = false;
+        for (size_t i = 0;
+                i < sizeof(svg_hidden_elements) /
+                    sizeof(*svg_hidden_elements);
+                i++) {
+            if (svg_tag_is(c, svg_hidden_elements[i])) {
+                c = svg_skip_element(c, svg_hidden_elements[i]);
+                if (!c) {
+                    return DFIELD_RESULT_ERROR_BAD_PATH;
+                }
+                hidden = true;
+                break;
+            }
+        }
+
+        if (hidden) {
+            continue;
+        } else if (!seen_svg && svg_tag_is(c, "svg")) {
+            seen_svg = true;
+            double box[4];
+            if ((value = svg_attribute(c + 3, "viewBox", &length))) {
+                const char * v = value;
+                if (!path_points(&v, box, 4, false, 0.0, 0.0)) {
+                    return DFIELD_RESULT_ERROR_BAD_PATH;
+                }
+            } else {
+                /* without a view box, width and height (in user units,
+                 * ignoring any suffix) are the same thing
+                 */
+                box[0] = box[1] = 0.0;
+                const char * width = svg_attribute(c + 3, "width", &length);
+                const char * height = svg_attribute(c + 3, "height", &length);
+                if (!width || !height) {
+                    continue;
+                }
+                box[2] = strtod(width, NULL);
+                box[3] = strtod(height, NULL);
+            }
+            if (!(box[2] > 0.0) || !(box[3] > 0.0)) {
+                return DFIELD_RESULT_ERROR_BAD_PATH;
+            }
+            shape->has_view_box = true;
+            shape->view_x = box[0];
+            shape->view_y = box[1];
+            shape->view_width = box[2];
+            shape->view_height = box[3];
+        } else if (svg_tag_is(c, "path") &&
+                (value = svg_attribute(c + 4, "d", &length))) {
+            char * path_data = malloc(length + 1);
+            if (!path_data) {
+                return DFIELD_RESULT_ERROR_MEMORY;
+            }
+            memcpy(path_data, value, length);
+            path_data[length] = '\0';
+            enum dfield_result result = shape_add_path(shape, path_data);
+            free(path_data);
+            if (result) {
+                return result;
+            }
+        }
+    }
+
+    return DFIELD_RESULT_OKAY;
+}
+
+/* parse this SVG path data into a new shape, whose coordinates are in input
+ * texels, and put it in shape_out
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result svg_shape_from_path(
+        const char * path_data,
+        struct dfield_shape ** shape_out
+    ) [[gnu::nonnull(1, 2)]]
+{
+    struct dfield_shape * shape = calloc(1, sizeof(*shape));
+    if (!shape) {
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+    enum dfield_result result = shape_add_path(shape, path_data);
+    if (result) {
+        svg_shape_free(shape);
+        return result;
+    }
+
+    *shape_out = shape;
+    return DFIELD_RESULT_OKAY;
+}
+
+/* load a shape from this file and put it in shape_out
+ *
+ * returns DFIELD_RESULT_OKAY (0) on success, non-zero on error
+ */
+enum dfield_result svg_shape_from_file(
+        const char * path,
+        struct dfield_shape ** shape_out
+    ) [[gnu::nonnull(1, 2)]]
+{
+    FILE * file = fopen(path, "rb");
+    if (!file) {
+        return DFIELD_RESULT_ERROR_ERRNO;
+    }
+
+    char * text = NULL;
+    size_t length = 0, capacity = 0;
+    for (;;) {
+        if (capacity - length < 2) {
+            capacity = capacity ? capacity * 2 : 4096;
+            char * new_text = realloc(text, capacity);
+            if (!new_text) {
+                free(text);
+                fclose(file);
+                return DFIELD_RESULT_ERROR_MEMORY;
+            }
+            text = new_text;
+        }
+        size_t rd = fread(&text[length], 1, capacity - length - 1, file);
+        if (rd == 0) {
+            break;
+        }
+        length += rd;
+    }
+
+    bool error = ferror(file);
+    fclose(file);
+    if (error) {
+        free(text);
+        return DFIELD_RESULT_ERROR_READ_SIZE;
+    }
+    text[length] = '\0';
+
+    struct dfield_shape * shape = calloc(1, sizeof(*shape));
+    if (!shape) {
+        free(text);
+        return DFIELD_RESULT_ERROR_MEMORY;
+    }
+
+    const char * c = text;
+    path_skip_separators(&c);
+    enum dfield_result result = *c == '<' ?
+        shape_add_svg(shape, text) : shape_add_path(shape, text);
+    free(text);
+    if (result) {
+        svg_shape_free(shape);
+        return result;
+    }
+
+    *shape_out = shape;
+    return DFIELD_RESULT_OKAY;
+}
+
+/* free a shape made by svg_shape_from_path or svg_shape_from_file */
+void svg_shape_free(struct dfield_shape * shape)
+{
+    if (!shape) {
+        return;
+    }
+    free(shape->segments);
+    free(shape);
+}
@@ -0,0 +1,87 @@
+/* File: src/tools/pack-dfield/pack-dfield.c
+ * Part of snrkos <github.com/rmkrupp/snrkos>
+ *
+ * Copyright (C) 2025 Noah Santer <n.ed.santer@gmail.com>
+ * Copyright (C) 2025 Rebecca Krupp <beka.krupp@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* pack dfield files into one uncompressed pack (see dfield_pack_write),
+ * named by the paths they were given as
+ */
+#include "dfield.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void usage()
+{
+    fprintf(stderr, "Usage: pack-dfield [--help] PACK_FILE DFIELD_FILE...\n");
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc < 3 || !strcmp(argv[1], "--help")) {
+        usage();
+        return argc < 3 ? 1 : 0;
+    }
+
+    const char * pack_path = argv[1];
+    size_t n_dfields = (size_t)argc - 2;
+    const char * const * names = (const char * const *)&argv[2];
+
+    struct dfield * dfields = calloc(n_dfields, sizeof(*dfields));
+    if (!dfields) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    int status = 0;
+    for (size_t i = 0; i < n_dfields; i++) {
+        enum dfield_result result = dfield_from_file(names[i], &dfields[i]);
+        if (result) {
+            fprintf(
+                    stderr,
+                    "error loading dfield from file %s: %s\n",
+                    names[i],
+                    dfield_result_string(result)
+                );
+            status = 1;
+            break;
+        }
+    }
+
+    if (!status) {
+        enum dfield_result result =
+            dfield_pack_write(pack_path, n_dfields, names, dfields);
+        if (result) {
+            fprintf(
+                    stderr,
+                    "error writing pack to file %s: %s\n",
+                    pack_path,
+                    dfield_result_string(result)
+                );
+            status = 1;
+        }
+    }
+
+    for (size_t i = 0; i < n_dfields; i++) {
+        dfield_free(&dfields[i]);
+    }
+    free(dfields);
+
+    return status;
+}